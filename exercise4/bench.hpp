@@ -0,0 +1,27 @@
+#pragma once
+
+#include <chrono>
+#include <algorithm>
+
+// Number of timed runs in the --bench-* modes
+constexpr int kBenchRepeats = 25;
+
+// Runs aFunc kBenchRepeats times and returns the median time in milliseconds.
+// The median is less sensitive to the occasional descheduling than the mean.
+template< typename tFunc >
+double time_median_ms( tFunc&& aFunc )
+{
+	using Clock_ = std::chrono::steady_clock;
+
+	double times[kBenchRepeats];
+	for( auto& time : times )
+	{
+		auto const t0 = Clock_::now();
+		aFunc();
+		auto const t1 = Clock_::now();
+		time = std::chrono::duration<double,std::milli>( t1 - t0 ).count();
+	}
+
+	std::nth_element( times, times + kBenchRepeats/2, times + kBenchRepeats );
+	return times[kBenchRepeats/2];
+}
@@ -0,0 +1,158 @@
+#include "bindless.hpp"
+
+#include <algorithm>
+
+#include <cassert>
+
+#include "../labutils/error.hpp"
+#include "../labutils/to_string.hpp"
+namespace lut = labutils;
+
+BindlessTextures create_bindless_textures( lut::VulkanContext const& aContext, std::uint32_t aMaxTextures )
+{
+	if( !aContext.haveDescriptorIndexing )
+		throw lut::Error( "Bindless textures require descriptor indexing" );
+
+	// Limits for descriptors in update-after-bind sets are separate from
+	// (and typically much larger than) the normal ones.
+	VkPhysicalDeviceDescriptorIndexingProperties indexingProps{};
+	indexingProps.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES;
+
+	VkPhysicalDeviceProperties2 props{};
+	props.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+	props.pNext = &indexingProps;
+
+	vkGetPhysicalDeviceProperties2( aContext.physicalDevice, &props );
+
+	BindlessTextures ret;
+	ret.capacity = std::min( { 
+		aMaxTextures,
+		indexingProps.maxDescriptorSetUpdateAfterBindSampledImages,
+		indexingProps.maxDescriptorSetUpdateAfterBindSamplers,
+		indexingProps.maxPerStageDescriptorUpdateAfterBindSampledImages,
+		indexingProps.maxPerStageDescriptorUpdateAfterBindSamplers
+	} );
+
+	// Layout
+	VkDescriptorSetLayoutBinding bindings[1]{};
+	bindings[0].binding = 0; // this must match the shaders
+	bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	bindings[0].descriptorCount = ret.capacity;
+	bindings[0].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+	VkDescriptorBindingFlags bindingFlags[1] = {
+		VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT
+	};
+
+	VkDescriptorSetLayoutBindingFlagsCreateInfo flagsInfo{};
+	flagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+	flagsInfo.bindingCount = sizeof(bindingFlags) / sizeof(bindingFlags[0]);
+	flagsInfo.pBindingFlags = bindingFlags;
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo{};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.pNext = &flagsInfo;
+	layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+	layoutInfo.bindingCount = sizeof(bindings) / sizeof(bindings[0]);
+	layoutInfo.pBindings = bindings;
+
+	VkDescriptorSetLayout layout = VK_NULL_HANDLE;
+	if( auto const res = vkCreateDescriptorSetLayout( aContext.device, &layoutInfo, nullptr, &layout ); VK_SUCCESS != res )
+	{
+		throw lut::Error( "Unable to create bindless descriptor set layout\n" "vkCreateDescriptorSetLayout() returned %s", lut::to_string(res).c_str() );
+	}
+
+	ret.layout = lut::DescriptorSetLayout( aContext.device, layout );
+
+	// Pool with room for exactly the one set
+	VkDescriptorPoolSize poolSize{};
+	poolSize.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	poolSize.descriptorCount = ret.capacity;
+
+	VkDescriptorPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+	poolInfo.maxSets = 1;
+	poolInfo.poolSizeCount = 1;
+	poolInfo.pPoolSizes = &poolSize;
+
+	VkDescriptorPool pool = VK_NULL_HANDLE;
+	if( auto const res = vkCreateDescriptorPool( aContext.device, &poolInfo, nullptr, &pool ); VK_SUCCESS != res )
+	{
+		throw lut::Error( "Unable to create bindless descriptor pool\n" "vkCreateDescriptorPool() returned %s", lut::to_string(res).c_str() );
+	}
+
+	ret.pool = lut::DescriptorPool( aContext.device, pool );
+
+	// The set
+	VkDescriptorSetAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = ret.pool.handle;
+	allocInfo.descriptorSetCount = 1;
+	allocInfo.pSetLayouts = &ret.layout.handle;
+
+	if( auto const res = vkAllocateDescriptorSets( aContext.device, &allocInfo, &ret.set ); VK_SUCCESS != res )
+	{
+		throw lut::Error( "Unable to allocate bindless descriptor set\n" "vkAllocateDescriptorSets() returned %s", lut::to_string(res).c_str() );
+	}
+
+	return ret;
+}
+
+std::uint32_t add_bindless_texture( BindlessTextures& aTable, lut::DescriptorWriter& aWriter, VkImageView aView, VkSampler aSampler )
+{
+	assert( VK_NULL_HANDLE != aTable.set );
+
+	std::uint32_t index = 0;
+	if( !aTable.freeSlots.empty() )
+	{
+		index = aTable.freeSlots.back();
+		aTable.freeSlots.pop_back();
+	}
+	else
+	{
+		if( aTable.count >= aTable.capacity )
+			throw lut::Error( "Bindless texture table is full (%u textures)", aTable.capacity );
+
+		index = aTable.count++;
+	}
+
+	aWriter.write_image( aTable.set, 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, aView, aSampler, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, index );
+
+	return index;
+}
+
+void release_bindless_texture( BindlessTextures& aTable, std::uint32_t aIndex )
+{
+	assert( aIndex < aTable.count );
+	aTable.freeSlots.emplace_back( aIndex );
+}
+
+lut::PipelineLayout create_bindless_pipeline_layout( lut::VulkanContext const& aContext, VkDescriptorSetLayout aSceneLayout, BindlessTextures const& aTable )
+{
+	VkDescriptorSetLayout layouts[] = {
+		// Order must match the set = N in the shaders
+		aSceneLayout,
+		aTable.layout.handle
+	};
+
+	VkPushConstantRange pushRange{};
+	pushRange.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+	pushRange.offset = 0;
+	pushRange.size = sizeof(BindlessPushConstants);
+
+	VkPipelineLayoutCreateInfo layoutInfo{};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	layoutInfo.setLayoutCount = sizeof(layouts) / sizeof(layouts[0]);
+	layoutInfo.pSetLayouts = layouts;
+	layoutInfo.pushConstantRangeCount = 1;
+	layoutInfo.pPushConstantRanges = &pushRange;
+
+	VkPipelineLayout layout = VK_NULL_HANDLE;
+	if( auto const res = vkCreatePipelineLayout( aContext.device, &layoutInfo, nullptr, &layout ); VK_SUCCESS != res )
+	{
+		throw lut::Error( "Unable to create bindless pipeline layout\n" "vkCreatePipelineLayout() returned %s", lut::to_string(res).c_str() );
+	}
+
+	return lut::PipelineLayout( aContext.device, layout );
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <vector>
+
+#include <cstdint>
+
+#include <volk/volk.h>
+
+#include "../labutils/vkobject.hpp"
+#include "../labutils/vulkan_context.hpp"
+#include "../labutils/descriptor_writer.hpp"
+
+// Bindless texture table (--bindless). All textures live in one large array
+// of combined image samplers in a single descriptor set, which is bound once
+// per command buffer. Draws select their texture with a push constant
+// (BindlessPushConstants) instead of binding a per-object descriptor set.
+//
+// The array is partially bound and update-after-bind: unused slots need not
+// hold valid descriptors, and textures can be added while the set is bound
+// in command buffers that are still pending (as long as those do not access
+// the new slots). Requires VulkanContext::haveDescriptorIndexing.
+//
+// A texture that is replaced (e.g., moved by the Defragmenter) gets a new
+// slot; the old one is released once no pending frame uses it.
+struct BindlessTextures
+{
+	labutils::DescriptorSetLayout layout;
+	labutils::DescriptorPool pool;
+
+	VkDescriptorSet set = VK_NULL_HANDLE;
+
+	// Number of slots in the array, and the number of slots assigned so far
+	std::uint32_t capacity = 0;
+	std::uint32_t count = 0;
+
+	// Released slots below count; reused first
+	std::vector<std::uint32_t> freeSlots;
+};
+
+// Matches the push constant block in shaderTexBindless.frag
+struct BindlessPushConstants
+{
+	std::uint32_t textureIndex;
+};
+
+// The capacity is clamped to the device's update-after-bind limits
+BindlessTextures create_bindless_textures(
+	labutils::VulkanContext const&,
+	std::uint32_t aMaxTextures
+);
+
+// Assigns the texture to the next free slot and returns its index. The slot
+// is written by the next aWriter.update(), so several textures can be added
+// with one descriptor update. The image must be in
+// VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL when used.
+std::uint32_t add_bindless_texture(
+	BindlessTextures&,
+	labutils::DescriptorWriter& aWriter,
+	VkImageView,
+	VkSampler
+);
+
+// The slot must no longer be used by any pending command buffer. Its
+// descriptor is left as is until the slot is reused.
+void release_bindless_texture( BindlessTextures&, std::uint32_t aIndex );
+
+// Set 0 holds the scene descriptors, set 1 the texture table. The fragment
+// shader receives BindlessPushConstants.
+labutils::PipelineLayout create_bindless_pipeline_layout(
+	labutils::VulkanContext const&,
+	VkDescriptorSetLayout aSceneLayout,
+	BindlessTextures const&
+);
@@ -0,0 +1,324 @@
+#include "cull.hpp"
+
+#include <algorithm>
+
+#include <cmath>
+#include <cassert>
+#include <cstring>
+
+#if defined(__AVX__)
+#	include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#	include <emmintrin.h>
+#endif
+
+#if defined(_MSC_VER)
+#	include <intrin.h>
+#endif
+
+namespace
+{
+	// Objects are culled in batches of kCullBatch. Each chunk handed to a
+	// worker covers kChunkBatches batches.
+	constexpr std::size_t kChunkBatches = 256;
+
+	// Counterpart to countl_zero_() in vkimage.cpp; std::countr_zero() is
+	// C++20.
+	inline
+	std::uint32_t countr_zero_( std::uint32_t aX )
+	{
+		assert( aX );
+#		if defined(_MSC_VER)
+		unsigned long index = 0;
+		_BitScanForward( &index, aX );
+		return std::uint32_t(index);
+#		else
+		return std::uint32_t(__builtin_ctz( aX ));
+#		endif
+	}
+
+	// Tests batches [aBatchBegin, aBatchEnd) and writes the indices of the
+	// visible objects to aOut. Returns the number of indices written, which
+	// is at most kCullBatch per batch.
+	std::size_t cull_batches_( ObjectTable const&, FrustumPlanes const&, std::size_t aBatchBegin, std::size_t aBatchEnd, std::uint32_t* aOut );
+}
+
+std::uint32_t add_object( ObjectTable& aTable, glm::vec3 const& aCenter, glm::vec3 const& aExtent )
+{
+	auto const index = aTable.count++;
+	auto const padded = (aTable.count + kCullBatch - 1) / kCullBatch * kCullBatch;
+
+	if( padded != aTable.centerX.size() )
+	{
+		aTable.centerX.resize( padded, 0.f );
+		aTable.centerY.resize( padded, 0.f );
+		aTable.centerZ.resize( padded, 0.f );
+		aTable.extentX.resize( padded, 0.f );
+		aTable.extentY.resize( padded, 0.f );
+		aTable.extentZ.resize( padded, 0.f );
+	}
+
+	set_object_bounds( aTable, index, aCenter, aExtent );
+	return index;
+}
+
+void set_object_bounds( ObjectTable& aTable, std::uint32_t aIndex, glm::vec3 const& aCenter, glm::vec3 const& aExtent )
+{
+	assert( aIndex < aTable.count );
+
+	aTable.centerX[aIndex] = aCenter.x;
+	aTable.centerY[aIndex] = aCenter.y;
+	aTable.centerZ[aIndex] = aCenter.z;
+	aTable.extentX[aIndex] = aExtent.x;
+	aTable.extentY[aIndex] = aExtent.y;
+	aTable.extentZ[aIndex] = aExtent.z;
+}
+
+FrustumPlanes extract_frustum_planes( glm::mat4 const& aProjCam )
+{
+	// Gribb & Hartmann. glm matrices are column-major, so row i is formed by
+	// the i-th element of each column.
+	auto const row = [&] ( int aRow ) {
+		return glm::vec4( aProjCam[0][aRow], aProjCam[1][aRow], aProjCam[2][aRow], aProjCam[3][aRow] );
+	};
+
+	glm::vec4 const r0 = row(0), r1 = row(1), r2 = row(2), r3 = row(3);
+	glm::vec4 const planes[6] = {
+		r3 + r0, // left
+		r3 - r0, // right
+		r3 + r1, // bottom (top, with the mirrored Y axis)
+		r3 - r1, // top
+		r2,      // near: 0 <= z
+		r3 - r2  // far: z <= w
+	};
+
+	FrustumPlanes ret{};
+	for( int i = 0; i < 6; ++i )
+	{
+		float const len = glm::length( glm::vec3( planes[i] ) );
+		ret.nx[i] = planes[i].x / len;
+		ret.ny[i] = planes[i].y / len;
+		ret.nz[i] = planes[i].z / len;
+		ret.d[i]  = planes[i].w / len;
+	}
+
+	return ret;
+}
+
+void cull_objects( ObjectTable const& aTable, FrustumPlanes const& aPlanes, std::vector<std::uint32_t>& aVisible, labutils::ThreadPool* aPool )
+{
+	std::size_t const batches = (aTable.count + kCullBatch - 1) / kCullBatch;
+	assert( aTable.centerX.size() >= batches * kCullBatch );
+
+	// Each batch produces at most kCullBatch indices, so a chunk starting at
+	// batch b can write its results starting at b * kCullBatch without
+	// overlapping any other chunk. The results are compacted afterwards.
+	aVisible.resize( batches * kCullBatch );
+
+	if( !aPool || batches <= kChunkBatches )
+	{
+		auto const count = cull_batches_( aTable, aPlanes, 0, batches, aVisible.data() );
+		aVisible.resize( count );
+		return;
+	}
+
+	std::size_t const chunks = (batches + kChunkBatches - 1) / kChunkBatches;
+
+	// Note: workers must access the caller's instance, hence the reference.
+	thread_local std::vector<std::size_t> chunkCountsStorage;
+	auto& chunkCounts = chunkCountsStorage;
+	chunkCounts.assign( chunks, 0 );
+
+	aPool->parallel_for( batches, kChunkBatches, [&] ( std::size_t aBeg, std::size_t aEnd ) {
+		chunkCounts[aBeg / kChunkBatches] = cull_batches_( aTable, aPlanes, aBeg, aEnd, aVisible.data() + aBeg * kCullBatch );
+	} );
+
+	std::size_t total = chunkCounts[0];
+	for( std::size_t i = 1; i < chunks; ++i )
+	{
+		auto const* src = aVisible.data() + i * kChunkBatches * kCullBatch;
+		std::memmove( aVisible.data() + total, src, chunkCounts[i] * sizeof(std::uint32_t) );
+		total += chunkCounts[i];
+	}
+
+	aVisible.resize( total );
+}
+
+void cull_objects_naive( ObjectTable const& aTable, glm::mat4 const& aProjCam, std::vector<std::uint32_t>& aVisible )
+{
+	auto const planes = extract_frustum_planes( aProjCam );
+
+	aVisible.clear();
+	for( std::uint32_t i = 0; i < aTable.count; ++i )
+	{
+		glm::vec3 const center( aTable.centerX[i], aTable.centerY[i], aTable.centerZ[i] );
+		glm::vec3 const extent( aTable.extentX[i], aTable.extentY[i], aTable.extentZ[i] );
+
+		bool inside = true;
+		for( int p = 0; p < 6 && inside; ++p )
+		{
+			glm::vec3 const n( planes.nx[p], planes.ny[p], planes.nz[p] );
+			if( glm::dot( n, center ) + planes.d[p] + glm::dot( glm::abs(n), extent ) < 0.f )
+				inside = false;
+		}
+
+		if( inside )
+			aVisible.emplace_back( i );
+	}
+}
+
+namespace
+{
+	// Emits the indices of the set bits of aMask, relative to aBase.
+	inline
+	std::size_t emit_mask_( std::uint32_t aMask, std::uint32_t aBase, std::uint32_t aCount, std::uint32_t* aOut )
+	{
+		// Mask off padding entries in the last batch
+		if( aBase + kCullBatch > aCount )
+			aMask &= (1u << (aCount - aBase)) - 1u;
+
+		std::size_t n = 0;
+		for( ; aMask; aMask &= aMask - 1u )
+			aOut[n++] = aBase + countr_zero_( aMask );
+
+		return n;
+	}
+
+#	if defined(__AVX__)
+	std::size_t cull_batches_( ObjectTable const& aTable, FrustumPlanes const& aPlanes, std::size_t aBatchBegin, std::size_t aBatchEnd, std::uint32_t* aOut )
+	{
+		__m256 const signBit = _mm256_set1_ps( -0.f );
+		__m256 const zero = _mm256_setzero_ps();
+
+		__m256 nx[6], ny[6], nz[6], d[6], ax[6], ay[6], az[6];
+		for( int p = 0; p < 6; ++p )
+		{
+			nx[p] = _mm256_set1_ps( aPlanes.nx[p] );
+			ny[p] = _mm256_set1_ps( aPlanes.ny[p] );
+			nz[p] = _mm256_set1_ps( aPlanes.nz[p] );
+			d[p]  = _mm256_set1_ps( aPlanes.d[p] );
+			ax[p] = _mm256_andnot_ps( signBit, nx[p] );
+			ay[p] = _mm256_andnot_ps( signBit, ny[p] );
+			az[p] = _mm256_andnot_ps( signBit, nz[p] );
+		}
+
+		std::size_t n = 0;
+		for( std::size_t b = aBatchBegin; b < aBatchEnd; ++b )
+		{
+			std::size_t const i = b * kCullBatch;
+
+			__m256 const cx = _mm256_loadu_ps( aTable.centerX.data() + i );
+			__m256 const cy = _mm256_loadu_ps( aTable.centerY.data() + i );
+			__m256 const cz = _mm256_loadu_ps( aTable.centerZ.data() + i );
+			__m256 const ex = _mm256_loadu_ps( aTable.extentX.data() + i );
+			__m256 const ey = _mm256_loadu_ps( aTable.extentY.data() + i );
+			__m256 const ez = _mm256_loadu_ps( aTable.extentZ.data() + i );
+
+			__m256 inside = _mm256_cmp_ps( zero, zero, _CMP_EQ_OQ ); // all ones
+			for( int p = 0; p < 6; ++p )
+			{
+				__m256 dist = _mm256_add_ps( _mm256_mul_ps( nx[p], cx ), d[p] );
+				dist = _mm256_add_ps( dist, _mm256_mul_ps( ny[p], cy ) );
+				dist = _mm256_add_ps( dist, _mm256_mul_ps( nz[p], cz ) );
+
+				__m256 radius = _mm256_mul_ps( ax[p], ex );
+				radius = _mm256_add_ps( radius, _mm256_mul_ps( ay[p], ey ) );
+				radius = _mm256_add_ps( radius, _mm256_mul_ps( az[p], ez ) );
+
+				inside = _mm256_and_ps( inside, _mm256_cmp_ps( _mm256_add_ps( dist, radius ), zero, _CMP_GE_OQ ) );
+			}
+
+			auto const mask = std::uint32_t(_mm256_movemask_ps( inside ));
+			n += emit_mask_( mask, std::uint32_t(i), aTable.count, aOut + n );
+		}
+
+		return n;
+	}
+#	elif defined(__SSE2__) || defined(_M_X64)
+	std::size_t cull_batches_( ObjectTable const& aTable, FrustumPlanes const& aPlanes, std::size_t aBatchBegin, std::size_t aBatchEnd, std::uint32_t* aOut )
+	{
+		static_assert( 8 == kCullBatch, "SSE path processes a batch as two halves" );
+
+		__m128 const signBit = _mm_set1_ps( -0.f );
+		__m128 const zero = _mm_setzero_ps();
+
+		__m128 nx[6], ny[6], nz[6], d[6], ax[6], ay[6], az[6];
+		for( int p = 0; p < 6; ++p )
+		{
+			nx[p] = _mm_set1_ps( aPlanes.nx[p] );
+			ny[p] = _mm_set1_ps( aPlanes.ny[p] );
+			nz[p] = _mm_set1_ps( aPlanes.nz[p] );
+			d[p]  = _mm_set1_ps( aPlanes.d[p] );
+			ax[p] = _mm_andnot_ps( signBit, nx[p] );
+			ay[p] = _mm_andnot_ps( signBit, ny[p] );
+			az[p] = _mm_andnot_ps( signBit, nz[p] );
+		}
+
+		std::size_t n = 0;
+		for( std::size_t b = aBatchBegin; b < aBatchEnd; ++b )
+		{
+			std::size_t const i = b * kCullBatch;
+
+			std::uint32_t mask = 0;
+			for( std::size_t h = 0; h < 2; ++h )
+			{
+				std::size_t const j = i + h*4;
+
+				__m128 const cx = _mm_loadu_ps( aTable.centerX.data() + j );
+				__m128 const cy = _mm_loadu_ps( aTable.centerY.data() + j );
+				__m128 const cz = _mm_loadu_ps( aTable.centerZ.data() + j );
+				__m128 const ex = _mm_loadu_ps( aTable.extentX.data() + j );
+				__m128 const ey = _mm_loadu_ps( aTable.extentY.data() + j );
+				__m128 const ez = _mm_loadu_ps( aTable.extentZ.data() + j );
+
+				__m128 inside = _mm_cmpeq_ps( zero, zero ); // all ones
+				for( int p = 0; p < 6; ++p )
+				{
+					__m128 dist = _mm_add_ps( _mm_mul_ps( nx[p], cx ), d[p] );
+					dist = _mm_add_ps( dist, _mm_mul_ps( ny[p], cy ) );
+					dist = _mm_add_ps( dist, _mm_mul_ps( nz[p], cz ) );
+
+					__m128 radius = _mm_mul_ps( ax[p], ex );
+					radius = _mm_add_ps( radius, _mm_mul_ps( ay[p], ey ) );
+					radius = _mm_add_ps( radius, _mm_mul_ps( az[p], ez ) );
+
+					inside = _mm_and_ps( inside, _mm_cmpge_ps( _mm_add_ps( dist, radius ), zero ) );
+				}
+
+				mask |= std::uint32_t(_mm_movemask_ps( inside )) << (h*4);
+			}
+
+			n += emit_mask_( mask, std::uint32_t(i), aTable.count, aOut + n );
+		}
+
+		return n;
+	}
+#	else // scalar fallback
+	std::size_t cull_batches_( ObjectTable const& aTable, FrustumPlanes const& aPlanes, std::size_t aBatchBegin, std::size_t aBatchEnd, std::uint32_t* aOut )
+	{
+		std::size_t n = 0;
+		for( std::size_t b = aBatchBegin; b < aBatchEnd; ++b )
+		{
+			std::size_t const i = b * kCullBatch;
+
+			std::uint32_t mask = 0;
+			for( std::size_t k = 0; k < kCullBatch; ++k )
+			{
+				bool inside = true;
+				for( int p = 0; p < 6; ++p )
+				{
+					float const dist = aPlanes.nx[p] * aTable.centerX[i+k] + aPlanes.ny[p] * aTable.centerY[i+k] + aPlanes.nz[p] * aTable.centerZ[i+k] + aPlanes.d[p];
+					float const radius = std::abs(aPlanes.nx[p]) * aTable.extentX[i+k] + std::abs(aPlanes.ny[p]) * aTable.extentY[i+k] + std::abs(aPlanes.nz[p]) * aTable.extentZ[i+k];
+					inside = inside && dist + radius >= 0.f;
+				}
+
+				mask |= std::uint32_t(inside) << k;
+			}
+
+			n += emit_mask_( mask, std::uint32_t(i), aTable.count, aOut + n );
+		}
+
+		return n;
+	}
+#	endif
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#if !defined(GLM_FORCE_RADIANS)
+#	define GLM_FORCE_RADIANS
+#endif
+#include <glm/glm.hpp>
+
+#include "../labutils/thread_pool.hpp"
+
+// Scene object table. Bounding boxes are stored as structure-of-arrays, such
+// that the culler can load the same component of eight boxes with a single
+// (AVX) load. The arrays are padded to a multiple of kCullBatch elements;
+// padding entries are never reported as visible.
+constexpr std::uint32_t kCullBatch = 8;
+
+struct ObjectTable
+{
+	std::vector<float> centerX, centerY, centerZ;
+	std::vector<float> extentX, extentY, extentZ;
+
+	std::uint32_t count = 0;
+};
+
+// Adds an object with the given axis-aligned bounding box (center and
+// half-extents) and returns its index.
+std::uint32_t add_object( ObjectTable&, glm::vec3 const& aCenter, glm::vec3 const& aExtent );
+
+void set_object_bounds( ObjectTable&, std::uint32_t aIndex, glm::vec3 const& aCenter, glm::vec3 const& aExtent );
+
+// Frustum planes, also stored as structure-of-arrays. Planes are normalized
+// and point inwards, i.e., a point p is inside if dot(n,p) + d >= 0 for all
+// planes.
+struct FrustumPlanes
+{
+	float nx[6], ny[6], nz[6], d[6];
+};
+
+// Extracts the planes from a combined projection * camera matrix. Assumes
+// Vulkan clip space (z in [0,w]).
+FrustumPlanes extract_frustum_planes( glm::mat4 const& aProjCam );
+
+// Writes the indices of all objects whose boxes intersect the frustum to
+// aVisible, in ascending order. Uses AVX or SSE when available. If a pool is
+// given, the table is split across its workers.
+void cull_objects(
+	ObjectTable const&,
+	FrustumPlanes const&,
+	std::vector<std::uint32_t>& aVisible,
+	labutils::ThreadPool* = nullptr
+);
+
+// Reference implementation: tests one object at a time using glm types.
+void cull_objects_naive(
+	ObjectTable const&,
+	glm::mat4 const& aProjCam,
+	std::vector<std::uint32_t>& aVisible
+);
+
+// Compares cull_objects() against cull_objects_naive() on a random table with
+// aObjectCount objects and prints the timings to stdout.
+void run_cull_benchmark( std::uint32_t aObjectCount, labutils::ThreadPool& );
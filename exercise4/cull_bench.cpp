@@ -0,0 +1,41 @@
+#include "cull.hpp"
+
+#include <random>
+
+#include <cstdio>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "bench.hpp"
+
+void run_cull_benchmark( std::uint32_t aObjectCount, labutils::ThreadPool& aPool )
+{
+	// Random boxes scattered around the camera. With the camera looking down
+	// -Z, roughly a sixth of them end up in the frustum.
+	std::mt19937 rng( 5822 );
+	std::uniform_real_distribution<float> pos( -100.f, 100.f );
+	std::uniform_real_distribution<float> size( 0.1f, 2.f );
+
+	ObjectTable table;
+	for( std::uint32_t i = 0; i < aObjectCount; ++i )
+		add_object( table, glm::vec3( pos(rng), pos(rng), pos(rng) ), glm::vec3( size(rng), size(rng), size(rng) ) );
+
+	auto proj = glm::perspectiveRH_ZO( glm::radians( 60.f ), 16.f/9.f, 0.1f, 100.f );
+	proj[1][1] *= -1.f;
+	auto const projCam = proj * glm::translate( glm::mat4( 1.f ), glm::vec3( 0.f, -0.3f, -1.f ) );
+
+	std::vector<std::uint32_t> naive, simd, parallel;
+	naive.reserve( aObjectCount );
+
+	auto const naiveMs = time_median_ms( [&] { cull_objects_naive( table, projCam, naive ); } );
+	auto const simdMs = time_median_ms( [&] { cull_objects( table, extract_frustum_planes( projCam ), simd ); } );
+	auto const parallelMs = time_median_ms( [&] { cull_objects( table, extract_frustum_planes( projCam ), parallel, &aPool ); } );
+
+	std::printf( "Culling %u objects (%zu visible), median of %d runs:\n", aObjectCount, naive.size(), kBenchRepeats );
+	std::printf( "  naive (glm, per object) : %8.3f ms\n", naiveMs );
+	std::printf( "  SoA SIMD, 1 thread      : %8.3f ms (%.1fx)\n", simdMs, naiveMs / simdMs );
+	std::printf( "  SoA SIMD, %2zu threads    : %8.3f ms (%.1fx)\n", aPool.thread_count()+1, parallelMs, naiveMs / parallelMs );
+
+	if( naive != simd || naive != parallel )
+		std::printf( "Warning: results differ (naive: %zu, simd: %zu, parallel: %zu visible)\n", naive.size(), simd.size(), parallel.size() );
+}
@@ -0,0 +1,70 @@
+#include "latency.hpp"
+
+#include <algorithm>
+
+#include <cstdio>
+
+namespace
+{
+	struct Percentiles_
+	{
+		float p50, p90, p99, max;
+	};
+
+	// Nearest-rank percentiles. Reorders aSamples.
+	Percentiles_ percentiles_( std::vector<float>& aSamples )
+	{
+		auto const rank = [&] ( float aPercent ) {
+			auto const index = std::size_t(aPercent / 100.f * float(aSamples.size()-1) + 0.5f);
+			std::nth_element( aSamples.begin(), aSamples.begin() + index, aSamples.end() );
+			return aSamples[index];
+		};
+
+		Percentiles_ ret;
+		ret.p50 = rank( 50.f );
+		ret.p90 = rank( 90.f );
+		ret.p99 = rank( 99.f );
+		ret.max = *std::max_element( aSamples.begin(), aSamples.end() );
+		return ret;
+	}
+
+	void print_row_( char const* aName, std::vector<float>& aSamples )
+	{
+		if( aSamples.empty() )
+			return;
+
+		auto const p = percentiles_( aSamples );
+		std::fprintf( stderr, "  %-16s %8.3f %8.3f %8.3f %8.3f\n", aName, p.p50, p.p90, p.p99, p.max );
+	}
+}
+
+void record_frame( LatencyStats& aStats, FrameTimestamps const& aFrame )
+{
+	auto const ms = [] ( LatencyClock::duration aDuration ) {
+		return std::chrono::duration<float,std::milli>( aDuration ).count();
+	};
+
+	aStats.pollToSubmit.emplace_back( ms( aFrame.submit - aFrame.inputPoll ) );
+	aStats.pollToPresent.emplace_back( ms( aFrame.presentReturn - aFrame.inputPoll ) );
+
+	if( LatencyClock::time_point{} != aStats.lastPoll )
+		aStats.frameInterval.emplace_back( ms( aFrame.inputPoll - aStats.lastPoll ) );
+
+	aStats.lastPoll = aFrame.inputPoll;
+}
+
+void report_latency( LatencyStats& aStats, char const* aLabel )
+{
+	if( aStats.pollToPresent.empty() )
+		return;
+
+	std::fprintf( stderr, "Latency over %zu frames (%s), in ms:\n", aStats.pollToPresent.size(), aLabel );
+	std::fprintf( stderr, "  %-16s %8s %8s %8s %8s\n", "", "p50", "p90", "p99", "max" );
+	print_row_( "poll -> submit", aStats.pollToSubmit );
+	print_row_( "poll -> present", aStats.pollToPresent );
+	print_row_( "frame interval", aStats.frameInterval );
+
+	aStats.pollToSubmit.clear();
+	aStats.pollToPresent.clear();
+	aStats.frameInterval.clear();
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <chrono>
+#include <vector>
+#include <cstdint>
+
+// CPU-side frame latency instrumentation. Each frame records when input was
+// polled, when the frame's commands were submitted and when the present call
+// returned. The poll-to-present interval is an estimate of the input latency
+// that the application controls; the time from present until the image is
+// actually shown depends on the present mode and the swap chain depth, and
+// adds to this.
+using LatencyClock = std::chrono::steady_clock;
+
+struct FrameTimestamps
+{
+	LatencyClock::time_point inputPoll;
+	LatencyClock::time_point submit;
+	LatencyClock::time_point presentReturn;
+};
+
+struct LatencyStats
+{
+	// Durations in milliseconds, one entry per frame
+	std::vector<float> pollToSubmit;
+	std::vector<float> pollToPresent;
+	std::vector<float> frameInterval; // between consecutive input polls
+
+	LatencyClock::time_point lastPoll{};
+};
+
+void record_frame( LatencyStats&, FrameTimestamps const& );
+
+// Prints the 50th, 90th, 99th percentiles and the maximum of the collected
+// samples to stderr and resets the statistics.
+void report_latency( LatencyStats&, char const* aLabel );
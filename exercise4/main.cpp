@@ -1,18 +1,23 @@
 #include <volk/volk.h>
 
 #include <tuple>
+#include <chrono>
 #include <limits>
+#include <iterator>
 #include <vector>
+#include <optional>
+#include <algorithm>
 #include <stdexcept>
 
+#include <csignal>
+
 #include <cstdio>
 #include <cassert>
 #include <cstddef>
 #include <cstdint>
+#include <cstdlib>
 #include <cstring>
 
-#include <stb_image_write.h>
-
 #define GLFW_INCLUDE_NONE
 #include <GLFW/glfw3.h>
 
@@ -35,9 +40,28 @@ using namespace labutils::literals;
 #include "../labutils/vkobject.hpp"
 #include "../labutils/vkbuffer.hpp"
 #include "../labutils/allocator.hpp" 
+#include "../labutils/deletion_queue.hpp"
+#include "../labutils/descriptor_allocator.hpp"
+#include "../labutils/descriptor_writer.hpp"
+#include "../labutils/pipeline_cache.hpp"
+#include "../labutils/sampler_cache.hpp"
+#include "../labutils/memory_stats.hpp"
+#include "../labutils/defragmenter.hpp"
+#include "../labutils/render_graph.hpp"
+#include "../labutils/barrier_batch.hpp"
+#include "../labutils/mip_generator.hpp"
+#include "../labutils/embedded_spirv.hpp"
 namespace lut = labutils;
 
 #include "vertex_data.hpp"
+#include "cull.hpp"
+#include "scene_graph.hpp"
+#include "render_queue.hpp"
+#include "offscreen.hpp"
+#include "latency.hpp"
+#include "pipelines.hpp"
+#include "shader_reload.hpp"
+#include "bindless.hpp"
 
 namespace
 {
@@ -48,13 +72,10 @@ namespace
 #		define SHADERDIR_ "assets/exercise4/shaders/"
 		constexpr char const* kVertShaderPath = SHADERDIR_ "shaderTex.vert.spv";
 		constexpr char const* kFragShaderPath = SHADERDIR_ "shaderTex.frag.spv";
-		constexpr char const* kAlphaVertShaderPath = SHADERDIR_ "shaderTex.vert.spv";
-		constexpr char const* kAlphaFragShaderPath = SHADERDIR_ "shaderTexAlpha.frag.spv";
+		constexpr char const* kBindlessFragShaderPath = SHADERDIR_ "shaderTexBindless.frag.spv";
+		constexpr char const* kMipGenShaderPath = SHADERDIR_ "mipgen.comp.spv";
 #		undef SHADERDIR_
 
-
-
-
 		// General rule: with a standard 24 bit or 32 bit float depth buffer,
 		// you can support a 1:1000 ratio between the near and far plane with
 		// minimal depth fighting. Larger ratios will introduce more depth
@@ -68,14 +89,115 @@ namespace
 		#define ASSERTDIR_ "assets/exercise4/" 
 		constexpr char const* kFloorTextures = ASSERTDIR_ "asphalt-%u.png"; 
 		constexpr char const* kSpriteTextures = ASSERTDIR_ "explosion-%u.png";
+
+		// Pipeline cache, loaded at startup and written back at exit
+		constexpr char const* kPipelineCachePath = ASSERTDIR_ "pipelines.cache";
+
+		// Shader hot reload (--hot-reload): GLSL sources, the directory with
+		// the compiled SPIR-V, and the bundled compiler. See util/glslc.lua.
+		constexpr char const* kShaderSourceDir = "exercise4/shaders";
+		constexpr char const* kShaderSpirvDir = ASSERTDIR_ "shaders";
+#		if defined(_WIN32)
+		constexpr char const* kGlslcPath = "third_party/shaderc/win-x86_64/glslc.exe";
+#		else
+		constexpr char const* kGlslcPath = "third_party/shaderc/linux-x86_64/glslc";
+#		endif
 		#undef ASSERTDIR_
 
 		constexpr VkFormat kDepthFormat = VK_FORMAT_D32_SFLOAT;
+
+		// Capacity of the per-frame transform ring (see scene_graph.hpp)
+		constexpr std::uint32_t kMaxSceneNodes = 1024;
+
+		// Maximum number of frames that are being recorded or executed at
+		// the same time. Per-frame resources exist this many times.
+		constexpr std::uint32_t kFramesInFlight = 2;
+
+		// Slots in the bindless texture table (--bindless; see bindless.hpp)
+		constexpr std::uint32_t kBindlessTextures = 1024;
+
+		// Headless mode: color format of the offscreen images (one per frame
+		// in flight). Frames to render if --frames is not given.
+		constexpr VkFormat kHeadlessFormat = VK_FORMAT_R8G8B8A8_SRGB;
+		constexpr std::uint32_t kHeadlessDefaultFrames = 100;
+
+		// With --latency, print statistics every this many frames
+		constexpr std::uint32_t kLatencyReportFrames = 600;
+
+		// GPU memory: budgets are checked every this many frames (and
+		// printed with --memory-stats). A warning is printed when a heap's
+		// usage exceeds this fraction of its budget. Snapshots requested
+		// with the M key or SIGUSR1 are written to kMemoryStatsPath.
+		constexpr std::uint32_t kMemoryReportFrames = 600;
+		constexpr float kMemoryBudgetWarning = 0.9f;
+		constexpr char const* kMemoryStatsPath = "memory-stats.json";
+
+		// Defragmentation (--defrag): upper bound for the data copied per
+		// round, and frames to wait after a round that found nothing to move
+		constexpr VkDeviceSize kDefragBytesPerRound = 16*1024*1024;
+		constexpr std::uint32_t kDefragIdleFrames = 300;
 	}
 
+	// Command line options
+	struct Options
+	{
+		// Benchmarks (see cull.hpp and render_queue.hpp); the number of
+		// objects or draws, or zero if the benchmark was not requested.
+		std::uint32_t benchCull = 0;
+		std::uint32_t benchQueue = 0;
+
+		// Render into offscreen images instead of a window
+		bool headless = false;
+		VkExtent2D headlessExtent{ 1280, 720 };
+
+		// Stop after this many frames. Zero means until the window is closed.
+		std::uint32_t frameCount = 0;
+
+		// Write the last frame to this PNG file (headless mode only)
+		char const* outputPath = nullptr;
+
+		// Presentation policy (see lut::PresentConfig)
+		VkPresentModeKHR presentMode = VK_PRESENT_MODE_MAX_ENUM_KHR;
+		std::uint32_t swapImageCount = 0;
+
+		// Collect and print frame latency statistics (see latency.hpp)
+		bool latency = false;
+
+		// Neither load nor save the pipeline cache
+		bool noPipelineCache = false;
+
+		// Recompile shaders when their sources change
+		bool hotReload = false;
+
+		// Select textures from a single descriptor array (see bindless.hpp)
+		bool bindless = false;
+
+		// Print GPU memory budgets and usage periodically
+		bool memoryStats = false;
+
+		// Compact GPU memory in the background (see lut::Defragmenter)
+		bool defragment = false;
+
+		// Generate texture mip levels with the compute shader rather than
+		// with blits (see lut::MipGenerator)
+		bool computeMips = false;
+
+		// Render with VK_KHR_dynamic_rendering instead of a render pass and
+		// framebuffers, if supported
+		bool dynamicRendering = false;
+	};
+
+	Options parse_options( int aArgc, char* aArgv[] );
+
 	// GLFW callbacks
 	void glfw_callback_key_press( GLFWwindow*, int, int, int, int );
 
+	// Set by the M key or by SIGUSR1; the main loop then writes a memory
+	// statistics snapshot.
+	volatile std::sig_atomic_t gMemoryStatsRequested = 0;
+
+	void signal_request_memory_stats( int );
+
 	// Uniform data
 	namespace glsl
 	{
@@ -92,21 +214,73 @@ namespace
 
 	}
 
+	// Alpha handling of an object. The values match the kAlphaMode
+	// specialization constant in shaderTex.frag and are also the index of the
+	// pipeline in draw keys.
+	enum class AlphaMode : std::uint32_t
+	{
+		opaque = 0,
+		blend = 1,
+		test = 2
+	};
+
+	constexpr std::uint32_t kAlphaModeCount = 3;
+
+	// Per-object data used when recording draws. Objects are identified by
+	// their index in the ObjectTable (see cull.hpp).
+	struct SceneObject
+	{
+		TexturedMesh const* mesh;
+		VkDescriptorSet objectDescriptors;
+		AlphaMode alphaMode;
+
+		// Slot in the bindless texture table; used instead of
+		// objectDescriptors in bindless mode.
+		std::uint32_t textureIndex;
+
+		// Identifies objectDescriptors in draw keys (see render_queue.hpp).
+		// Objects that share descriptors should share the material.
+		std::uint32_t material;
+
+		// Node in the SceneGraph; also the instance index used when drawing
+		std::uint32_t node;
+
+		// Bounding box in object space
+		glm::vec3 boundsCenter, boundsExtent;
+	};
+
 	// Helpers:
-	lut::RenderPass create_render_pass( lut::VulkanWindow const& );
+	// The attachments are expected in, and left in, their attachment layouts;
+	// the frame graph transitions them before and after the render pass.
+	lut::RenderPass create_render_pass( lut::VulkanContext const&, VkFormat aColorFormat );
+
+	lut::DescriptorSetLayout create_scene_descriptor_layout( lut::VulkanContext const& );
+	lut::DescriptorSetLayout create_object_descriptor_layout( lut::VulkanContext const& );
+
+	// Contents of a per-object descriptor set, in the format expected by the
+	// template from create_object_descriptor_template().
+	struct ObjectDescriptors
+	{
+		VkDescriptorImageInfo texture; // binding 0
+	};
 
-	lut::DescriptorSetLayout create_scene_descriptor_layout( lut::VulkanWindow const& );
-	lut::DescriptorSetLayout create_object_descriptor_layout( lut::VulkanWindow const& );
+	lut::DescriptorUpdateTemplate create_object_descriptor_template( lut::VulkanContext const&, VkDescriptorSetLayout aObjectLayout );
 
 	lut::PipelineLayout create_pipeline_layout( lut::VulkanContext const&, VkDescriptorSetLayout aSceneLayout, VkDescriptorSetLayout aObjectlayout);
-	lut::Pipeline create_pipeline( lut::VulkanWindow const&, VkRenderPass, VkPipelineLayout );
-	lut::Pipeline create_alpha_pipeline(lut::VulkanWindow const&, VkRenderPass, VkPipelineLayout);
+	// With dynamic rendering, the render pass is VK_NULL_HANDLE and the
+	// pipelines are created for the given attachment formats instead.
+	PipelineDesc make_pipeline_desc( VkRenderPass, VkFormat aColorFormat, VkFormat aDepthFormat, VkPipelineLayout, AlphaMode, bool aBindless );
 
-	std::tuple<lut::Image, lut::ImageView> create_depth_buffer( lut::VulkanWindow const&, lut::Allocator const& );
+	// The depth buffer is only used within the render pass (it is cleared
+	// and not stored), so it is a transient attachment.
+	std::tuple<lut::Image, lut::ImageView> create_depth_buffer( lut::VulkanContext const&, lut::Allocator const&, VkExtent2D const&, bool* aLazilyAllocated = nullptr );
 
-	void create_swapchain_framebuffers( 
-		lut::VulkanWindow const&, 
+	// Creates one framebuffer per color view (swap chain or offscreen image)
+	void create_framebuffers( 
+		lut::VulkanContext const&, 
 		VkRenderPass,
+		std::vector<VkImageView> const& aColorViews,
+		VkExtent2D const&,
 		std::vector<lut::Framebuffer>&, 
 		VkImageView aDepthView
 	);
@@ -117,28 +291,67 @@ namespace
 		std::uint32_t aFramebufferHeight
 	);
 
-	void record_commands( 
+	void update_object_bounds(
+		ObjectTable&,
+		SceneGraph const&,
+		std::vector<SceneObject> const&,
+		std::vector<std::int32_t> const& aNodeObjects
+	);
+
+	void build_render_queue(
+		RenderQueue&,
+		ObjectTable const&,
+		std::vector<SceneObject> const&,
+		std::vector<std::uint32_t> const& aVisibleObjects,
+		glm::mat4 const& aCamera
+	);
+
+	// Target of the scene pass: a render pass and framebuffer, or, with
+	// dynamic rendering (renderPass is VK_NULL_HANDLE), the attachment views.
+	struct SceneTarget
+	{
+		VkRenderPass renderPass;
+		VkFramebuffer framebuffer;
+		VkImageView colorView;
+		VkImageView depthView;
+	};
+
+	// Per-frame inputs of the passes in the frame graph. The passes read
+	// these when the graph is executed.
+	struct FrameInputs
+	{
+		glsl::SceneUniform sceneUniforms;
+		SceneTarget target;
+		VkDeviceSize instanceOffset;
+	};
+
+	// Passes of the frame graph
+	void record_scene_upload(
 		VkCommandBuffer,
-		VkRenderPass,
-		VkFramebuffer,
-		VkPipeline,
+		VkBuffer aSceneUBO,
+		glsl::SceneUniform const&
+	);
+	void record_scene_pass(
+		VkCommandBuffer,
+		SceneTarget const&,
+		VkPipeline const* aPipelines, // indexed by AlphaMode
 		VkExtent2D const&,
-		VkBuffer aPositionBuffer,
-		VkBuffer aTexCoordBuffer,
-		std::uint32_t aVertexCount,
-		VkBuffer aSceneUBO, 
-		glsl::SceneUniform const&, 
-		VkPipelineLayout, 
+		VkPipelineLayout,
 		VkDescriptorSet aSceneDescriptors,
-		VkDescriptorSet aObjectDescriptors,
-		VkBuffer aSpritePosBuffer, 
-		VkBuffer aSpriteTexBuffer,
-		std::uint32_t aSpriteVertexCount, 
-		VkDescriptorSet aSpriteObjDescriptors,
-		VkPipeline aAlphaPipeline
+		VkDescriptorSet aTextureTable, // bindless mode only, else VK_NULL_HANDLE
+		VkBuffer aInstanceBuffer,
+		VkDeviceSize aInstanceOffset,
+		std::vector<SceneObject> const&,
+		RenderQueue const&
+	);
+
+	// Records the frame graph (with its barriers) into the command buffer
+	void record_commands(
+		VkCommandBuffer,
+		lut::RenderGraph const&
 	);
 	void submit_commands(
-		lut::VulkanWindow const&,
+		lut::VulkanContext const&,
 		VkCommandBuffer,
 		VkFence,
 		VkSemaphore,
@@ -154,241 +367,679 @@ namespace
 }
 
 
-int main() try
+int main( int aArgc, char* aArgv[] ) try
 {
-	// Create Vulkan Window
-	auto window = lut::make_vulkan_window();
+	auto const options = parse_options( aArgc, aArgv );
+
+	// Benchmark the frustum culler or the draw sorting instead of running the
+	// renderer?
+	if( options.benchCull )
+	{
+		lut::ThreadPool pool;
+		run_cull_benchmark( options.benchCull, pool );
+		return 0;
+	}
+
+	if( options.benchQueue )
+	{
+		run_queue_benchmark( options.benchQueue );
+		return 0;
+	}
+
+	// Create Vulkan Window, or just a Vulkan context in headless mode. The
+	// latter requires neither a display nor any presentation support, so it
+	// also runs with software implementations (e.g. lavapipe).
+	lut::VulkanWindow window;
+	lut::VulkanContext headlessContext;
 
-	// Configure the GLFW window
-	glfwSetKeyCallback( window.window, &glfw_callback_key_press );
+	lut::DeviceConfig deviceConfig;
+	deviceConfig.descriptorIndexing = options.bindless;
+	deviceConfig.memoryBudget = true;
+	deviceConfig.synchronization2 = true;
+	deviceConfig.dynamicRendering = options.dynamicRendering;
+
+	if( options.headless )
+	{
+		headlessContext = lut::make_vulkan_context( deviceConfig );
+	}
+	else
+	{
+		lut::PresentConfig presentConfig;
+		presentConfig.presentMode = options.presentMode;
+		presentConfig.imageCount = options.swapImageCount;
+
+		window = lut::make_vulkan_window( presentConfig, deviceConfig );
+
+		std::fprintf( stderr, "Present mode: %s, %zu swap chain images\n", lut::to_string(window.presentMode).c_str(), window.swapImages.size() );
+
+		// Configure the GLFW window
+		glfwSetKeyCallback( window.window, &glfw_callback_key_press );
+	}
+
+	lut::VulkanContext const& context = options.headless ? headlessContext : window;
+
+	// Bindless mode needs descriptor indexing. Without it, fall back to the
+	// per-object descriptor sets.
+	bool const bindless = options.bindless && context.haveDescriptorIndexing;
+	if( options.bindless && !bindless )
+		std::fprintf( stderr, "Descriptor indexing is not supported; --bindless is ignored\n" );
+
+	// Without dynamic rendering, fall back to a render pass with one
+	// framebuffer per color view.
+	bool const dynamicRendering = options.dynamicRendering && context.haveDynamicRendering;
+	if( options.dynamicRendering && !dynamicRendering )
+		std::fprintf( stderr, "VK_KHR_dynamic_rendering is not supported; --dynamic-rendering is ignored\n" );
 
 	// Create VMA allocator
-	lut::Allocator allocator = lut::create_allocator( window );
+	lut::Allocator allocator = lut::create_allocator( context );
+
+	if( !context.haveMemoryBudget )
+		std::fprintf( stderr, "VK_EXT_memory_budget is not supported; memory budgets are estimates\n" );
 
-	// Intialize resources
-	lut::RenderPass renderPass = create_render_pass( window );
+	std::fprintf( stderr, "Barriers: %s\n", context.haveSynchronization2 ? "vkCmdPipelineBarrier2KHR (synchronization2)" : "vkCmdPipelineBarrier" );
+	std::fprintf( stderr, "Rendering: %s\n", dynamicRendering ? "vkCmdBeginRenderingKHR (dynamic rendering)" : "render pass and framebuffers" );
 
-	lut::DescriptorSetLayout sceneLayout = create_scene_descriptor_layout(window);
-	lut::DescriptorSetLayout objectLayout = create_object_descriptor_layout(window);
+#	if defined(SIGUSR1)
+	std::signal( SIGUSR1, &signal_request_memory_stats );
+#	endif
 
+	// Color targets: swap chain images, or offscreen images that take their
+	// place in headless mode.
+	OffscreenTargets offscreen;
+	if( options.headless )
+		offscreen = create_offscreen_targets( context, allocator, cfg::kHeadlessFormat, options.headlessExtent, cfg::kFramesInFlight );
 
-	lut::PipelineLayout pipeLayout = create_pipeline_layout( window, sceneLayout.handle, objectLayout.handle );
-	lut::Pipeline pipe = create_pipeline( window, renderPass.handle, pipeLayout.handle );
-	lut::Pipeline alphaPipe = create_alpha_pipeline(window, renderPass.handle, pipeLayout.handle);
+	auto const& colorViews = options.headless ? offscreen.viewHandles : window.swapViews;
 
-	auto[depthBuffer, depthBufferView] = create_depth_buffer(window, allocator);
+	VkFormat colorFormat = options.headless ? offscreen.format : window.swapchainFormat;
+	VkExtent2D renderExtent = options.headless ? offscreen.extent : window.swapchainExtent;
 
+	// Intialize resources. Dynamic rendering needs no render pass.
+	lut::RenderPass renderPass;
+	if( !dynamicRendering )
+		renderPass = create_render_pass( context, colorFormat );
+
+	lut::DescriptorSetLayout sceneLayout = create_scene_descriptor_layout(context);
+	lut::DescriptorSetLayout objectLayout = create_object_descriptor_layout(context);
+
+
+	// In bindless mode, set 1 is the texture table instead of the per-object
+	// texture.
+	BindlessTextures bindlessTextures;
+	if( bindless )
+		bindlessTextures = create_bindless_textures( context, cfg::kBindlessTextures );
+
+	lut::PipelineLayout pipeLayout = bindless
+		? create_bindless_pipeline_layout( context, sceneLayout.handle, bindlessTextures )
+		: create_pipeline_layout( context, sceneLayout.handle, objectLayout.handle )
+	;
+
+	// Pipeline cache. The data from a previous run lets the driver skip most
+	// of the shader compilation when creating the pipelines below.
+	lut::PipelineCache pipeCache;
+	lut::PipelineCacheSeed pipeCacheSeed;
+
+	if( !options.noPipelineCache )
+		pipeCache = lut::create_pipeline_cache( context, cfg::kPipelineCachePath, &pipeCacheSeed );
+
+	// Workers for per-frame jobs. At startup, they also compile the pipelines.
+	lut::ThreadPool workers;
+
+	// Pipelines for the current render pass (or attachment formats, with
+	// dynamic rendering). These are compiled in parallel
+	// and are all ready before the first frame.
+	PipelineRegistry pipelines( context, pipeCache.handle );
+
+	// One pipeline per alpha mode, indexed by AlphaMode
+	VkPipeline pipes[kAlphaModeCount]{};
+	auto const find_pipelines_ = [&] {
+		for( std::uint32_t i = 0; i < kAlphaModeCount; ++i )
+			pipes[i] = pipelines.find( make_pipeline_desc( renderPass.handle, colorFormat, cfg::kDepthFormat, pipeLayout.handle, AlphaMode(i), bindless ) );
+	};
+	auto const create_pipelines_ = [&] {
+		for( std::uint32_t i = 0; i < kAlphaModeCount; ++i )
+			pipelines.request( make_pipeline_desc( renderPass.handle, colorFormat, cfg::kDepthFormat, pipeLayout.handle, AlphaMode(i), bindless ) );
+		pipelines.create_pending( &workers );
+
+		find_pipelines_();
+	};
+
+	auto const pipeStart = std::chrono::steady_clock::now();
+
+	create_pipelines_();
+
+	auto const pipeMs = std::chrono::duration<double,std::milli>( std::chrono::steady_clock::now() - pipeStart ).count();
+
+	if( pipeCacheSeed.seeded )
+	{
+		std::fprintf( stderr, "Created pipelines in %.2f ms using %zu bytes of cached data (%.2f ms without cache, saved %.2f ms)\n", pipeMs, pipeCacheSeed.bytes, pipeCacheSeed.coldCreateMs, pipeCacheSeed.coldCreateMs - pipeMs );
+	}
+	else
+	{
+		std::fprintf( stderr, "Created pipelines in %.2f ms without cached data\n", pipeMs );
+	}
+
+	report_pipeline_times( pipelines );
+
+	std::optional<ShaderReloader> shaderReloader;
+	if( options.hotReload )
+		shaderReloader.emplace( cfg::kGlslcPath, cfg::kShaderSourceDir, cfg::kShaderSpirvDir );
+
+	bool depthLazy = false;
+	auto[depthBuffer, depthBufferView] = create_depth_buffer(context, allocator, renderExtent, &depthLazy);
+
+	std::fprintf( stderr, "Depth buffer: %s\n", depthLazy ? "lazily allocated memory" : "device-local memory (no lazily allocated memory type)" );
+
+	// Dynamic rendering uses the views directly
 	std::vector<lut::Framebuffer> framebuffers;
-	create_swapchain_framebuffers( window, renderPass.handle, framebuffers, depthBufferView.handle);
+	if( !dynamicRendering )
+		create_framebuffers( context, renderPass.handle, colorViews, renderExtent, framebuffers, depthBufferView.handle);
 
-	lut::CommandPool cpool = lut::create_command_pool( window, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT );
+	lut::CommandPool cpool = lut::create_command_pool( context, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT );
 
+	// Per-frame resources. Frame N uses slot N % kFramesInFlight; the slot's
+	// fence tells when the frame that used the slot before has completed.
 	std::vector<VkCommandBuffer> cbuffers;
 	std::vector<lut::Fence> cbfences;
+	std::vector<lut::Semaphore> imageAvailable;
 	
-	for( std::size_t i = 0; i < framebuffers.size(); ++i )
+	for( std::size_t i = 0; i < cfg::kFramesInFlight; ++i )
 	{
-		cbuffers.emplace_back( lut::alloc_command_buffer( window, cpool.handle ) );
-		cbfences.emplace_back( lut::create_fence( window, VK_FENCE_CREATE_SIGNALED_BIT ) );
+		cbuffers.emplace_back( lut::alloc_command_buffer( context, cpool.handle ) );
+		cbfences.emplace_back( lut::create_fence( context, VK_FENCE_CREATE_SIGNALED_BIT ) );
+		imageAvailable.emplace_back( lut::create_semaphore( context ) );
 	}
 
-	lut::Semaphore imageAvailable = lut::create_semaphore( window );
-	lut::Semaphore renderFinished = lut::create_semaphore( window );
+	// Rendering-finished semaphores are waited on by the presentation engine.
+	// They exist per swap chain image: a semaphore can only be reused once
+	// the image is acquired again, at which point the previous presentation
+	// of that image has consumed it.
+	std::vector<lut::Semaphore> renderFinished;
+	for( std::size_t i = 0; i < colorViews.size(); ++i )
+		renderFinished.emplace_back( lut::create_semaphore( context ) );
 
 	// Load data
 	//ColorizedMesh triangleMesh = create_triangle_mesh( window, allocator );
-	TexturedMesh planeMesh = create_plane_mesh(window, allocator);
-	TexturedMesh spriteMesh = create_sprite_mesh(window, allocator);
+	TexturedMesh planeMesh = create_plane_mesh(context, allocator);
+	TexturedMesh spriteMesh = create_sprite_mesh(context, allocator);
 
 	lut::Buffer sceneUBO = lut::create_buffer(allocator, sizeof(glsl::SceneUniform), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_ONLY );
 
-	lut::DescriptorPool dpool = lut::create_descriptor_pool(window);
-
-	VkDescriptorSet sceneDescriptors = lut::alloc_desc_set(window, dpool.handle, sceneLayout.handle);
-	{ 
-		VkWriteDescriptorSet desc[1]{}; 
-		
-		VkDescriptorBufferInfo sceneUboInfo{}; 
-		sceneUboInfo.buffer = sceneUBO.buffer; 
-		sceneUboInfo.range = VK_WHOLE_SIZE; 
-		
-		desc[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET; 
-		desc[0].dstSet = sceneDescriptors; 
-		desc[0].dstBinding = 0; 
-		desc[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER; 
-		desc[0].descriptorCount = 1; 
-		desc[0].pBufferInfo = &sceneUboInfo; 
-		
-		
-		constexpr auto numSets = sizeof(desc) / sizeof(desc[0]); 
-		vkUpdateDescriptorSets(window.device, numSets, desc, 0, nullptr); 
+	// Textures. Mip levels are generated with a chain of blits, or with
+	// --compute-mips in a single compute dispatch per texture where possible.
+	// The compute shader is only built with `premake5 --compute-mips`. If the
+	// compute pipeline cannot be created, the blits are used.
+	std::optional<lut::MipGenerator> mipGenerator;
+	if( options.computeMips )
+	{
+		try
+		{
+			mipGenerator.emplace( context, allocator, cfg::kMipGenShaderPath );
+		}
+		catch( std::exception const& eErr )
+		{
+			std::fprintf( stderr, "Compute mip generation is unavailable; using blits:\n%s\n", eErr.what() );
+		}
 	}
-	//TODO- (Section 3) initialize descriptor set with vkUpdateDescriptorSets
+
+	auto const report_mips_ = [] ( char const* aName, lut::MipGenerationStats const& aStats ) {
+		std::fprintf( stderr, "Mip generation (%s): %s, %u barrier commands", aName, aStats.compute ? "compute" : "blit", aStats.barrierCalls );
+		if( aStats.haveGpuTime )
+			std::fprintf( stderr, ", %.3f ms GPU", aStats.gpuMs );
+		std::fprintf( stderr, "\n" );
+	};
 
 	lut::Image floorTex; 
+	VkImageCreateInfo floorTexInfo{};
 	
 	{ 
-		lut::CommandPool loadCmdPool = lut::create_command_pool(window, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
+		lut::CommandPool loadCmdPool = lut::create_command_pool(context, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
 		
-		floorTex = lut::load_image_texture2d(cfg::kFloorTextures, window, loadCmdPool.handle, allocator);
+		lut::MipGenerationStats mipStats;
+		floorTex = lut::load_image_texture2d(cfg::kFloorTextures, context, loadCmdPool.handle, allocator, &floorTexInfo, mipGenerator ? &*mipGenerator : nullptr, &mipStats);
+		report_mips_( "floor", mipStats );
 	}
-	lut::ImageView floorView = lut::create_image_view_texture2d(window, floorTex.image, VK_FORMAT_R8G8B8A8_SRGB);
-
-	lut::Sampler defaultSampler = lut::create_default_sampler(window);
+	lut::ImageView floorView = lut::create_image_view_texture2d(context, floorTex.image, VK_FORMAT_R8G8B8A8_SRGB, lut::texture2d_view_usage(floorTexInfo));
 
-	//TODO- (Section 4) allocate and initialize descriptor sets for texture
-	VkDescriptorSet floorDescriptors = lut::alloc_desc_set(window, dpool.handle,  objectLayout.handle);
-	{ 
-		VkWriteDescriptorSet desc[1]{}; 
-		
-		VkDescriptorImageInfo textureInfo{}; 
-		textureInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL; 
-		textureInfo.imageView = floorView.handle; 
-		textureInfo.sampler = defaultSampler.handle; 
-		
-		desc[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET; 
-		desc[0].dstSet = floorDescriptors; 
-		desc[0].dstBinding = 0; 
-		desc[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER; 
-		desc[0].descriptorCount = 1; 
-		desc[0].pImageInfo = &textureInfo; 
-		
-		
-		constexpr auto numSets = sizeof(desc) / sizeof(desc[0]); 
-		vkUpdateDescriptorSets(window.device, numSets, desc, 0, nullptr); 
-	}
-	
 	lut::Image spriteTex; 
+	VkImageCreateInfo spriteTexInfo{};
 	{ 
-		lut::CommandPool loadCmdPool = lut::create_command_pool(window, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
+		lut::CommandPool loadCmdPool = lut::create_command_pool(context, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
 		
-		spriteTex = lut::load_image_texture2d(cfg::kSpriteTextures, window, loadCmdPool.handle, allocator);
+		lut::MipGenerationStats mipStats;
+		spriteTex = lut::load_image_texture2d(cfg::kSpriteTextures, context, loadCmdPool.handle, allocator, &spriteTexInfo, mipGenerator ? &*mipGenerator : nullptr, &mipStats);
+		report_mips_( "sprite", mipStats );
 	} 
 		
-	lut::ImageView spriteView = lut::create_image_view_texture2d(window, spriteTex.image, VK_FORMAT_R8G8B8A8_SRGB);
+	lut::ImageView spriteView = lut::create_image_view_texture2d(context, spriteTex.image, VK_FORMAT_R8G8B8A8_SRGB, lut::texture2d_view_usage(spriteTexInfo));
 
-	VkDescriptorSet spriteDescriptors = lut::alloc_desc_set(window, dpool.handle, objectLayout.handle);
-	{ 
-		VkWriteDescriptorSet desc[1]{}; 
-		
-		VkDescriptorImageInfo textureInfo{}; 
-		textureInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL; 
-		textureInfo.imageView = spriteView.handle; 
-		textureInfo.sampler = defaultSampler.handle; 
-		
-		desc[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET; 
-		desc[0].dstSet = spriteDescriptors; 
-		desc[0].dstBinding = 0; 
-		desc[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER; 
-		desc[0].descriptorCount = 1; 
-		desc[0].pImageInfo = &textureInfo; 
-		
-		
-		constexpr auto numSets = sizeof(desc) / sizeof(desc[0]); 
-		vkUpdateDescriptorSets(window.device, numSets, desc, 0, nullptr); 
+	// Only needed while loading
+	mipGenerator.reset();
+
+	{
+		auto const counters = lut::barrier_counters();
+		std::fprintf( stderr, "Texture uploads: %llu image barriers in %llu pipeline barrier calls\n", (unsigned long long)counters.imageBarriers, (unsigned long long)counters.calls );
 	}
+
+	// Samplers are shared between all materials that use the same
+	// parameters.
+	lut::SamplerCache samplers( context );
+
+	VkSampler const defaultSampler = samplers.get( lut::default_sampler_info() );
+
+	// Long-lived descriptor sets. Further pools are added when needed.
+	lut::DescriptorAllocator descriptors( context );
+
+	VkDescriptorSet sceneDescriptors = descriptors.allocate( sceneLayout.handle );
+
+	// Writes that do not fit the per-object template below are collected
+	// and applied with a single vkUpdateDescriptorSets() call.
+	lut::DescriptorWriter descriptorWriter;
+	descriptorWriter.write_buffer( sceneDescriptors, 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, sceneUBO.buffer );
+
+	std::uint32_t floorTexIndex = 0, spriteTexIndex = 0;
+	if( bindless )
+	{
+		floorTexIndex = add_bindless_texture( bindlessTextures, descriptorWriter, floorView.handle, defaultSampler );
+		spriteTexIndex = add_bindless_texture( bindlessTextures, descriptorWriter, spriteView.handle, defaultSampler );
+	}
+
+	descriptorWriter.update( context );
+
+	// Per-object sets are written from an ObjectDescriptors struct with one
+	// vkUpdateDescriptorSetWithTemplate() call each.
+	lut::DescriptorUpdateTemplate objectTemplate = create_object_descriptor_template( context, objectLayout.handle );
+
+	VkDescriptorSetLayout const objectLayouts[] = { objectLayout.handle, objectLayout.handle };
+	VkDescriptorSet objectSets[2]{};
+	descriptors.allocate( 2, objectLayouts, objectSets );
+
+	VkDescriptorSet const floorDescriptors = objectSets[0];
+	VkDescriptorSet const spriteDescriptors = objectSets[1];
+
+	ObjectDescriptors const floorData{ { defaultSampler, floorView.handle, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL } };
+	vkUpdateDescriptorSetWithTemplate( context.device, floorDescriptors, objectTemplate.handle, &floorData );
+
+	ObjectDescriptors const spriteData{ { defaultSampler, spriteView.handle, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL } };
+	vkUpdateDescriptorSetWithTemplate( context.device, spriteDescriptors, objectTemplate.handle, &spriteData );
+
+	std::fprintf( stderr, "Samplers: %zu live (device limit %u), %zu requests shared an existing sampler\n", samplers.live_count(), samplers.max_count(), samplers.hit_count() );
+
+	// Scene objects. The bounds match the vertex data in vertex_data.cpp.
+	// All objects hang off a common root node. A second, alpha-tested copy
+	// of the sprite stands behind the blended one.
+	SceneGraph sceneGraph;
+	auto const sceneRoot = std::int32_t(add_node( sceneGraph, -1 ));
+
+	std::vector<SceneObject> objects;
+	objects.emplace_back( SceneObject{ &planeMesh, floorDescriptors, AlphaMode::opaque, floorTexIndex, 0, add_node( sceneGraph, sceneRoot ), glm::vec3( 0.f, 0.f, 0.f ), glm::vec3( 1.f, 0.f, 6.f ) } );
+	objects.emplace_back( SceneObject{ &spriteMesh, spriteDescriptors, AlphaMode::blend, spriteTexIndex, 1, add_node( sceneGraph, sceneRoot ), glm::vec3( 0.f, 0.5f, -4.f ), glm::vec3( 1.5f, 1.f, 0.f ) } );
+	objects.emplace_back( SceneObject{ &spriteMesh, spriteDescriptors, AlphaMode::test, spriteTexIndex, 1, add_node( sceneGraph, sceneRoot, glm::translate( glm::mat4( 1.f ), glm::vec3( 0.f, 0.f, -1.5f ) ) ), glm::vec3( 0.f, 0.5f, -4.f ), glm::vec3( 1.5f, 1.f, 0.f ) } );
+
+	ObjectTable objectTable;
+	std::vector<std::int32_t> nodeObjects( sceneGraph.parent.size(), -1 );
+	for( auto const& object : objects )
+		nodeObjects[object.node] = std::int32_t(add_object( objectTable, object.boundsCenter, object.boundsExtent ));
+
+	TransformRing transforms = create_transform_ring( allocator, cfg::kFramesInFlight, cfg::kMaxSceneNodes );
+
+	std::vector<std::uint32_t> visibleObjects;
+	visibleObjects.reserve( objectTable.count );
+
+	RenderQueue renderQueue;
+
+	// Objects that were replaced while frames using them were in flight.
+	// Objects are retired with the number of frames submitted at that point
+	// and destroyed once all of these frames have completed.
+	lut::DeletionQueue deletions;
+
+	// Frame graph: the scene uniforms are uploaded, then the scene is drawn.
+	// Barriers, including the layout transitions of the attachments, follow
+	// from the declared uses. The color target's previous use is the wait
+	// on the image-available semaphore (or, headless, the readback of the
+	// frame that used the image before); offscreen images are left ready
+	// to be read back, swap chain images ready to be presented. The depth
+	// buffer's contents are discarded each frame, but the previous frame's
+	// writes must complete first.
+	FrameInputs frameInputs{};
+
+	lut::RenderGraph frameGraph( context, allocator );
+
+	auto const uboRes = frameGraph.import_buffer( "scene-ubo", lut::kUseUniformRead );
+	// The previous contents are cleared, so the layout is UNDEFINED. The
+	// readback only needs an execution dependency (write-after-read).
+	auto const colorRes = frameGraph.import_image( "color", VK_IMAGE_ASPECT_COLOR_BIT,
+		options.headless
+			? lut::ResourceUse{ lut::kUseTransferRead.stages, 0, VK_IMAGE_LAYOUT_UNDEFINED }
+			: lut::ResourceUse{ VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0, VK_IMAGE_LAYOUT_UNDEFINED },
+		options.headless ? lut::kUseTransferRead : lut::kUsePresent
+	);
+	auto const depthRes = frameGraph.import_image( "depth", VK_IMAGE_ASPECT_DEPTH_BIT,
+		lut::ResourceUse{ lut::kUseDepthAttachment.stages, lut::kUseDepthAttachment.access, VK_IMAGE_LAYOUT_UNDEFINED }
+	);
+
+	frameGraph.add_pass( "upload-scene", [&] ( VkCommandBuffer aCmdBuff ) {
+		record_scene_upload( aCmdBuff, sceneUBO.buffer, frameInputs.sceneUniforms );
+	} ).write( uboRes, lut::kUseTransferWrite );
+
+	frameGraph.add_pass( "scene", [&] ( VkCommandBuffer aCmdBuff ) {
+		record_scene_pass( aCmdBuff, frameInputs.target, pipes, renderExtent, pipeLayout.handle, sceneDescriptors, bindlessTextures.set, transforms.buffer.buffer, frameInputs.instanceOffset, objects, renderQueue );
+	} )
+		.read( uboRes, lut::ResourceUse{ VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, VK_ACCESS_UNIFORM_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED } )
+		.write( colorRes, lut::kUseColorAttachment )
+		.write( depthRes, lut::kUseDepthAttachment )
+	;
+
+	frameGraph.compile();
+	frameGraph.set_buffer( uboRes, sceneUBO.buffer );
+
+	{
+		auto const& graphStats = frameGraph.stats();
+		std::fprintf( stderr, "Frame graph: %u passes (%u culled), %u image and %u buffer barriers in %u batches\n", graphStats.passes, graphStats.culledPasses, graphStats.imageBarriers, graphStats.bufferBarriers, graphStats.barrierBatches );
+	}
+
 	// Application main loop
 	bool recreateSwapchain = false;
 
-	while( !glfwWindowShouldClose( window.window ) )
+	std::uint32_t frameNumber = 0;
+	auto const startTime = std::chrono::steady_clock::now();
+
+	LatencyStats latencyStats;
+	FrameTimestamps frameTimes{};
+
+	// Labels the latency reports with the current presentation policy
+	auto const report_latency_ = [&] {
+		char label[128];
+		std::snprintf( label, sizeof(label), "%s, %zu images", lut::to_string(window.presentMode).c_str(), window.swapImages.size() );
+		report_latency( latencyStats, label );
+	};
+
+	// Background defragmentation moves the textures and vertex buffers to
+	// compact device memory. The frames that follow a move must use the new
+	// image view and descriptors; the old ones are retired.
+	std::optional<lut::Defragmenter> defragmenter;
+	if( options.defragment )
 	{
-		// Let GLFW process events.
-		// glfwPollEvents() checks for events, processes them. If there are no
-		// events, it will return immediately. Alternatively, glfwWaitEvents()
-		// will wait for any event to occur, process it, and only return at
-		// that point. The former is useful for applications where you want to
-		// render as fast as possible, whereas the latter is useful for
-		// input-driven applications, where redrawing is only needed in
-		// reaction to user input (or similar).
-		glfwPollEvents(); // or: glfwWaitEvents()
+		lut::DefragmentationConfig defragConfig;
+		defragConfig.maxBytesPerRound = cfg::kDefragBytesPerRound;
+		defragConfig.idleSteps = cfg::kDefragIdleFrames;
+
+		defragmenter.emplace( context, allocator, defragConfig );
+
+		auto const texture_moved_ = [&] ( lut::Image const& aTexture, VkImageCreateInfo const& aInfo, lut::ImageView& aView, std::uint32_t aMaterial ) {
+			deletions.retire( std::move(aView), frameNumber );
+			aView = lut::create_image_view_texture2d( context, aTexture.image, VK_FORMAT_R8G8B8A8_SRGB, lut::texture2d_view_usage( aInfo ) );
+
+			// All objects with the material share the texture's slot or set
+			auto const first = std::find_if( objects.begin(), objects.end(), [aMaterial] ( SceneObject const& aObject ) { return aMaterial == aObject.material; } );
+			assert( objects.end() != first );
+
+			auto const for_material_ = [&] ( auto&& aFunc ) {
+				for( auto& object : objects )
+				{
+					if( aMaterial == object.material )
+						aFunc( object );
+				}
+			};
 
-		glsl::SceneUniform sceneUniforms{}; 
-		update_scene_uniforms(sceneUniforms, window.swapchainExtent.width, window.swapchainExtent.height);
+			// Slots and sets may be used by pending frames, so new ones are
+			// written rather than updating the current ones.
+			if( bindless )
+			{
+				auto const oldIndex = first->textureIndex;
+				auto const newIndex = add_bindless_texture( bindlessTextures, descriptorWriter, aView.handle, defaultSampler );
+				descriptorWriter.update( context );
+
+				for_material_( [newIndex] ( SceneObject& aObject ) { aObject.textureIndex = newIndex; } );
+
+				deletions.defer( [&bindlessTextures, oldIndex] { release_bindless_texture( bindlessTextures, oldIndex ); }, frameNumber );
+			}
+			else
+			{
+				auto const oldSet = first->objectDescriptors;
+				auto const newSet = descriptors.allocate( objectLayout.handle );
+
+				ObjectDescriptors const data{ { defaultSampler, aView.handle, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL } };
+				vkUpdateDescriptorSetWithTemplate( context.device, newSet, objectTemplate.handle, &data );
+
+				for_material_( [newSet] ( SceneObject& aObject ) { aObject.objectDescriptors = newSet; } );
+
+				deletions.defer( [&descriptors, &objectLayout, oldSet] { descriptors.recycle( objectLayout.handle, oldSet ); }, frameNumber );
+			}
+		};
+
+		defragmenter->add_image( floorTex, floorTexInfo, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, [&] { texture_moved_( floorTex, floorTexInfo, floorView, objects[0].material ); } );
+		defragmenter->add_image( spriteTex, spriteTexInfo, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, [&] { texture_moved_( spriteTex, spriteTexInfo, spriteView, objects[1].material ); } );
+
+		// Vertex buffers are looked up through the meshes when drawing
+		for( auto* mesh : { &planeMesh, &spriteMesh } )
+		{
+			defragmenter->add_buffer( mesh->positions, mesh->vertexCount * 3 * sizeof(float), kTexturedMeshUsage );
+			defragmenter->add_buffer( mesh->texcoords, mesh->vertexCount * 2 * sizeof(float), kTexturedMeshUsage );
+		}
+	}
+
+	while( 0 == options.frameCount || frameNumber < options.frameCount )
+	{
+		if( !options.headless )
+		{
+			if( glfwWindowShouldClose( window.window ) )
+				break;
+
+			// Let GLFW process events.
+			// glfwPollEvents() checks for events, processes them. If there are no
+			// events, it will return immediately. Alternatively, glfwWaitEvents()
+			// will wait for any event to occur, process it, and only return at
+			// that point. The former is useful for applications where you want to
+			// render as fast as possible, whereas the latter is useful for
+			// input-driven applications, where redrawing is only needed in
+			// reaction to user input (or similar).
+			glfwPollEvents(); // or: glfwWaitEvents()
+
+			frameTimes.inputPoll = LatencyClock::now();
+		}
+
+		// Swap in pipelines rebuilt after a shader change. This happens
+		// between frames, so each frame uses a consistent set of pipelines.
+		if( shaderReloader )
+		{
+			shaderReloader->poll( pipelines, workers );
+
+			if( auto replaced = shaderReloader->apply( pipelines ); !replaced.empty() )
+			{
+				deletions.retire( std::move(replaced), frameNumber );
+				find_pipelines_();
+			}
+		}
 
 		// Recreate swap chain?
 		if( recreateSwapchain )
 		{
-			// We need to destroy several objects, which may still be in use by 
-			// the GPU. Therefore, first wait for the GPU to finish processing. 
-			vkDeviceWaitIdle(window.device);
+			// Several objects need to be replaced, but may still be in use by
+			// the frames in flight. Rather than waiting for the GPU to finish
+			// processing, retire them; rendering continues meanwhile.
+			std::uint64_t const retireSerial = frameNumber;
+
+			// The framebuffers reference the old swap chain images
+			deletions.retire( std::move(framebuffers), retireSerial );
+			framebuffers.clear();
+
+			lut::RetiredSwapchain oldSwapchain;
+			auto const changes = recreate_swapchain(window, oldSwapchain);
+			deletions.retire( std::move(oldSwapchain), retireSerial );
 
-			// Recreate them 
-			auto const changes = recreate_swapchain(window);
+			colorFormat = window.swapchainFormat;
+			renderExtent = window.swapchainExtent;
 
-			if (changes.changedFormat)
-				renderPass = create_render_pass(window);
+			if (changes.changedFormat && !dynamicRendering)
+			{
+				deletions.retire( std::move(renderPass), retireSerial );
+				renderPass = create_render_pass(window, colorFormat);
+			}
 
 			if (changes.changedSize) 
-				std::tie(depthBuffer, depthBufferView) = create_depth_buffer(window, allocator);
+			{
+				deletions.retire( std::move(depthBufferView), retireSerial );
+				deletions.retire( std::move(depthBuffer), retireSerial );
+				std::tie(depthBuffer, depthBufferView) = create_depth_buffer(window, allocator, renderExtent);
+			}
 
-			framebuffers.clear();
-			create_swapchain_framebuffers(window, renderPass.handle, framebuffers, depthBufferView.handle);
+			if( !dynamicRendering )
+				create_framebuffers(window, renderPass.handle, colorViews, renderExtent, framebuffers, depthBufferView.handle);
 
-			if (changes.changedSize) {
-				pipe = create_pipeline(window, renderPass.handle, pipeLayout.handle);
-				alphaPipe = create_alpha_pipeline(window, renderPass.handle, pipeLayout.handle);
+			// Pipelines depend on the render pass, or with dynamic rendering
+			// on the color format. Viewport and scissor are dynamic state, so
+			// a change in size does not affect them.
+			if (changes.changedFormat) 
+			{
+				deletions.retire( pipelines.release_all(), retireSerial );
+				create_pipelines_();
 			}
 
+			// The new swap chain may have more images
+			while( renderFinished.size() < colorViews.size() )
+				renderFinished.emplace_back( lut::create_semaphore( context ) );
+
 			recreateSwapchain = false;
-			continue;
-			//TODO: (Section 6) re-create depth buffer image
-			//recreateSwapchain = false;
 		}
 
-		// Acquire next swap chain image 1
+		glsl::SceneUniform sceneUniforms{}; 
+		update_scene_uniforms(sceneUniforms, renderExtent.width, renderExtent.height);
+
+		// Make sure that the frame slot is no longer in use. Frames are
+		// waited for in order, so all frames up to and including the one that
+		// last used this slot have now completed.
+		auto const frameSlot = frameNumber % cfg::kFramesInFlight;
+
+		if (auto const res = vkWaitForFences(context.device, 1, &cbfences[frameSlot].handle, VK_TRUE, std::numeric_limits<std::uint64_t>::max()); VK_SUCCESS != res)
+		{
+			throw lut::Error("Unable to wait for command buffer fence %u\n" "vkWaitForFences() returned %s", frameSlot, lut::to_string(res).c_str());
+		}
+
+		if( frameNumber >= cfg::kFramesInFlight )
+			deletions.collect( frameNumber - cfg::kFramesInFlight + 1 );
+
+		// The copies of a defragmentation round are submitted ahead of this
+		// frame, which then uses the moved resources.
+		if( defragmenter )
+			defragmenter->step();
+
+		// Lets VMA refresh the budget from the driver
+		vmaSetCurrentFrameIndex( allocator.allocator, frameNumber );
+
+		if( gMemoryStatsRequested )
+		{
+			gMemoryStatsRequested = 0;
+
+			lut::write_memory_stats_json( allocator, cfg::kMemoryStatsPath );
+			std::fprintf( stderr, "Wrote GPU memory statistics to '%s'\n", cfg::kMemoryStatsPath );
+		}
+
+		if( 0 == frameNumber % cfg::kMemoryReportFrames )
+		{
+			auto const memStats = lut::get_memory_stats( allocator );
+
+			if( options.memoryStats )
+			{
+				std::fprintf( stderr, "GPU memory after %u frames:\n", frameNumber );
+				lut::print_memory_stats( stderr, memStats );
+
+				if( defragmenter )
+				{
+					auto const& defragStats = defragmenter->stats();
+					std::fprintf( stderr, "Defragmentation: %llu rounds, moved %llu allocations (%.1f MiB)\n", (unsigned long long)defragStats.rounds, (unsigned long long)defragStats.movedAllocations, defragStats.movedBytes / (1024.0*1024.0) );
+				}
+			}
+
+			if( auto const fraction = lut::max_budget_fraction( memStats ); fraction > cfg::kMemoryBudgetWarning )
+				std::fprintf( stderr, "Warning: GPU memory usage is at %.0f%% of the budget\n", fraction * 100.f );
+		}
+
+		// Acquire next swap chain image. Offscreen images are simply used in
+		// turn.
 		std::uint32_t imageIndex = 0;
-		auto const acquireRes = vkAcquireNextImageKHR(window.device, window.swapchain, std::numeric_limits<std::uint64_t>::max(), imageAvailable.handle, VK_NULL_HANDLE, &imageIndex);
+		VkResult acquireRes = VK_SUCCESS;
 
-		if (VK_SUBOPTIMAL_KHR == acquireRes || VK_ERROR_OUT_OF_DATE_KHR == acquireRes)
+		if( options.headless )
+			imageIndex = frameSlot;
+		else
+			acquireRes = vkAcquireNextImageKHR(window.device, window.swapchain, std::numeric_limits<std::uint64_t>::max(), imageAvailable[frameSlot].handle, VK_NULL_HANDLE, &imageIndex);
+
+		if (VK_ERROR_OUT_OF_DATE_KHR == acquireRes)
 		{
 			// This occurs e.g., when the window has been resized. In this case 
 			// we need to recreate the swap chain to match the new dimensions. 
 			// Any resources that directly depend on the swap chain need to be 
 			// recreated as well. While rare, re-creating the swap chain may 
 			// give us a different image format, which we should handle. 
-			// 
-			// In both cases, we set the flag that the swap chain has to be 
-			// re-created and jump to the top of the loop. Technically, with 
-			// the VK SUBOPTIMAL KHR return code, we could continue rendering 
-			// with the current swap chain (unlike VK ERROR OUT OF DATE KHR, 
-			// which does require us to recreate the swap chain). 
+			//
+			// No image was acquired, so the semaphore was not signalled and
+			// the frame can simply be started over.
 			recreateSwapchain = true;
 			continue;
 		}
 
-		if (VK_SUCCESS != acquireRes)
+		if (VK_SUBOPTIMAL_KHR == acquireRes)
+		{
+			// The image can still be used. Render and present this frame, and
+			// recreate the swap chain afterwards.
+			recreateSwapchain = true;
+		}
+		else if (VK_SUCCESS != acquireRes)
 		{
 			throw lut::Error("Unable to acquire enxt swapchain image\n" "vkAcquireNextImageKHR() returned %s", lut::to_string(acquireRes).c_str());
 		}
 
-		// Make sure that the command buffer is no longer in use 
-		assert(std::size_t(imageIndex) < cbfences.size());
-
-		if (auto const res = vkWaitForFences(window.device, 1, &cbfences[imageIndex].handle, VK_TRUE, std::numeric_limits<std::uint64_t>::max()); VK_SUCCESS != res)
+		// The frame will be submitted; only now is it safe to reset the fence
+		if (auto const res = vkResetFences(context.device, 1, &cbfences[frameSlot].handle); VK_SUCCESS != res)
 		{
-			throw lut::Error("Unable to wait for command buffer fence %u\n" "vkWaitForFences() returned %s", imageIndex, lut::to_string(res).c_str());
+			throw lut::Error("Unable to reset command buffer fence %u\n" "vkResetFences() returned %s", frameSlot, lut::to_string(res).c_str());
 		}
 
-		if (auto const res = vkResetFences(window.device, 1, &cbfences[imageIndex].handle); VK_SUCCESS != res)
-		{
-			throw lut::Error("Unable to reset command buffer fence %u\n" "vkResetFences() returned %s", imageIndex, lut::to_string(res).c_str());
+		// Update the transforms of nodes that moved and cull. The ring slot
+		// for this frame is no longer in use (fence above).
+		update_transforms( sceneGraph, transforms, frameSlot, &workers );
+		update_object_bounds( objectTable, sceneGraph, objects, nodeObjects );
 
+		cull_objects( objectTable, extract_frustum_planes( sceneUniforms.projCam ), visibleObjects, &workers );
 
-		}
+		build_render_queue( renderQueue, objectTable, objects, visibleObjects, sceneUniforms.camera );
 
 		// Record and submit commands for this frame
-		assert(std::size_t(imageIndex) < cbuffers.size());
-		assert(std::size_t(imageIndex) < framebuffers.size());
+		assert(std::size_t(imageIndex) < colorViews.size());
+
+		auto const target = dynamicRendering
+			? SceneTarget{ VK_NULL_HANDLE, VK_NULL_HANDLE, colorViews[imageIndex], depthBufferView.handle }
+			: SceneTarget{ renderPass.handle, framebuffers[imageIndex].handle, VK_NULL_HANDLE, VK_NULL_HANDLE }
+		;
+
+		frameInputs = FrameInputs{ sceneUniforms, target, transform_ring_offset(transforms, frameSlot) };
+
+		frameGraph.set_image( colorRes, options.headless ? offscreen.images[imageIndex].image : window.swapImages[imageIndex] );
+		frameGraph.set_image( depthRes, depthBuffer.image );
+
+		record_commands(cbuffers[frameSlot], frameGraph);
+
+		// Nothing to wait for or signal without a swap chain
+		if( options.headless )
+		{
+			submit_commands(context, cbuffers[frameSlot], cbfences[frameSlot].handle, VK_NULL_HANDLE, VK_NULL_HANDLE);
+
+			++frameNumber;
+			continue;
+		}
 
-		record_commands(cbuffers[imageIndex], renderPass.handle, framebuffers[imageIndex].handle, pipe.handle, window.swapchainExtent, planeMesh.positions.buffer, planeMesh.texcoords.buffer, planeMesh.vertexCount, sceneUBO.buffer, sceneUniforms, pipeLayout.handle, sceneDescriptors, floorDescriptors, spriteMesh.positions.buffer, spriteMesh.texcoords.buffer, spriteMesh.vertexCount, spriteDescriptors, alphaPipe.handle);
+		assert(std::size_t(imageIndex) < renderFinished.size());
+		submit_commands(context, cbuffers[frameSlot], cbfences[frameSlot].handle, imageAvailable[frameSlot].handle, renderFinished[imageIndex].handle);
+		++frameNumber;
 
-		submit_commands(window, cbuffers[imageIndex], cbfences[imageIndex].handle, imageAvailable.handle, renderFinished.handle);
+		frameTimes.submit = LatencyClock::now();
 
 		// Present the results
 		VkPresentInfoKHR presentInfo{};
 		presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
 		presentInfo.waitSemaphoreCount = 1;
-		presentInfo.pWaitSemaphores = &renderFinished.handle;
+		presentInfo.pWaitSemaphores = &renderFinished[imageIndex].handle;
 		presentInfo.swapchainCount = 1;
 		presentInfo.pSwapchains = &window.swapchain;
 		presentInfo.pImageIndices = &imageIndex;
@@ -396,6 +1047,15 @@ int main() try
 
 		auto const presentRes = vkQueuePresentKHR(window.presentQueue, &presentInfo);
 
+		if( options.latency )
+		{
+			frameTimes.presentReturn = LatencyClock::now();
+			record_frame( latencyStats, frameTimes );
+
+			if( 0 == frameNumber % cfg::kLatencyReportFrames )
+				report_latency_();
+		}
+
 		if (VK_SUBOPTIMAL_KHR == presentRes || VK_ERROR_OUT_OF_DATE_KHR == presentRes)
 		{
 			recreateSwapchain = true;
@@ -408,7 +1068,47 @@ int main() try
 
 	// Cleanup takes place automatically in the destructors, but we sill need
 	// to ensure that all Vulkan commands have finished before that.
-	vkDeviceWaitIdle( window.device );
+	vkDeviceWaitIdle( context.device );
+	deletions.flush();
+
+	if( options.latency )
+		report_latency_();
+
+	if( frameNumber > 0 )
+	{
+		auto const counters = lut::barrier_counters();
+		auto const barriers = counters.memoryBarriers + counters.bufferBarriers + counters.imageBarriers;
+		std::fprintf( stderr, "Barriers: %llu in %llu pipeline barrier calls in total (%.1f barriers/frame over %u frames)\n", (unsigned long long)barriers, (unsigned long long)counters.calls, double(barriers) / frameNumber, frameNumber );
+	}
+
+	if( options.headless && frameNumber > 0 )
+	{
+		// Includes the time that the GPU took to finish the last frames
+		auto const totalMs = std::chrono::duration<double,std::milli>( std::chrono::steady_clock::now() - startTime ).count();
+		std::printf( "Rendered %u frames at %ux%u in %.1f ms (%.3f ms/frame, %.1f frames/s)\n", frameNumber, renderExtent.width, renderExtent.height, totalMs, totalMs / frameNumber, frameNumber * 1000.0 / totalMs );
+
+		if( options.outputPath )
+		{
+			auto const lastImage = (frameNumber-1) % cfg::kFramesInFlight;
+			save_image_png( context, allocator, offscreen.images[lastImage].image, renderExtent, options.outputPath );
+			std::printf( "Wrote last frame to '%s'\n", options.outputPath );
+		}
+	}
+
+	// Keep the time of the original uncached run, such that the savings are
+	// always reported against it. A cache that cannot be saved only costs
+	// the next run its compile time.
+	if( VK_NULL_HANDLE != pipeCache.handle )
+	{
+		try
+		{
+			lut::save_pipeline_cache( context, pipeCache.handle, cfg::kPipelineCachePath, pipeCacheSeed.seeded ? pipeCacheSeed.coldCreateMs : pipeMs );
+		}
+		catch( std::exception const& eErr )
+		{
+			std::fprintf( stderr, "Warning: unable to save the pipeline cache:\n%s\n", eErr.what() );
+		}
+	}
 
 	return 0;
 }
@@ -421,12 +1121,120 @@ catch( std::exception const& eErr )
 
 namespace
 {
+	Options parse_options( int aArgc, char* aArgv[] )
+	{
+		Options ret;
+
+		// Returns the argument following the option at aArgv[i]
+		auto const value = [&] ( int& i ) -> char const* {
+			if( i+1 >= aArgc )
+				throw lut::Error( "Option '%s' requires a value", aArgv[i] );
+			return aArgv[++i];
+		};
+
+		// Ditto, but the value is optional and must be a number
+		auto const optional_count = [&] ( int& i, std::uint32_t aDefault ) {
+			if( i+1 < aArgc && aArgv[i+1][0] >= '0' && aArgv[i+1][0] <= '9' )
+				return std::uint32_t(std::strtoul( aArgv[++i], nullptr, 10 ));
+			return aDefault;
+		};
+
+		for( int i = 1; i < aArgc; ++i )
+		{
+			if( 0 == std::strcmp( aArgv[i], "--bench-cull" ) )
+				ret.benchCull = optional_count( i, 100000 );
+			else if( 0 == std::strcmp( aArgv[i], "--bench-queue" ) )
+				ret.benchQueue = optional_count( i, 100000 );
+			else if( 0 == std::strcmp( aArgv[i], "--headless" ) )
+				ret.headless = true;
+			else if( 0 == std::strcmp( aArgv[i], "--frames" ) )
+				ret.frameCount = std::uint32_t(std::strtoul( value( i ), nullptr, 10 ));
+			else if( 0 == std::strcmp( aArgv[i], "--output" ) )
+				ret.outputPath = value( i );
+			else if( 0 == std::strcmp( aArgv[i], "--present-mode" ) )
+			{
+				auto const mode = value( i );
+				if( 0 == std::strcmp( mode, "fifo" ) )
+					ret.presentMode = VK_PRESENT_MODE_FIFO_KHR;
+				else if( 0 == std::strcmp( mode, "fifo-relaxed" ) )
+					ret.presentMode = VK_PRESENT_MODE_FIFO_RELAXED_KHR;
+				else if( 0 == std::strcmp( mode, "mailbox" ) )
+					ret.presentMode = VK_PRESENT_MODE_MAILBOX_KHR;
+				else if( 0 == std::strcmp( mode, "immediate" ) )
+					ret.presentMode = VK_PRESENT_MODE_IMMEDIATE_KHR;
+				else
+					throw lut::Error( "Unknown present mode '%s', expected fifo, fifo-relaxed, mailbox or immediate", mode );
+			}
+			else if( 0 == std::strcmp( aArgv[i], "--swap-images" ) )
+				ret.swapImageCount = std::uint32_t(std::strtoul( value( i ), nullptr, 10 ));
+			else if( 0 == std::strcmp( aArgv[i], "--latency" ) )
+				ret.latency = true;
+			else if( 0 == std::strcmp( aArgv[i], "--no-pipeline-cache" ) )
+				ret.noPipelineCache = true;
+			else if( 0 == std::strcmp( aArgv[i], "--hot-reload" ) )
+				ret.hotReload = true;
+			else if( 0 == std::strcmp( aArgv[i], "--bindless" ) )
+				ret.bindless = true;
+			else if( 0 == std::strcmp( aArgv[i], "--memory-stats" ) )
+				ret.memoryStats = true;
+			else if( 0 == std::strcmp( aArgv[i], "--defrag" ) )
+				ret.defragment = true;
+			else if( 0 == std::strcmp( aArgv[i], "--compute-mips" ) )
+				ret.computeMips = true;
+			else if( 0 == std::strcmp( aArgv[i], "--dynamic-rendering" ) )
+				ret.dynamicRendering = true;
+			else if( 0 == std::strcmp( aArgv[i], "--size" ) )
+			{
+				auto const size = value( i );
+				if( 2 != std::sscanf( size, "%ux%u", &ret.headlessExtent.width, &ret.headlessExtent.height ) || 0 == ret.headlessExtent.width || 0 == ret.headlessExtent.height )
+					throw lut::Error( "Invalid size '%s', expected WIDTHxHEIGHT", size );
+			}
+			else
+			{
+				throw lut::Error( "Unknown option '%s'\n"
+					"Usage: %s [--bench-cull [N]] [--bench-queue [N]] [--frames N]\n"
+					"         [--present-mode fifo|fifo-relaxed|mailbox|immediate] [--swap-images N] [--latency]\n"
+					"         [--no-pipeline-cache] [--hot-reload] [--bindless] [--memory-stats] [--defrag]\n"
+					"         [--compute-mips] [--dynamic-rendering]\n"
+					"         [--headless [--size WxH] [--output FILE.png]]",
+					aArgv[i], aArgv[0]
+				);
+			}
+		}
+
+		// Swap chain images cannot be read back
+		if( ret.outputPath && !ret.headless )
+			throw lut::Error( "--output requires --headless" );
+
+		// Nothing is presented in headless mode
+		if( ret.latency && ret.headless )
+			throw lut::Error( "--latency cannot be used with --headless" );
+
+		// Embedded shaders take precedence over the files that would be
+		// recompiled, so reloading would have no effect.
+		if( ret.hotReload && lut::embedded_spirv_count() > 0 )
+			throw lut::Error( "--hot-reload requires a build without --embed-shaders" );
+
+		if( ret.headless && 0 == ret.frameCount )
+			ret.frameCount = cfg::kHeadlessDefaultFrames;
+
+		return ret;
+	}
+
 	void glfw_callback_key_press( GLFWwindow* aWindow, int aKey, int /*aScanCode*/, int aAction, int /*aModifierFlags*/ )
 	{
 		if( GLFW_KEY_ESCAPE == aKey && GLFW_PRESS == aAction )
 		{
 			glfwSetWindowShouldClose( aWindow, GLFW_TRUE );
 		}
+
+		if( GLFW_KEY_M == aKey && GLFW_PRESS == aAction )
+			gMemoryStatsRequested = 1;
+	}
+
+	void signal_request_memory_stats( int )
+	{
+		gMemoryStatsRequested = 1;
 	}
 }
 
@@ -449,25 +1257,82 @@ namespace
 			
 		aSceneUniforms.projCam = aSceneUniforms.projection * aSceneUniforms.camera;
 	}
+
+	void build_render_queue( RenderQueue& aQueue, ObjectTable const& aTable, std::vector<SceneObject> const& aObjects, std::vector<std::uint32_t> const& aVisibleObjects, glm::mat4 const& aCamera )
+	{
+		aQueue.items.clear();
+
+		// Distance along the view direction; the camera looks down -Z
+		glm::vec4 const viewZ = -glm::vec4( aCamera[0][2], aCamera[1][2], aCamera[2][2], aCamera[3][2] );
+
+		for( auto const index : aVisibleObjects )
+		{
+			auto const& object = aObjects[index];
+
+			auto const depth = glm::dot( viewZ, glm::vec4( aTable.centerX[index], aTable.centerY[index], aTable.centerZ[index], 1.f ) );
+
+			// Blended objects are drawn after all others. Alpha-tested
+			// objects write depth and are drawn with the opaque ones.
+			auto const layer = AlphaMode::blend == object.alphaMode ? DrawLayer::alpha : DrawLayer::opaque;
+			auto const key = make_draw_key( layer, std::uint32_t(object.alphaMode), object.material, depth );
+
+			push_draw( aQueue, key, index );
+		}
+
+		sort_queue( aQueue );
+	}
+
+	void update_object_bounds( ObjectTable& aTable, SceneGraph const& aGraph, std::vector<SceneObject> const& aObjects, std::vector<std::int32_t> const& aNodeObjects )
+	{
+		// Only nodes that were recomputed in this frame can have moved
+		for( auto const& range : aGraph.updated )
+		{
+			for( auto node = range.begin; node < range.end; ++node )
+			{
+				auto const index = aNodeObjects[node];
+				if( index < 0 )
+					continue;
+
+				auto const& object = aObjects[index];
+				auto const& world = aGraph.world[node];
+
+				// World-space box enclosing the transformed object-space box
+				// (J. Arvo, "Transforming Axis-Aligned Bounding Boxes", 1990)
+				glm::vec3 const center = glm::vec3( world * glm::vec4( object.boundsCenter, 1.f ) );
+				glm::vec3 extent( 0.f );
+				for( int i = 0; i < 3; ++i )
+				{
+					for( int j = 0; j < 3; ++j )
+						extent[i] += std::abs( world[j][i] ) * object.boundsExtent[j];
+				}
+
+				set_object_bounds( aTable, std::uint32_t(index), center, extent );
+			}
+		}
+	}
 }
 
 namespace
 {
-	lut::RenderPass create_render_pass( lut::VulkanWindow const& aWindow )
+	lut::RenderPass create_render_pass( lut::VulkanContext const& aContext, VkFormat aColorFormat )
 	{
+		// Layout transitions happen outside of the render pass (see the frame
+		// graph in main()), so that they are synchronized by the barriers
+		// that the graph places. The render pass itself changes no layouts
+		// and needs no external subpass dependencies.
 		VkAttachmentDescription attachments[2]{};
-		attachments[0].format = aWindow.swapchainFormat; //changed! 
+		attachments[0].format = aColorFormat; //changed! 
 		attachments[0].samples = VK_SAMPLE_COUNT_1_BIT;
 		attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
 		attachments[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-		attachments[0].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-		attachments[0].finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR; //changed! 7
+		attachments[0].initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		attachments[0].finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
 		attachments[1].format = cfg::kDepthFormat; 
 		attachments[1].samples = VK_SAMPLE_COUNT_1_BIT; 
 		attachments[1].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR; 
 		attachments[1].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE; 
-		attachments[1].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED; 
+		attachments[1].initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL; 
 		attachments[1].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
 
 		VkAttachmentReference subpassAttachments[1]{};
@@ -497,13 +1362,13 @@ namespace
 		passInfo.pDependencies = nullptr; //changed! 
 
 		VkRenderPass rpass = VK_NULL_HANDLE;
-		if (auto const res = vkCreateRenderPass(aWindow.device, &passInfo, nullptr, &rpass); VK_SUCCESS != res)
+		if (auto const res = vkCreateRenderPass(aContext.device, &passInfo, nullptr, &rpass); VK_SUCCESS != res)
 		{
 			throw lut::Error("Unable to create render pass\n" "vkCreateRenderPass() returned %s", lut::to_string(res).c_str());
 
 		}
 
-		return lut::RenderPass(aWindow.device, rpass);
+		return lut::RenderPass(aContext.device, rpass);
 	}
 
 	lut::PipelineLayout create_pipeline_layout( lut::VulkanContext const& aContext, VkDescriptorSetLayout aSceneLayout, VkDescriptorSetLayout aObjectLayout)
@@ -533,299 +1398,39 @@ namespace
 	}
 
 
-	lut::Pipeline create_pipeline( lut::VulkanWindow const& aWindow, VkRenderPass aRenderPass, VkPipelineLayout aPipelineLayout )
+	PipelineDesc make_pipeline_desc( VkRenderPass aRenderPass, VkFormat aColorFormat, VkFormat aDepthFormat, VkPipelineLayout aPipelineLayout, AlphaMode aAlphaMode, bool aBindless )
 	{
-		
-		lut::ShaderModule vert = lut::load_shader_module(aWindow, cfg::kVertShaderPath);
-		lut::ShaderModule frag = lut::load_shader_module(aWindow, cfg::kFragShaderPath);
-
-		VkPipelineDepthStencilStateCreateInfo depthInfo{}; 
-		depthInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO; 
-		depthInfo.depthTestEnable = VK_TRUE; 
-		depthInfo.depthWriteEnable = VK_TRUE; 
-		depthInfo.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL; 
-		depthInfo.minDepthBounds = 0.f; 
-		depthInfo.maxDepthBounds = 1.f;
-		
-		VkPipelineShaderStageCreateInfo stages[2]{};
-		stages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-		stages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
-		stages[0].module = vert.handle;
-		stages[0].pName = "main";
-
-		stages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-		stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-		stages[1].module = frag.handle;
-		stages[1].pName = "main";
-		
-		VkVertexInputBindingDescription vertexInputs[2]{}; 
-		vertexInputs[0].binding = 0; 
-		vertexInputs[0].stride = sizeof(float) * 3; 
-		vertexInputs[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX; 
-			
-		vertexInputs[1].binding = 1; 
-		vertexInputs[1].stride = sizeof(float) * 2; 
-		vertexInputs[1].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-
-		VkVertexInputAttributeDescription vertexAttributes[2]{}; 
-		vertexAttributes[0].binding = 0; // must match binding above 
-		vertexAttributes[0].location = 0; // must match shader 
-		vertexAttributes[0].format = VK_FORMAT_R32G32B32_SFLOAT;
-		vertexAttributes[0].offset = 0; 
-			
-		vertexAttributes[1].binding = 1; // must match binding above 
-		vertexAttributes[1].location = 1; // must match shader 
-		vertexAttributes[1].format = VK_FORMAT_R32G32_SFLOAT; 
-		vertexAttributes[1].offset = 0;
-
-		VkPipelineVertexInputStateCreateInfo inputInfo{};
-		inputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-
-		inputInfo.vertexBindingDescriptionCount = 2; // number of vertexInputs above 
-		inputInfo.pVertexBindingDescriptions = vertexInputs; 
-		inputInfo.vertexAttributeDescriptionCount = 2; // number of vertexAttributes above 
-		inputInfo.pVertexAttributeDescriptions = vertexAttributes;
-
-		// Define which primitive (point, line, triangle, ...) the input is 
-		// assembled into for rasterization. 
-		VkPipelineInputAssemblyStateCreateInfo assemblyInfo{};
-		assemblyInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-		assemblyInfo.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-		assemblyInfo.primitiveRestartEnable = VK_FALSE;
-
-		// Define viewport and scissor regions 
-		VkViewport viewport{};
-		viewport.x = 0.f;
-		viewport.y = 0.f;
-		viewport.width = float(aWindow.swapchainExtent.width);
-		viewport.height = float(aWindow.swapchainExtent.height);
-		viewport.minDepth = 0.f;
-		viewport.maxDepth = 1.f;
+		PipelineDesc desc;
+		desc.renderPass = aRenderPass;
+		desc.layout = aPipelineLayout;
 
-		VkRect2D scissor{};
-		scissor.offset = VkOffset2D{ 0, 0 };
-		scissor.extent = VkExtent2D{ aWindow.swapchainExtent.width, aWindow.swapchainExtent.height };
-
-		VkPipelineViewportStateCreateInfo viewportInfo{};
-		viewportInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-		viewportInfo.viewportCount = 1;
-		viewportInfo.pViewports = &viewport;
-		viewportInfo.scissorCount = 1;
-		viewportInfo.pScissors = &scissor;
-
-		// Define rasterization options 
-		VkPipelineRasterizationStateCreateInfo rasterInfo{};
-		rasterInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-		rasterInfo.depthClampEnable = VK_FALSE;
-		rasterInfo.rasterizerDiscardEnable = VK_FALSE;
-		rasterInfo.polygonMode = VK_POLYGON_MODE_FILL;
-		rasterInfo.cullMode = VK_CULL_MODE_BACK_BIT;
-		rasterInfo.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
-		rasterInfo.depthBiasEnable = VK_FALSE;
-		rasterInfo.lineWidth = 1.f; // required
-
-		// Define multisampling state 
-		VkPipelineMultisampleStateCreateInfo samplingInfo{};
-		samplingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-		samplingInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
-
-		// Define blend state 
-		// We define one blend state per color attachment - this example uses a 
-		// single color attachment, so we only need one. Right now, we donft do any 
-		// blending, so we can ignore most of the members. 
-		VkPipelineColorBlendAttachmentState blendStates[1]{};
-		blendStates[0].blendEnable = VK_FALSE;
-		blendStates[0].colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-
-		VkPipelineColorBlendStateCreateInfo blendInfo{};
-		blendInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-		blendInfo.logicOpEnable = VK_FALSE;
-		blendInfo.attachmentCount = 1;
-		blendInfo.pAttachments = blendStates;
-
-		// Create pipeline 
-		VkGraphicsPipelineCreateInfo pipeInfo{};
-		pipeInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-
-		pipeInfo.stageCount = 2; // vertex + fragment stages 
-		pipeInfo.pStages = stages;
-
-		pipeInfo.pVertexInputState = &inputInfo;
-		pipeInfo.pInputAssemblyState = &assemblyInfo;
-		pipeInfo.pTessellationState = nullptr; // no tessellation 
-		pipeInfo.pViewportState = &viewportInfo;
-		pipeInfo.pRasterizationState = &rasterInfo;
-		pipeInfo.pMultisampleState = &samplingInfo;
-		pipeInfo.pDepthStencilState = &depthInfo; // no depth or stencil buffers 
-		pipeInfo.pColorBlendState = &blendInfo;
-		pipeInfo.pDynamicState = nullptr; // no dynamic states
-
-		pipeInfo.layout = aPipelineLayout;
-		pipeInfo.renderPass = aRenderPass;
-		pipeInfo.subpass = 0; // first subpass of aRenderPass 
-
-		VkPipeline pipe = VK_NULL_HANDLE;
-		if (auto const res = vkCreateGraphicsPipelines(aWindow.device, VK_NULL_HANDLE, 1, &pipeInfo, nullptr, &pipe); VK_SUCCESS != res)
+		// The formats are part of the render pass otherwise
+		if( VK_NULL_HANDLE == aRenderPass )
 		{
-			throw lut::Error("Unable to create graphics pipeline\n" "vkCreateGraphicsPipelines() returned %s", lut::to_string(res).c_str());
-
+			desc.colorFormat = aColorFormat;
+			desc.depthFormat = aDepthFormat;
 		}
 
-		return lut::Pipeline(aWindow.device, pipe);
-	}
-
-	lut::Pipeline create_alpha_pipeline(lut::VulkanWindow const& aWindow, VkRenderPass aRenderPass, VkPipelineLayout aPipelineLayout)
-	{
+		// All variants share the shaders; the fragment shader is specialized
+		// for the alpha mode.
+		desc.vertShader = cfg::kVertShaderPath;
+		desc.fragShader = aBindless ? cfg::kBindlessFragShaderPath : cfg::kFragShaderPath;
+		desc.fragConstants = { std::uint32_t(aAlphaMode) };
 
-		lut::ShaderModule vert = lut::load_shader_module(aWindow, cfg::kAlphaVertShaderPath);
-		lut::ShaderModule frag = lut::load_shader_module(aWindow, cfg::kAlphaFragShaderPath);
-
-		VkPipelineDepthStencilStateCreateInfo depthInfo{};
-		depthInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
-		depthInfo.depthTestEnable = VK_TRUE;
-		depthInfo.depthWriteEnable = VK_TRUE;
-		depthInfo.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
-		depthInfo.minDepthBounds = 0.f;
-		depthInfo.maxDepthBounds = 1.f;
-
-		VkPipelineShaderStageCreateInfo stages[2]{};
-		stages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-		stages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
-		stages[0].module = vert.handle;
-		stages[0].pName = "main";
-
-		stages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-		stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-		stages[1].module = frag.handle;
-		stages[1].pName = "main";
-
-		VkVertexInputBindingDescription vertexInputs[2]{};
-		vertexInputs[0].binding = 0;
-		vertexInputs[0].stride = sizeof(float) * 3;
-		vertexInputs[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-
-		vertexInputs[1].binding = 1;
-		vertexInputs[1].stride = sizeof(float) * 2;
-		vertexInputs[1].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-
-		VkVertexInputAttributeDescription vertexAttributes[2]{};
-		vertexAttributes[0].binding = 0; // must match binding above 
-		vertexAttributes[0].location = 0; // must match shader 
-		vertexAttributes[0].format = VK_FORMAT_R32G32B32_SFLOAT;
-		vertexAttributes[0].offset = 0;
-
-		vertexAttributes[1].binding = 1; // must match binding above 
-		vertexAttributes[1].location = 1; // must match shader 
-		vertexAttributes[1].format = VK_FORMAT_R32G32_SFLOAT;
-		vertexAttributes[1].offset = 0;
-
-		VkPipelineVertexInputStateCreateInfo inputInfo{};
-		inputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-
-		inputInfo.vertexBindingDescriptionCount = 2; // number of vertexInputs above 
-		inputInfo.pVertexBindingDescriptions = vertexInputs;
-		inputInfo.vertexAttributeDescriptionCount = 2; // number of vertexAttributes above 
-		inputInfo.pVertexAttributeDescriptions = vertexAttributes;
-
-		// Define which primitive (point, line, triangle, ...) the input is 
-		// assembled into for rasterization. 
-		VkPipelineInputAssemblyStateCreateInfo assemblyInfo{};
-		assemblyInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-		assemblyInfo.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-		assemblyInfo.primitiveRestartEnable = VK_FALSE;
-
-		// Define viewport and scissor regions 
-		VkViewport viewport{};
-		viewport.x = 0.f;
-		viewport.y = 0.f;
-		viewport.width = float(aWindow.swapchainExtent.width);
-		viewport.height = float(aWindow.swapchainExtent.height);
-		viewport.minDepth = 0.f;
-		viewport.maxDepth = 1.f;
+		if( AlphaMode::blend == aAlphaMode )
+			desc.blend = BlendMode::alpha;
 
-		VkRect2D scissor{};
-		scissor.offset = VkOffset2D{ 0, 0 };
-		scissor.extent = VkExtent2D{ aWindow.swapchainExtent.width, aWindow.swapchainExtent.height };
-
-		VkPipelineViewportStateCreateInfo viewportInfo{};
-		viewportInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-		viewportInfo.viewportCount = 1;
-		viewportInfo.pViewports = &viewport;
-		viewportInfo.scissorCount = 1;
-		viewportInfo.pScissors = &scissor;
-
-		// Define rasterization options 
-		VkPipelineRasterizationStateCreateInfo rasterInfo{};
-		rasterInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-		rasterInfo.depthClampEnable = VK_FALSE;
-		rasterInfo.rasterizerDiscardEnable = VK_FALSE;
-		rasterInfo.polygonMode = VK_POLYGON_MODE_FILL;
-		rasterInfo.cullMode = VK_CULL_MODE_BACK_BIT;
-		rasterInfo.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
-		rasterInfo.depthBiasEnable = VK_FALSE;
-		rasterInfo.lineWidth = 1.f; // required
-
-		// Define multisampling state 
-		VkPipelineMultisampleStateCreateInfo samplingInfo{};
-		samplingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-		samplingInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
-
-		// Define blend state 
-		// We define one blend state per color attachment - this example uses a 
-		// single color attachment, so we only need one. Right now, we donft do any 
-		// blending, so we can ignore most of the members. 
-		VkPipelineColorBlendAttachmentState blendStates[1]{};
-		blendStates[0].blendEnable = VK_TRUE; // New! Used to be VK FALSE. 
-		blendStates[0].colorBlendOp = VK_BLEND_OP_ADD; // New! 
-		blendStates[0].srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA; // New! 
-		blendStates[0].dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
-		blendStates[0].colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-
-		VkPipelineColorBlendStateCreateInfo blendInfo{};
-		blendInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-		blendInfo.logicOpEnable = VK_FALSE;
-		blendInfo.attachmentCount = 1;
-		blendInfo.pAttachments = blendStates;
-
-		// Create pipeline 
-		VkGraphicsPipelineCreateInfo pipeInfo{};
-		pipeInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-
-		pipeInfo.stageCount = 2; // vertex + fragment stages 
-		pipeInfo.pStages = stages;
-
-		pipeInfo.pVertexInputState = &inputInfo;
-		pipeInfo.pInputAssemblyState = &assemblyInfo;
-		pipeInfo.pTessellationState = nullptr; // no tessellation 
-		pipeInfo.pViewportState = &viewportInfo;
-		pipeInfo.pRasterizationState = &rasterInfo;
-		pipeInfo.pMultisampleState = &samplingInfo;
-		pipeInfo.pDepthStencilState = &depthInfo; // no depth or stencil buffers 
-		pipeInfo.pColorBlendState = &blendInfo;
-		pipeInfo.pDynamicState = nullptr; // no dynamic states
-
-		pipeInfo.layout = aPipelineLayout;
-		pipeInfo.renderPass = aRenderPass;
-		pipeInfo.subpass = 0; // first subpass of aRenderPass 
-
-		VkPipeline pipe = VK_NULL_HANDLE;
-		if (auto const res = vkCreateGraphicsPipelines(aWindow.device, VK_NULL_HANDLE, 1, &pipeInfo, nullptr, &pipe); VK_SUCCESS != res)
-		{
-			throw lut::Error("Unable to create graphics pipeline\n" "vkCreateGraphicsPipelines() returned %s", lut::to_string(res).c_str());
-
-		}
-
-		return lut::Pipeline(aWindow.device, pipe);
+		return desc;
 	}
 
-	void create_swapchain_framebuffers( lut::VulkanWindow const& aWindow, VkRenderPass aRenderPass, std::vector<lut::Framebuffer>& aFramebuffers, VkImageView aDepthView)
+	void create_framebuffers( lut::VulkanContext const& aContext, VkRenderPass aRenderPass, std::vector<VkImageView> const& aColorViews, VkExtent2D const& aExtent, std::vector<lut::Framebuffer>& aFramebuffers, VkImageView aDepthView)
 	{
 		assert( aFramebuffers.empty() );
 
-		for (std::size_t i = 0; i < aWindow.swapViews.size(); ++i)
+		for (std::size_t i = 0; i < aColorViews.size(); ++i)
 		{
 			VkImageView attachments[2] = { 
-				aWindow.swapViews[i], 
+				aColorViews[i], 
 				aDepthView
 			};
 
@@ -835,24 +1440,24 @@ namespace
 			fbInfo.renderPass = aRenderPass;
 			fbInfo.attachmentCount = 2;
 			fbInfo.pAttachments = attachments;
-			fbInfo.width = aWindow.swapchainExtent.width;
-			fbInfo.height = aWindow.swapchainExtent.height;
+			fbInfo.width = aExtent.width;
+			fbInfo.height = aExtent.height;
 			fbInfo.layers = 1;
 
 			VkFramebuffer fb = VK_NULL_HANDLE;
-			if (auto const res = vkCreateFramebuffer(aWindow.device, &fbInfo, nullptr, &fb); VK_SUCCESS != res)
+			if (auto const res = vkCreateFramebuffer(aContext.device, &fbInfo, nullptr, &fb); VK_SUCCESS != res)
 			{
-				throw lut::Error("Unable to create framebuffer for swap chain image %zu\n" "vkCreateFramebuffer() returned %s", i, lut::to_string(res).c_str());
+				throw lut::Error("Unable to create framebuffer for color image %zu\n" "vkCreateFramebuffer() returned %s", i, lut::to_string(res).c_str());
 
 			}
 
-			aFramebuffers.emplace_back(lut::Framebuffer(aWindow.device, fb));
+			aFramebuffers.emplace_back(lut::Framebuffer(aContext.device, fb));
 		}
 
-		assert( aWindow.swapViews.size() == aFramebuffers.size() );
+		assert( aColorViews.size() == aFramebuffers.size() );
 	}
 
-	lut::DescriptorSetLayout create_scene_descriptor_layout( lut::VulkanWindow const& aWindow )
+	lut::DescriptorSetLayout create_scene_descriptor_layout( lut::VulkanContext const& aContext )
 	{
 		VkDescriptorSetLayoutBinding bindings[1]{}; 
 		bindings[0].binding = 0; // number must match the index of the corresponding 
@@ -867,15 +1472,15 @@ namespace
 		layoutInfo.pBindings = bindings; 
 			
 		VkDescriptorSetLayout layout = VK_NULL_HANDLE; 
-		if(auto const res = vkCreateDescriptorSetLayout(aWindow.device, &layoutInfo, nullptr, &layout); VK_SUCCESS != res)
+		if(auto const res = vkCreateDescriptorSetLayout(aContext.device, &layoutInfo, nullptr, &layout); VK_SUCCESS != res)
 		{
 			throw lut::Error("Unable to create descriptor set layout\n" "vkCreateDescriptorSetLayout() returned %s", lut::to_string(res).c_str()); 
 				
 		} 
 			
-		return lut::DescriptorSetLayout(aWindow.device, layout);
+		return lut::DescriptorSetLayout(aContext.device, layout);
 	}
-	lut::DescriptorSetLayout create_object_descriptor_layout( lut::VulkanWindow const& aWindow )
+	lut::DescriptorSetLayout create_object_descriptor_layout( lut::VulkanContext const& aContext )
 	{
 		VkDescriptorSetLayoutBinding bindings[1]{}; 
 		bindings[0].binding = 0; // this must match the shaders 
@@ -889,17 +1494,28 @@ namespace
 		layoutInfo.pBindings = bindings; 
 			
 		VkDescriptorSetLayout layout = VK_NULL_HANDLE; 
-		if(auto const res = vkCreateDescriptorSetLayout(aWindow.device, &layoutInfo,  nullptr, &layout); VK_SUCCESS != res)
+		if(auto const res = vkCreateDescriptorSetLayout(aContext.device, &layoutInfo,  nullptr, &layout); VK_SUCCESS != res)
 		{
 			throw lut::Error("Unable to create descriptor set layout\n" "vkCreateDescriptorSetLayout() returned %s", lut::to_string(res).c_str());
 				
 		} 
 			
-		return lut::DescriptorSetLayout(aWindow.device, layout);
+		return lut::DescriptorSetLayout(aContext.device, layout);
+	}
+
+	lut::DescriptorUpdateTemplate create_object_descriptor_template( lut::VulkanContext const& aContext, VkDescriptorSetLayout aObjectLayout )
+	{
+		VkDescriptorUpdateTemplateEntry entries[1]{};
+		entries[0].dstBinding = 0; // this must match create_object_descriptor_layout()
+		entries[0].descriptorCount = 1;
+		entries[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		entries[0].offset = offsetof(ObjectDescriptors, texture);
+		entries[0].stride = sizeof(ObjectDescriptors);
+
+		return lut::create_descriptor_update_template( aContext, aObjectLayout, { std::begin(entries), std::end(entries) } );
 	}
 
-	void record_commands( VkCommandBuffer aCmdBuff, VkRenderPass aRenderPass, VkFramebuffer aFramebuffer, VkPipeline aGraphicsPipe, VkExtent2D const& aImageExtent, VkBuffer aPositionBuffer, VkBuffer aTexCoordBuffer, std::uint32_t aVertexCount, VkBuffer aSceneUBO, glsl::SceneUniform const& aSceneUniform, VkPipelineLayout aGraphicsLayout, VkDescriptorSet aSceneDescriptors, VkDescriptorSet aObjectDescriptors, VkBuffer aSpritePosBuffer,
-		VkBuffer aSpriteTexBuffer, std::uint32_t aSpriteVertexCount, VkDescriptorSet aSpriteObjDescriptors, VkPipeline aAlphaPipeline)
+	void record_commands( VkCommandBuffer aCmdBuff, lut::RenderGraph const& aGraph )
 	{
 		// Begin recording commands
 		VkCommandBufferBeginInfo begInfo{};
@@ -912,24 +1528,22 @@ namespace
 			throw lut::Error("Unable to begin recording command buffer\n" "vkBeginCommandBuffer() returned %s", lut::to_string(res).c_str());
 		}
 
-		lut::buffer_barrier(aCmdBuff, 
-			aSceneUBO,
-			VK_ACCESS_UNIFORM_READ_BIT, 
-			VK_ACCESS_TRANSFER_WRITE_BIT, 
-			VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, 
-			VK_PIPELINE_STAGE_TRANSFER_BIT 
-		); 
-			
+		aGraph.execute( aCmdBuff );
+
+		// End command recording 
+		if (auto const res = vkEndCommandBuffer(aCmdBuff); VK_SUCCESS != res)
+		{
+			throw lut::Error("Unable to end recording command buffer\n" "vkEndCommandBuffer() returned %s", lut::to_string(res).c_str());
+		}
+	}
+
+	void record_scene_upload( VkCommandBuffer aCmdBuff, VkBuffer aSceneUBO, glsl::SceneUniform const& aSceneUniform )
+	{
 		vkCmdUpdateBuffer(aCmdBuff, aSceneUBO, 0, sizeof(glsl::SceneUniform), &aSceneUniform);
-		
-		lut::buffer_barrier(aCmdBuff, 
-			aSceneUBO, 
-			VK_ACCESS_TRANSFER_WRITE_BIT, 
-			VK_ACCESS_UNIFORM_READ_BIT, 
-			VK_PIPELINE_STAGE_TRANSFER_BIT, 
-			VK_PIPELINE_STAGE_VERTEX_SHADER_BIT 
-		);
+	}
 
+	void record_scene_pass( VkCommandBuffer aCmdBuff, SceneTarget const& aTarget, VkPipeline const* aPipelines, VkExtent2D const& aImageExtent, VkPipelineLayout aGraphicsLayout, VkDescriptorSet aSceneDescriptors, VkDescriptorSet aTextureTable, VkBuffer aInstanceBuffer, VkDeviceSize aInstanceOffset, std::vector<SceneObject> const& aObjects, RenderQueue const& aQueue )
+	{
 		// Begin render pass 
 		VkClearValue clearValues[2]{};
 		clearValues[0].color.float32[0] = 0.1f; // Clear to a dark gray background. 
@@ -939,56 +1553,144 @@ namespace
 
 		clearValues[1].depthStencil.depth = 1.f;
 
-		VkRenderPassBeginInfo passInfo{};
-		passInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-		passInfo.renderPass = aRenderPass;
-		passInfo.framebuffer = aFramebuffer;
-		passInfo.renderArea.offset = VkOffset2D{ 0, 0 };
-		passInfo.renderArea.extent = aImageExtent;
-		passInfo.clearValueCount = 2;
-		passInfo.pClearValues = clearValues;
+		bool const dynamicRendering = VK_NULL_HANDLE == aTarget.renderPass;
+		if( dynamicRendering )
+		{
+			// Same load/store ops and layouts as create_render_pass(). The
+			// frame graph has transitioned the images to these layouts.
+			VkRenderingAttachmentInfoKHR colorAttachment{};
+			colorAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+			colorAttachment.imageView = aTarget.colorView;
+			colorAttachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+			colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+			colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+			colorAttachment.clearValue = clearValues[0];
+
+			VkRenderingAttachmentInfoKHR depthAttachment{};
+			depthAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+			depthAttachment.imageView = aTarget.depthView;
+			depthAttachment.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+			depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+			depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+			depthAttachment.clearValue = clearValues[1];
+
+			VkRenderingInfoKHR renderingInfo{};
+			renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR;
+			renderingInfo.renderArea.offset = VkOffset2D{ 0, 0 };
+			renderingInfo.renderArea.extent = aImageExtent;
+			renderingInfo.layerCount = 1;
+			renderingInfo.colorAttachmentCount = 1;
+			renderingInfo.pColorAttachments = &colorAttachment;
+			renderingInfo.pDepthAttachment = &depthAttachment;
+
+			vkCmdBeginRenderingKHR(aCmdBuff, &renderingInfo);
+		}
+		else
+		{
+			VkRenderPassBeginInfo passInfo{};
+			passInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+			passInfo.renderPass = aTarget.renderPass;
+			passInfo.framebuffer = aTarget.framebuffer;
+			passInfo.renderArea.offset = VkOffset2D{ 0, 0 };
+			passInfo.renderArea.extent = aImageExtent;
+			passInfo.clearValueCount = 2;
+			passInfo.pClearValues = clearValues;
+
+			vkCmdBeginRenderPass(aCmdBuff, &passInfo, VK_SUBPASS_CONTENTS_INLINE);
+		}
+
+		// Viewport and scissor cover the whole render target. All pipeline
+		// variants declare them as dynamic, so they persist across pipeline
+		// binds.
+		VkViewport viewport{};
+		viewport.x = 0.f;
+		viewport.y = 0.f;
+		viewport.width = float(aImageExtent.width);
+		viewport.height = float(aImageExtent.height);
+		viewport.minDepth = 0.f;
+		viewport.maxDepth = 1.f;
 
-		vkCmdBeginRenderPass(aCmdBuff, &passInfo, VK_SUBPASS_CONTENTS_INLINE);
+		vkCmdSetViewport(aCmdBuff, 0, 1, &viewport);
 
-		// Begin drawing with our graphics pipeline 
-		vkCmdBindPipeline(aCmdBuff, VK_PIPELINE_BIND_POINT_GRAPHICS, aGraphicsPipe);
-		vkCmdBindDescriptorSets(aCmdBuff, VK_PIPELINE_BIND_POINT_GRAPHICS, aGraphicsLayout, 0, 1, &aSceneDescriptors, 0, nullptr);
-		vkCmdBindDescriptorSets(aCmdBuff, VK_PIPELINE_BIND_POINT_GRAPHICS, aGraphicsLayout, 1, 1, &aObjectDescriptors, 0, nullptr);
+		VkRect2D scissor{};
+		scissor.offset = VkOffset2D{ 0, 0 };
+		scissor.extent = aImageExtent;
 
-		// Bind vertex input 
-		VkBuffer buffers[2] = { aPositionBuffer, aTexCoordBuffer };
-		VkDeviceSize offsets[2]{}; 
-			
-		vkCmdBindVertexBuffers(aCmdBuff, 0, 2, buffers, offsets); 
-			
-		// Draw vertices 
-		vkCmdDraw(aCmdBuff, aVertexCount, 1, 0, 0);
+		vkCmdSetScissor(aCmdBuff, 0, 1, &scissor);
 
-		vkCmdBindPipeline(aCmdBuff, VK_PIPELINE_BIND_POINT_GRAPHICS, aAlphaPipeline);
+		// Scene descriptors are shared by all pipeline variants (same layout)
+		vkCmdBindDescriptorSets(aCmdBuff, VK_PIPELINE_BIND_POINT_GRAPHICS, aGraphicsLayout, 0, 1, &aSceneDescriptors, 0, nullptr);
 
-		vkCmdBindDescriptorSets(aCmdBuff, VK_PIPELINE_BIND_POINT_GRAPHICS, aGraphicsLayout, 1, 1, &aSpriteObjDescriptors, 0, nullptr);
-		
-		VkBuffer spriteBuffers[2] = { aSpritePosBuffer, aSpriteTexBuffer }; 
-			
-		
-		VkDeviceSize spriteOffsets[2]{}; 
-			
-		vkCmdBindVertexBuffers(aCmdBuff, 0, 2, spriteBuffers, spriteOffsets); 
-			
-		vkCmdDraw(aCmdBuff, aSpriteVertexCount, 1, 0, 0);
+		// The bindless texture table is bound once; draws only push the
+		// index of their texture.
+		bool const bindless = VK_NULL_HANDLE != aTextureTable;
+		if( bindless )
+			vkCmdBindDescriptorSets(aCmdBuff, VK_PIPELINE_BIND_POINT_GRAPHICS, aGraphicsLayout, 1, 1, &aTextureTable, 0, nullptr);
 
-		// End the render pass 
-		vkCmdEndRenderPass(aCmdBuff);
+		// Per-instance world transforms for this frame; each object selects
+		// its own via the first instance index.
+		vkCmdBindVertexBuffers(aCmdBuff, 2, 1, &aInstanceBuffer, &aInstanceOffset);
 
-		// End command recording 
-		if (auto const res = vkEndCommandBuffer(aCmdBuff); VK_SUCCESS != res)
+		// Draw the sorted queue. Consecutive draws frequently share state,
+		// so only bind what changed since the previous draw.
+		VkPipeline boundPipe = VK_NULL_HANDLE;
+		VkDescriptorSet boundSet = VK_NULL_HANDLE;
+		std::uint32_t pushedTexture = ~std::uint32_t(0);
+		TexturedMesh const* boundMesh = nullptr;
+
+		for( auto const& item : aQueue.items )
 		{
-			throw lut::Error("Unable to end recording command buffer\n" "vkEndCommandBuffer() returned %s", lut::to_string(res).c_str());
+			assert( item.object < aObjects.size() );
+			auto const& object = aObjects[item.object];
+
+			auto const pipeIndex = draw_key_pipeline( item.key );
+			assert( pipeIndex < kAlphaModeCount );
+
+			if( aPipelines[pipeIndex] != boundPipe )
+			{
+				boundPipe = aPipelines[pipeIndex];
+				vkCmdBindPipeline(aCmdBuff, VK_PIPELINE_BIND_POINT_GRAPHICS, boundPipe);
+			}
+
+			if( bindless )
+			{
+				if( object.textureIndex != pushedTexture )
+				{
+					pushedTexture = object.textureIndex;
+
+					BindlessPushConstants const push{ pushedTexture };
+					vkCmdPushConstants(aCmdBuff, aGraphicsLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(push), &push);
+				}
+			}
+			else if( object.objectDescriptors != boundSet )
+			{
+				boundSet = object.objectDescriptors;
+				vkCmdBindDescriptorSets(aCmdBuff, VK_PIPELINE_BIND_POINT_GRAPHICS, aGraphicsLayout, 1, 1, &boundSet, 0, nullptr);
+			}
+
+			if( object.mesh != boundMesh )
+			{
+				boundMesh = object.mesh;
+
+				// Bind vertex input 
+				VkBuffer buffers[2] = { boundMesh->positions.buffer, boundMesh->texcoords.buffer };
+				VkDeviceSize offsets[2]{}; 
+
+				vkCmdBindVertexBuffers(aCmdBuff, 0, 2, buffers, offsets); 
+			}
+
+			// Draw vertices 
+			vkCmdDraw(aCmdBuff, object.mesh->vertexCount, 1, 0, object.node);
 		}
 
+		// End the render pass 
+		if( dynamicRendering )
+			vkCmdEndRenderingKHR(aCmdBuff);
+		else
+			vkCmdEndRenderPass(aCmdBuff);
 	}
 
-	void submit_commands( lut::VulkanWindow const& aWindow, VkCommandBuffer aCmdBuff, VkFence aFence, VkSemaphore aWaitSemaphore, VkSemaphore aSignalSemaphore )
+	void submit_commands( lut::VulkanContext const& aContext, VkCommandBuffer aCmdBuff, VkFence aFence, VkSemaphore aWaitSemaphore, VkSemaphore aSignalSemaphore )
 	{
 		VkPipelineStageFlags waitPipelineStages = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
 
@@ -997,14 +1699,22 @@ namespace
 		submitInfo.commandBufferCount = 1;
 		submitInfo.pCommandBuffers = &aCmdBuff;
 
-		submitInfo.waitSemaphoreCount = 1;
-		submitInfo.pWaitSemaphores = &aWaitSemaphore;
-		submitInfo.pWaitDstStageMask = &waitPipelineStages;
+		// Semaphores are optional (VK_NULL_HANDLE); they are not needed when
+		// rendering into offscreen images.
+		if( VK_NULL_HANDLE != aWaitSemaphore )
+		{
+			submitInfo.waitSemaphoreCount = 1;
+			submitInfo.pWaitSemaphores = &aWaitSemaphore;
+			submitInfo.pWaitDstStageMask = &waitPipelineStages;
+		}
 
-		submitInfo.signalSemaphoreCount = 1;
-		submitInfo.pSignalSemaphores = &aSignalSemaphore;
+		if( VK_NULL_HANDLE != aSignalSemaphore )
+		{
+			submitInfo.signalSemaphoreCount = 1;
+			submitInfo.pSignalSemaphores = &aSignalSemaphore;
+		}
 
-		if (auto const res = vkQueueSubmit(aWindow.graphicsQueue, 1, &submitInfo, aFence); VK_SUCCESS != res)
+		if (auto const res = vkQueueSubmit(aContext.graphicsQueue, 1, &submitInfo, aFence); VK_SUCCESS != res)
 		{
 			throw lut::Error("Unable to submit command buffer to queue\n" "vkQueueSubmit() returned %s", lut::to_string(res).c_str());
 		}
@@ -1018,35 +1728,9 @@ namespace
 
 namespace
 {
-	std::tuple<lut::Image, lut::ImageView> create_depth_buffer( lut::VulkanWindow const& aWindow, lut::Allocator const& aAllocator )
+	std::tuple<lut::Image, lut::ImageView> create_depth_buffer( lut::VulkanContext const& aContext, lut::Allocator const& aAllocator, VkExtent2D const& aExtent, bool* aLazilyAllocated )
 	{
-		VkImageCreateInfo imageInfo{}; 
-		imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO; 
-		imageInfo.imageType = VK_IMAGE_TYPE_2D; 
-		imageInfo.format = cfg::kDepthFormat; 
-		imageInfo.extent.width = aWindow.swapchainExtent.width; 
-		imageInfo.extent.height = aWindow.swapchainExtent.height; 
-		imageInfo.extent.depth = 1; 
-		imageInfo.mipLevels = 1; 
-		imageInfo.arrayLayers = 1; 
-		imageInfo.samples = VK_SAMPLE_COUNT_1_BIT; 
-		imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL; 
-		imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT; 
-		imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE; 
-		imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED; 
-			 
-		VmaAllocationCreateInfo allocInfo{}; 
-		allocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY; 
-			
-		VkImage image = VK_NULL_HANDLE; 
-		VmaAllocation allocation = VK_NULL_HANDLE;
-
-		if (auto const res = vmaCreateImage(aAllocator.allocator, &imageInfo, &allocInfo, &image, &allocation, nullptr); VK_SUCCESS != res)
-		{ 
-			throw lut::Error("Unable to allocate depth buffer image.\n" "vmaCreateImage() returned %s", lut::to_string(res).c_str()); 
-		} 
-			
-		lut::Image depthImage(aAllocator.allocator, image, allocation); 
+		lut::Image depthImage = lut::create_transient_attachment( aAllocator, aExtent, cfg::kDepthFormat, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_SAMPLE_COUNT_1_BIT, aLazilyAllocated );
 			
 		// Create the image view 
 		VkImageViewCreateInfo viewInfo{}; 
@@ -1062,13 +1746,13 @@ namespace
 		}; 
 			
 		VkImageView view = VK_NULL_HANDLE; 
-		if(auto const res = vkCreateImageView(aWindow.device, &viewInfo, nullptr, &view); VK_SUCCESS != res)
+		if(auto const res = vkCreateImageView(aContext.device, &viewInfo, nullptr, &view); VK_SUCCESS != res)
 		{
 			throw lut::Error("Unable to create image view\n" "vkCreateImageView() returned %s", lut::to_string(res).c_str()); 
 				
 		} 
 			
-		return{ std::move(depthImage), lut::ImageView(aWindow.device, view) };
+		return{ std::move(depthImage), lut::ImageView(aContext.device, view) };
 	}
 }
 
@@ -0,0 +1,158 @@
+#include "offscreen.hpp"
+
+#include <limits>
+
+#include <cassert>
+
+#include <stb_image_write.h>
+
+#include "../labutils/error.hpp"
+#include "../labutils/vkutil.hpp"
+#include "../labutils/vkbuffer.hpp"
+#include "../labutils/to_string.hpp"
+namespace lut = labutils;
+
+OffscreenTargets create_offscreen_targets( lut::VulkanContext const& aContext, lut::Allocator const& aAllocator, VkFormat aFormat, VkExtent2D const& aExtent, std::uint32_t aCount )
+{
+	OffscreenTargets ret;
+	ret.format = aFormat;
+	ret.extent = aExtent;
+
+	for( std::uint32_t i = 0; i < aCount; ++i )
+	{
+		VkImageCreateInfo imageInfo{};
+		imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageInfo.format = aFormat;
+		imageInfo.extent.width = aExtent.width;
+		imageInfo.extent.height = aExtent.height;
+		imageInfo.extent.depth = 1;
+		imageInfo.mipLevels = 1;
+		imageInfo.arrayLayers = 1;
+		imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+		imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+		VmaAllocationCreateInfo allocInfo{};
+		allocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+
+		VkImage image = VK_NULL_HANDLE;
+		VmaAllocation allocation = VK_NULL_HANDLE;
+
+		if( auto const res = vmaCreateImage( aAllocator.allocator, &imageInfo, &allocInfo, &image, &allocation, nullptr ); VK_SUCCESS != res )
+		{
+			throw lut::Error( "Unable to allocate offscreen color image %u\n" "vmaCreateImage() returned %s", i, lut::to_string(res).c_str() );
+		}
+
+		auto& target = ret.images.emplace_back( lut::Image( aAllocator.allocator, image, allocation ) );
+		lut::set_memory_category( aAllocator, allocation, lut::MemoryCategory::attachment );
+
+		// Same view as for a swap chain image
+		VkImageViewCreateInfo viewInfo{};
+		viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		viewInfo.image = target.image;
+		viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewInfo.format = aFormat;
+		viewInfo.components = VkComponentMapping{};
+		viewInfo.subresourceRange = VkImageSubresourceRange{ VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+
+		VkImageView view = VK_NULL_HANDLE;
+		if( auto const res = vkCreateImageView( aContext.device, &viewInfo, nullptr, &view ); VK_SUCCESS != res )
+		{
+			throw lut::Error( "Unable to create offscreen image view %u\n" "vkCreateImageView() returned %s", i, lut::to_string(res).c_str() );
+		}
+
+		ret.views.emplace_back( lut::ImageView( aContext.device, view ) );
+		ret.viewHandles.emplace_back( view );
+	}
+
+	return ret;
+}
+
+void save_image_png( lut::VulkanContext const& aContext, lut::Allocator const& aAllocator, VkImage aImage, VkExtent2D const& aExtent, char const* aPath )
+{
+	assert( aPath );
+
+	auto const rowBytes = VkDeviceSize(aExtent.width) * 4;
+	lut::Buffer readback = lut::create_buffer( aAllocator, rowBytes * aExtent.height, VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_TO_CPU );
+
+	lut::CommandPool pool = lut::create_command_pool( aContext, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT );
+	VkCommandBuffer cbuff = lut::alloc_command_buffer( aContext, pool.handle );
+
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+	if( auto const res = vkBeginCommandBuffer( cbuff, &beginInfo ); VK_SUCCESS != res )
+	{
+		throw lut::Error( "Beginning command buffer recording\n" "vkBeginCommandBuffer() returned %s", lut::to_string(res).c_str() );
+	}
+
+	// Make the rendered results visible to the copy. The render pass already
+	// left the image in TRANSFER_SRC_OPTIMAL.
+	lut::image_barrier( cbuff, aImage,
+		VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+		VK_ACCESS_TRANSFER_READ_BIT,
+		VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+		VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+		VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+		VK_PIPELINE_STAGE_TRANSFER_BIT
+	);
+
+	VkBufferImageCopy copy{};
+	copy.bufferOffset = 0;
+	copy.bufferRowLength = 0; // tightly packed
+	copy.bufferImageHeight = 0;
+	copy.imageSubresource = VkImageSubresourceLayers{ VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+	copy.imageOffset = VkOffset3D{ 0, 0, 0 };
+	copy.imageExtent = VkExtent3D{ aExtent.width, aExtent.height, 1 };
+
+	vkCmdCopyImageToBuffer( cbuff, aImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, readback.buffer, 1, &copy );
+
+	lut::buffer_barrier( cbuff, readback.buffer,
+		VK_ACCESS_TRANSFER_WRITE_BIT,
+		VK_ACCESS_HOST_READ_BIT,
+		VK_PIPELINE_STAGE_TRANSFER_BIT,
+		VK_PIPELINE_STAGE_HOST_BIT
+	);
+
+	if( auto const res = vkEndCommandBuffer( cbuff ); VK_SUCCESS != res )
+	{
+		throw lut::Error( "Ending command buffer recording\n" "vkEndCommandBuffer() returned %s", lut::to_string(res).c_str() );
+	}
+
+	lut::Fence copyComplete = lut::create_fence( aContext );
+
+	VkSubmitInfo submitInfo{};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &cbuff;
+
+	if( auto const res = vkQueueSubmit( aContext.graphicsQueue, 1, &submitInfo, copyComplete.handle ); VK_SUCCESS != res )
+	{
+		throw lut::Error( "Submitting commands\n" "vkQueueSubmit() returned %s", lut::to_string(res).c_str() );
+	}
+
+	if( auto const res = vkWaitForFences( aContext.device, 1, &copyComplete.handle, VK_TRUE, std::numeric_limits<std::uint64_t>::max() ); VK_SUCCESS != res )
+	{
+		throw lut::Error( "Waiting for readback to complete\n" "vkWaitForFences() returned %s", lut::to_string(res).c_str() );
+	}
+
+	void* dptr = nullptr;
+	if( auto const res = vmaMapMemory( aAllocator.allocator, readback.allocation, &dptr ); VK_SUCCESS != res )
+	{
+		throw lut::Error( "Mapping memory for reading\n" "vmaMapMemory() returned %s", lut::to_string(res).c_str() );
+	}
+
+	// GPU_TO_CPU memory is not necessarily HOST_COHERENT
+	vmaInvalidateAllocation( aAllocator.allocator, readback.allocation, 0, VK_WHOLE_SIZE );
+
+	auto const written = stbi_write_png( aPath, int(aExtent.width), int(aExtent.height), 4, dptr, int(rowBytes) );
+
+	vmaUnmapMemory( aAllocator.allocator, readback.allocation );
+
+	if( !written )
+		throw lut::Error( "Unable to write image '%s'", aPath );
+}
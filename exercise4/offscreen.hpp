@@ -0,0 +1,46 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#include <volk/volk.h>
+
+#include "../labutils/vkimage.hpp"
+#include "../labutils/vkobject.hpp"
+#include "../labutils/allocator.hpp"
+#include "../labutils/vulkan_context.hpp"
+
+// Color targets for headless rendering. These stand in for the swap chain
+// images: one image per frame in flight, all with the same format and
+// extent. The images can be used as transfer sources, so that the results
+// can be read back (see save_image_png()).
+struct OffscreenTargets
+{
+	std::vector<labutils::Image> images;
+	std::vector<labutils::ImageView> views;
+
+	// Raw view handles, as expected when creating framebuffers
+	std::vector<VkImageView> viewHandles;
+
+	VkFormat format = VK_FORMAT_UNDEFINED;
+	VkExtent2D extent{};
+};
+
+OffscreenTargets create_offscreen_targets(
+	labutils::VulkanContext const&,
+	labutils::Allocator const&,
+	VkFormat,
+	VkExtent2D const&,
+	std::uint32_t aCount
+);
+
+// Copies an 8-bit RGBA image to host memory and writes it to aPath as PNG.
+// The image must be in VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL and must no
+// longer be written to by the GPU. Blocks until the copy has completed.
+void save_image_png(
+	labutils::VulkanContext const&,
+	labutils::Allocator const&,
+	VkImage,
+	VkExtent2D const&,
+	char const* aPath
+);
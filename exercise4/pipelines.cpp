@@ -0,0 +1,472 @@
+#include "pipelines.hpp"
+
+#include <chrono>
+#include <memory>
+#include <utility>
+#include <functional>
+
+#include <cstdio>
+
+#include <cassert>
+
+#if !defined(GLM_FORCE_RADIANS)
+#	define GLM_FORCE_RADIANS
+#endif
+#include <glm/glm.hpp>
+
+#include "../labutils/hash.hpp"
+#include "../labutils/error.hpp"
+#include "../labutils/to_string.hpp"
+namespace lut = labutils;
+
+namespace
+{
+	// Per-pipeline state that differs between the pipelines in a batch. The
+	// create infos point into these, so they must not move once filled in.
+	struct PipelineState_
+	{
+		VkPipelineShaderStageCreateInfo stages[2];
+		std::vector<VkSpecializationMapEntry> fragConstants;
+		VkSpecializationInfo fragSpecialization;
+		VkPipelineDepthStencilStateCreateInfo depthInfo;
+		VkPipelineRasterizationStateCreateInfo rasterInfo;
+		VkPipelineColorBlendAttachmentState blendStates[1];
+		VkPipelineColorBlendStateCreateInfo blendInfo;
+		VkPipelineRenderingCreateInfoKHR renderingInfo;
+	};
+}
+
+bool operator== ( PipelineDesc const& aX, PipelineDesc const& aY ) noexcept
+{
+	return aX.vertShader == aY.vertShader
+		&& aX.fragShader == aY.fragShader
+		&& aX.fragConstants == aY.fragConstants
+		&& aX.blend == aY.blend
+		&& aX.depthTest == aY.depthTest
+		&& aX.depthWrite == aY.depthWrite
+		&& aX.cullMode == aY.cullMode
+		&& aX.renderPass == aY.renderPass
+		&& aX.subpass == aY.subpass
+		&& aX.layout == aY.layout
+		&& aX.colorFormat == aY.colorFormat
+		&& aX.depthFormat == aY.depthFormat
+	;
+}
+bool operator!= ( PipelineDesc const& aX, PipelineDesc const& aY ) noexcept
+{
+	return !(aX == aY);
+}
+
+std::size_t PipelineDescHash::operator() ( PipelineDesc const& aDesc ) const noexcept
+{
+	std::size_t ret = std::hash<std::string>{}( aDesc.vertShader );
+	lut::hash_combine( ret, std::hash<std::string>{}( aDesc.fragShader ) );
+	for( auto const value : aDesc.fragConstants )
+		lut::hash_combine( ret, std::size_t(value) );
+	lut::hash_combine( ret, std::size_t(aDesc.blend) );
+	lut::hash_combine( ret, std::size_t(aDesc.depthTest) | std::size_t(aDesc.depthWrite) << 1 );
+	lut::hash_combine( ret, std::size_t(aDesc.cullMode) );
+	lut::hash_combine( ret, std::hash<VkRenderPass>{}( aDesc.renderPass ) );
+	lut::hash_combine( ret, std::size_t(aDesc.subpass) );
+	lut::hash_combine( ret, std::hash<VkPipelineLayout>{}( aDesc.layout ) );
+	lut::hash_combine( ret, std::size_t(aDesc.colorFormat) );
+	lut::hash_combine( ret, std::size_t(aDesc.depthFormat) );
+	return ret;
+}
+
+
+PipelineRegistry::PipelineRegistry( labutils::VulkanContext const& aContext, VkPipelineCache aCache )
+	: mContext( &aContext )
+	, mCache( aCache )
+	, mShaders( aContext )
+{}
+
+VkPipeline PipelineRegistry::get( PipelineDesc const& aDesc )
+{
+	if( auto const pipe = find( aDesc ); VK_NULL_HANDLE != pipe )
+		return pipe;
+
+	request( aDesc );
+	create_pending();
+
+	auto const pipe = find( aDesc );
+	assert( VK_NULL_HANDLE != pipe );
+	return pipe;
+}
+
+VkPipeline PipelineRegistry::find( PipelineDesc const& aDesc ) const
+{
+	if( auto const it = mPipelines.find( aDesc ); mPipelines.end() != it )
+		return it->second.handle;
+
+	return VK_NULL_HANDLE;
+}
+
+void PipelineRegistry::request( PipelineDesc const& aDesc )
+{
+	if( mPipelines.count( aDesc ) )
+		return;
+
+	for( auto const& pending : mPending )
+	{
+		if( pending == aDesc )
+			return;
+	}
+
+	mPending.emplace_back( aDesc );
+}
+
+std::size_t PipelineRegistry::create_pending( labutils::ThreadPool* aPool )
+{
+	if( mPending.empty() )
+		return 0;
+
+	auto pending = std::move(mPending);
+	mPending.clear();
+
+	std::vector<double> times;
+	auto created = build( pending, aPool, &times );
+
+	auto const count = pending.size();
+	bool const batched = !aPool || 1 == count;
+
+	for( std::size_t i = 0; i < count; ++i )
+	{
+		mCreateTimes.emplace_back( PipelineCreateTime{ pending[i], times[i], batched ? std::uint32_t(count) : 1u } );
+		mPipelines.emplace( std::move(pending[i]), std::move(created[i]) );
+	}
+
+	return count;
+}
+
+std::vector<labutils::Pipeline> PipelineRegistry::build( std::vector<PipelineDesc> const& aDescs, labutils::ThreadPool* aPool, std::vector<double>* aTimes ) const
+{
+	auto const count = aDescs.size();
+
+	// Shader modules are shared through the cache. Hold on to them until the
+	// pipelines have been created, in case a module is replaced meanwhile.
+	std::vector<std::shared_ptr<lut::ShaderModule const>> shaders;
+	auto const shader_ = [&] (std::string const& aPath) {
+		shaders.emplace_back( mShaders.get( aPath.c_str() ) );
+		return shaders.back()->handle;
+	};
+
+	// State shared by all pipelines. Vertex inputs: positions (binding 0),
+	// texture coordinates (binding 1) and the per-instance world transform
+	// (binding 2, one location per matrix column).
+	VkVertexInputBindingDescription vertexInputs[3]{};
+	vertexInputs[0].binding = 0;
+	vertexInputs[0].stride = sizeof(float) * 3;
+	vertexInputs[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+	vertexInputs[1].binding = 1;
+	vertexInputs[1].stride = sizeof(float) * 2;
+	vertexInputs[1].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+	vertexInputs[2].binding = 2;
+	vertexInputs[2].stride = sizeof(glm::mat4);
+	vertexInputs[2].inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+
+	VkVertexInputAttributeDescription vertexAttributes[6]{};
+	vertexAttributes[0].binding = 0;
+	vertexAttributes[0].location = 0;
+	vertexAttributes[0].format = VK_FORMAT_R32G32B32_SFLOAT;
+	vertexAttributes[0].offset = 0;
+
+	vertexAttributes[1].binding = 1;
+	vertexAttributes[1].location = 1;
+	vertexAttributes[1].format = VK_FORMAT_R32G32_SFLOAT;
+	vertexAttributes[1].offset = 0;
+
+	for( std::uint32_t i = 0; i < 4; ++i )
+	{
+		vertexAttributes[2+i].binding = 2;
+		vertexAttributes[2+i].location = 2+i;
+		vertexAttributes[2+i].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+		vertexAttributes[2+i].offset = i * sizeof(glm::vec4);
+	}
+
+	VkPipelineVertexInputStateCreateInfo inputInfo{};
+	inputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+	inputInfo.vertexBindingDescriptionCount = 3;
+	inputInfo.pVertexBindingDescriptions = vertexInputs;
+	inputInfo.vertexAttributeDescriptionCount = 6;
+	inputInfo.pVertexAttributeDescriptions = vertexAttributes;
+
+	VkPipelineInputAssemblyStateCreateInfo assemblyInfo{};
+	assemblyInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+	assemblyInfo.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+	assemblyInfo.primitiveRestartEnable = VK_FALSE;
+
+	// Viewport and scissor are dynamic state, set when recording commands
+	VkPipelineViewportStateCreateInfo viewportInfo{};
+	viewportInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+	viewportInfo.viewportCount = 1;
+	viewportInfo.pViewports = nullptr;
+	viewportInfo.scissorCount = 1;
+	viewportInfo.pScissors = nullptr;
+
+	VkDynamicState const dynamicStates[] = {
+		VK_DYNAMIC_STATE_VIEWPORT,
+		VK_DYNAMIC_STATE_SCISSOR
+	};
+
+	VkPipelineDynamicStateCreateInfo dynamicInfo{};
+	dynamicInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+	dynamicInfo.dynamicStateCount = sizeof(dynamicStates) / sizeof(dynamicStates[0]);
+	dynamicInfo.pDynamicStates = dynamicStates;
+
+	VkPipelineMultisampleStateCreateInfo samplingInfo{};
+	samplingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+	samplingInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+	// Per-pipeline state
+	std::vector<PipelineState_> states( count );
+	std::vector<VkGraphicsPipelineCreateInfo> pipeInfos( count );
+
+	for( std::size_t i = 0; i < count; ++i )
+	{
+		auto const& desc = aDescs[i];
+		auto& state = states[i];
+
+		state.stages[0] = VkPipelineShaderStageCreateInfo{};
+		state.stages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		state.stages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+		state.stages[0].module = shader_( desc.vertShader );
+		state.stages[0].pName = "main";
+
+		state.stages[1] = VkPipelineShaderStageCreateInfo{};
+		state.stages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		state.stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+		state.stages[1].module = shader_( desc.fragShader );
+		state.stages[1].pName = "main";
+
+		if( !desc.fragConstants.empty() )
+		{
+			state.fragConstants.resize( desc.fragConstants.size() );
+			for( std::size_t j = 0; j < desc.fragConstants.size(); ++j )
+			{
+				state.fragConstants[j].constantID = std::uint32_t(j);
+				state.fragConstants[j].offset = std::uint32_t(j * sizeof(std::uint32_t));
+				state.fragConstants[j].size = sizeof(std::uint32_t);
+			}
+
+			state.fragSpecialization = VkSpecializationInfo{};
+			state.fragSpecialization.mapEntryCount = std::uint32_t(state.fragConstants.size());
+			state.fragSpecialization.pMapEntries = state.fragConstants.data();
+			state.fragSpecialization.dataSize = desc.fragConstants.size() * sizeof(std::uint32_t);
+			state.fragSpecialization.pData = desc.fragConstants.data();
+
+			state.stages[1].pSpecializationInfo = &state.fragSpecialization;
+		}
+
+		state.depthInfo = VkPipelineDepthStencilStateCreateInfo{};
+		state.depthInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+		state.depthInfo.depthTestEnable = desc.depthTest ? VK_TRUE : VK_FALSE;
+		state.depthInfo.depthWriteEnable = desc.depthWrite ? VK_TRUE : VK_FALSE;
+		state.depthInfo.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+		state.depthInfo.minDepthBounds = 0.f;
+		state.depthInfo.maxDepthBounds = 1.f;
+
+		state.rasterInfo = VkPipelineRasterizationStateCreateInfo{};
+		state.rasterInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+		state.rasterInfo.depthClampEnable = VK_FALSE;
+		state.rasterInfo.rasterizerDiscardEnable = VK_FALSE;
+		state.rasterInfo.polygonMode = VK_POLYGON_MODE_FILL;
+		state.rasterInfo.cullMode = desc.cullMode;
+		state.rasterInfo.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+		state.rasterInfo.depthBiasEnable = VK_FALSE;
+		state.rasterInfo.lineWidth = 1.f; // required
+
+		state.blendStates[0] = VkPipelineColorBlendAttachmentState{};
+		state.blendStates[0].colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+
+		switch( desc.blend )
+		{
+			case BlendMode::none:
+				state.blendStates[0].blendEnable = VK_FALSE;
+				break;
+			case BlendMode::alpha:
+				state.blendStates[0].blendEnable = VK_TRUE;
+				state.blendStates[0].colorBlendOp = VK_BLEND_OP_ADD;
+				state.blendStates[0].srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+				state.blendStates[0].dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+				break;
+		}
+
+		state.blendInfo = VkPipelineColorBlendStateCreateInfo{};
+		state.blendInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+		state.blendInfo.logicOpEnable = VK_FALSE;
+		state.blendInfo.attachmentCount = 1;
+		state.blendInfo.pAttachments = state.blendStates;
+
+		auto& pipeInfo = pipeInfos[i];
+		pipeInfo = VkGraphicsPipelineCreateInfo{};
+		pipeInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+
+		pipeInfo.stageCount = 2; // vertex + fragment stages
+		pipeInfo.pStages = state.stages;
+
+		pipeInfo.pVertexInputState = &inputInfo;
+		pipeInfo.pInputAssemblyState = &assemblyInfo;
+		pipeInfo.pTessellationState = nullptr; // no tessellation
+		pipeInfo.pViewportState = &viewportInfo;
+		pipeInfo.pRasterizationState = &state.rasterInfo;
+		pipeInfo.pMultisampleState = &samplingInfo;
+		pipeInfo.pDepthStencilState = &state.depthInfo;
+		pipeInfo.pColorBlendState = &state.blendInfo;
+		pipeInfo.pDynamicState = &dynamicInfo;
+
+		pipeInfo.layout = desc.layout;
+		pipeInfo.renderPass = desc.renderPass;
+		pipeInfo.subpass = desc.subpass;
+
+		// Dynamic rendering: the attachment formats replace the render pass
+		if( VK_NULL_HANDLE == desc.renderPass )
+		{
+			assert( VK_FORMAT_UNDEFINED != desc.colorFormat );
+
+			state.renderingInfo = VkPipelineRenderingCreateInfoKHR{};
+			state.renderingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR;
+			state.renderingInfo.colorAttachmentCount = 1;
+			state.renderingInfo.pColorAttachmentFormats = &desc.colorFormat;
+			state.renderingInfo.depthAttachmentFormat = desc.depthFormat;
+
+			pipeInfo.pNext = &state.renderingInfo;
+			pipeInfo.subpass = 0;
+		}
+	}
+
+	using Clock_ = std::chrono::steady_clock;
+	using Ms_ = std::chrono::duration<double,std::milli>;
+
+	std::vector<VkPipeline> pipes( count, VK_NULL_HANDLE );
+	std::vector<double> times( count );
+	VkResult res = VK_SUCCESS;
+
+	if( aPool && count > 1 )
+	{
+		std::vector<VkResult> results( count, VK_SUCCESS );
+
+		aPool->parallel_for( count, 1, [&] (std::size_t aBegin, std::size_t aEnd) {
+			for( std::size_t i = aBegin; i < aEnd; ++i )
+			{
+				auto const start = Clock_::now();
+				results[i] = vkCreateGraphicsPipelines( mContext->device, mCache, 1, &pipeInfos[i], nullptr, &pipes[i] );
+				times[i] = Ms_( Clock_::now() - start ).count();
+			}
+		} );
+
+		for( auto const r : results )
+		{
+			if( VK_SUCCESS != r )
+				res = r;
+		}
+	}
+	else
+	{
+		auto const start = Clock_::now();
+		res = vkCreateGraphicsPipelines( mContext->device, mCache, std::uint32_t(count), pipeInfos.data(), nullptr, pipes.data() );
+
+		auto const ms = Ms_( Clock_::now() - start ).count();
+		for( auto& t : times )
+			t = ms;
+	}
+
+	// On failure, some of the pipelines may still have been created. Take
+	// ownership of these, such that they are destroyed.
+	std::vector<lut::Pipeline> created;
+	created.reserve( count );
+	for( auto const pipe : pipes )
+		created.emplace_back( mContext->device, pipe );
+
+	if( VK_SUCCESS != res )
+	{
+		throw lut::Error( "Unable to create %zu graphics pipelines\n" "vkCreateGraphicsPipelines() returned %s", count, lut::to_string(res).c_str() );
+	}
+
+	if( aTimes )
+		*aTimes = std::move(times);
+
+	return created;
+}
+
+std::vector<PipelineDesc> PipelineRegistry::find_using_shader( std::string const& aPath ) const
+{
+	std::vector<PipelineDesc> ret;
+	for( auto const& entry : mPipelines )
+	{
+		if( entry.first.vertShader == aPath || entry.first.fragShader == aPath )
+			ret.emplace_back( entry.first );
+	}
+
+	return ret;
+}
+
+std::vector<labutils::Pipeline> PipelineRegistry::replace( std::vector<PipelineDesc> const& aDescs, std::vector<labutils::Pipeline>&& aPipelines )
+{
+	assert( aDescs.size() == aPipelines.size() );
+
+	std::vector<lut::Pipeline> ret;
+	ret.reserve( aPipelines.size() );
+
+	for( std::size_t i = 0; i < aDescs.size(); ++i )
+	{
+		// Pipelines that were released in the meantime (e.g., because the
+		// render pass changed) are outdated; return the new one instead.
+		auto const it = mPipelines.find( aDescs[i] );
+		if( mPipelines.end() == it )
+		{
+			ret.emplace_back( std::move(aPipelines[i]) );
+			continue;
+		}
+
+		ret.emplace_back( std::exchange( it->second, std::move(aPipelines[i]) ) );
+	}
+
+	aPipelines.clear();
+	return ret;
+}
+
+std::vector<labutils::Pipeline> PipelineRegistry::release_all()
+{
+	std::vector<lut::Pipeline> ret;
+	ret.reserve( mPipelines.size() );
+
+	for( auto& entry : mPipelines )
+		ret.emplace_back( std::move(entry.second) );
+
+	mPipelines.clear();
+	return ret;
+}
+
+std::size_t PipelineRegistry::size() const noexcept
+{
+	return mPipelines.size();
+}
+
+std::vector<PipelineCreateTime> const& PipelineRegistry::create_times() const noexcept
+{
+	return mCreateTimes;
+}
+
+std::size_t PipelineRegistry::shader_file_loads() const
+{
+	return mShaders.file_loads();
+}
+
+
+void report_pipeline_times( PipelineRegistry const& aRegistry )
+{
+	for( auto const& entry : aRegistry.create_times() )
+	{
+		std::fprintf( stderr, "  %8.2f ms  %s + %s%s", entry.ms, entry.desc.vertShader.c_str(), entry.desc.fragShader.c_str(), BlendMode::alpha == entry.desc.blend ? " (blend)" : "" );
+
+		if( entry.batchSize > 1 )
+			std::fprintf( stderr, " [batch of %u]", entry.batchSize );
+
+		std::fprintf( stderr, "\n" );
+	}
+
+	std::fprintf( stderr, "  (%zu SPIR-V files loaded)\n", aRegistry.shader_file_loads() );
+}
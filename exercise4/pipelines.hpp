@@ -0,0 +1,152 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include <cstddef>
+#include <cstdint>
+
+#include <volk/volk.h>
+
+#include "../labutils/vkobject.hpp"
+#include "../labutils/shader_cache.hpp"
+#include "../labutils/thread_pool.hpp"
+#include "../labutils/vulkan_context.hpp"
+
+// Graphics pipelines for the textured meshes.
+//
+// A PipelineDesc lists the state in which pipelines differ; everything else
+// (vertex layout, dynamic viewport/scissor, ...) is the same for all of them.
+// Descriptions are plain values that can be compared and hashed, so that the
+// registry can create each distinct pipeline only once.
+enum class BlendMode : std::uint8_t
+{
+	none,
+	alpha // src * alpha + dst * (1-alpha)
+};
+
+struct PipelineDesc
+{
+	std::string vertShader; // path to SPIR-V
+	std::string fragShader;
+
+	// Specialization constants of the fragment shader. Element i is the
+	// value (bit pattern of a 32-bit int, uint or float) for constant_id i.
+	std::vector<std::uint32_t> fragConstants;
+
+	BlendMode blend = BlendMode::none;
+
+	bool depthTest = true;
+	bool depthWrite = true;
+	VkCullModeFlags cullMode = VK_CULL_MODE_BACK_BIT;
+
+	VkRenderPass renderPass = VK_NULL_HANDLE;
+	std::uint32_t subpass = 0;
+	VkPipelineLayout layout = VK_NULL_HANDLE;
+
+	// Attachment formats for dynamic rendering (VK_KHR_dynamic_rendering),
+	// used when renderPass is VK_NULL_HANDLE. The depth format may be
+	// VK_FORMAT_UNDEFINED if there is no depth attachment.
+	VkFormat colorFormat = VK_FORMAT_UNDEFINED;
+	VkFormat depthFormat = VK_FORMAT_UNDEFINED;
+};
+
+bool operator== ( PipelineDesc const&, PipelineDesc const& ) noexcept;
+bool operator!= ( PipelineDesc const&, PipelineDesc const& ) noexcept;
+
+struct PipelineDescHash
+{
+	std::size_t operator() ( PipelineDesc const& ) const noexcept;
+};
+
+
+// Time taken to create a pipeline. Pipelines created together in a single
+// vkCreateGraphicsPipelines() call share the time of that call (batchSize > 1).
+struct PipelineCreateTime
+{
+	PipelineDesc desc;
+	double ms;
+	std::uint32_t batchSize;
+};
+
+// Owns all pipelines, keyed by their description.
+//
+// Pipelines can be requested individually with get(), or queued with
+// request() and then created by create_pending(). Shader modules come from a
+// labutils::ShaderModuleCache, so each SPIR-V file is only read again when it
+// has changed on disk.
+//
+// Without a thread pool, create_pending() creates the batch with a single
+// vkCreateGraphicsPipelines() call. With a pool, each pipeline is created by a
+// separate call on one of the workers, and all compile against the shared
+// pipeline cache (which is internally synchronized). In both cases, the call
+// returns once all pipelines are ready.
+class PipelineRegistry final
+{
+	public:
+		explicit PipelineRegistry( labutils::VulkanContext const&, VkPipelineCache = VK_NULL_HANDLE );
+
+		PipelineRegistry( PipelineRegistry const& ) = delete;
+		PipelineRegistry& operator= (PipelineRegistry const&) = delete;
+
+	public:
+		// Returns the pipeline for the description. Creates it (along with
+		// any pending requests) if it does not exist yet.
+		VkPipeline get( PipelineDesc const& );
+
+		// Returns the pipeline or VK_NULL_HANDLE if it has not been created.
+		VkPipeline find( PipelineDesc const& ) const;
+
+		// Queues the creation of a pipeline. Does nothing if the pipeline
+		// already exists or has been requested.
+		void request( PipelineDesc const& );
+
+		// Creates all requested pipelines. Returns the number of pipelines
+		// created.
+		std::size_t create_pending( labutils::ThreadPool* = nullptr );
+
+		// Removes all pipelines from the registry and returns them, e.g., to
+		// defer their destruction while they may still be in use.
+		std::vector<labutils::Pipeline> release_all();
+
+		// Creates pipelines without adding them to the registry. This only
+		// reads state that is fixed at construction, so it may run on another
+		// thread while the registry is in use. aTimes receives the creation
+		// time of each pipeline.
+		std::vector<labutils::Pipeline> build(
+			std::vector<PipelineDesc> const&,
+			labutils::ThreadPool* = nullptr,
+			std::vector<double>* aTimes = nullptr
+		) const;
+
+		// Descriptions of the existing pipelines that use the shader
+		std::vector<PipelineDesc> find_using_shader( std::string const& aSpirvPath ) const;
+
+		// Replaces existing pipelines with ones created by build(). Returns
+		// the replaced pipelines. Pipelines whose description is no longer
+		// in the registry are returned instead of being added.
+		std::vector<labutils::Pipeline> replace( std::vector<PipelineDesc> const&, std::vector<labutils::Pipeline>&& );
+
+		std::size_t size() const noexcept;
+
+		// Creation times of all pipelines, in order of creation
+		std::vector<PipelineCreateTime> const& create_times() const noexcept;
+
+		// Number of times a SPIR-V file was read (see ShaderModuleCache)
+		std::size_t shader_file_loads() const;
+
+	private:
+		labutils::VulkanContext const* mContext;
+		VkPipelineCache mCache;
+
+		mutable labutils::ShaderModuleCache mShaders;
+
+		std::unordered_map<PipelineDesc, labutils::Pipeline, PipelineDescHash> mPipelines;
+		std::vector<PipelineDesc> mPending;
+
+		std::vector<PipelineCreateTime> mCreateTimes;
+};
+
+// Prints the creation times recorded by the registry to stderr.
+void report_pipeline_times( PipelineRegistry const& );
@@ -0,0 +1,107 @@
+#include "render_queue.hpp"
+
+#include <algorithm>
+
+#include <cassert>
+#include <cstring>
+
+namespace
+{
+	constexpr unsigned kRadixBits = 8;
+	constexpr unsigned kRadixPasses = 64 / kRadixBits;
+	constexpr std::size_t kRadixBuckets = std::size_t(1) << kRadixBits;
+
+	constexpr std::uint64_t kDepthMask = (1u << 24) - 1;
+
+	// Quantizes the depth to 24 bits. The bit pattern of a non-negative IEEE
+	// float increases monotonically with its value, so no depth range is
+	// required. The sign bit is always zero and is dropped.
+	inline
+	std::uint64_t depth_bits_( float aDepth )
+	{
+		aDepth = std::max( aDepth, 0.f ); // also maps NaN to zero
+
+		std::uint32_t bits;
+		std::memcpy( &bits, &aDepth, sizeof(float) );
+		return (bits >> 7) & kDepthMask;
+	}
+}
+
+std::uint64_t make_draw_key( DrawLayer aLayer, std::uint32_t aPipeline, std::uint32_t aMaterial, float aViewDepth )
+{
+	assert( aPipeline < kMaxDrawPipelines );
+	assert( aMaterial < kMaxDrawMaterials );
+
+	auto const layer = std::uint64_t(aLayer) << 62;
+	auto const depth = depth_bits_( aViewDepth );
+
+	if( DrawLayer::alpha == aLayer )
+		return layer | ((kDepthMask - depth) << 38) | (std::uint64_t(aPipeline) << 30) | (std::uint64_t(aMaterial) << 16);
+
+	return layer | (std::uint64_t(aPipeline) << 54) | (std::uint64_t(aMaterial) << 40) | (depth << 16);
+}
+
+DrawLayer draw_key_layer( std::uint64_t aKey )
+{
+	return DrawLayer(aKey >> 62);
+}
+std::uint32_t draw_key_pipeline( std::uint64_t aKey )
+{
+	auto const shift = DrawLayer::alpha == draw_key_layer( aKey ) ? 30 : 54;
+	return std::uint32_t(aKey >> shift) & (kMaxDrawPipelines-1);
+}
+std::uint32_t draw_key_material( std::uint64_t aKey )
+{
+	auto const shift = DrawLayer::alpha == draw_key_layer( aKey ) ? 16 : 40;
+	return std::uint32_t(aKey >> shift) & (kMaxDrawMaterials-1);
+}
+
+void sort_queue( RenderQueue& aQueue )
+{
+	auto const count = aQueue.items.size();
+	if( count <= 1 )
+		return;
+
+	aQueue.scratch.resize( count );
+
+	// Histograms for all digits are built in a single pass over the keys
+	std::uint32_t histograms[kRadixPasses][kRadixBuckets]{};
+	for( auto const& item : aQueue.items )
+	{
+		for( unsigned pass = 0; pass < kRadixPasses; ++pass )
+			++histograms[pass][(item.key >> (pass*kRadixBits)) & (kRadixBuckets-1)];
+	}
+
+	DrawItem* src = aQueue.items.data();
+	DrawItem* dst = aQueue.scratch.data();
+
+	auto const firstKey = src[0].key;
+	for( unsigned pass = 0; pass < kRadixPasses; ++pass )
+	{
+		auto const shift = pass*kRadixBits;
+		auto& histogram = histograms[pass];
+
+		// All keys share this digit; the pass would not change the order.
+		if( count == histogram[(firstKey >> shift) & (kRadixBuckets-1)] )
+			continue;
+
+		std::uint32_t offset = 0;
+		for( auto& bucket : histogram )
+		{
+			auto const size = bucket;
+			bucket = offset;
+			offset += size;
+		}
+
+		for( std::size_t i = 0; i < count; ++i )
+		{
+			auto const digit = (src[i].key >> shift) & (kRadixBuckets-1);
+			dst[histogram[digit]++] = src[i];
+		}
+
+		std::swap( src, dst );
+	}
+
+	if( src != aQueue.items.data() )
+		std::swap( aQueue.items, aQueue.scratch );
+}
@@ -0,0 +1,49 @@
+#include "render_queue.hpp"
+
+#include <random>
+#include <algorithm>
+
+#include <cstdio>
+
+#include "bench.hpp"
+
+void run_queue_benchmark( std::uint32_t aDrawCount )
+{
+	// A mix of opaque and blended draws over a handful of pipelines and a
+	// few hundred materials, at random depths.
+	std::mt19937 rng( 5822 );
+	std::uniform_int_distribution<std::uint32_t> pipeline( 0, 7 );
+	std::uniform_int_distribution<std::uint32_t> material( 0, 511 );
+	std::uniform_real_distribution<float> depth( 0.1f, 100.f );
+	std::bernoulli_distribution blended( 0.2 );
+
+	RenderQueue source;
+	for( std::uint32_t i = 0; i < aDrawCount; ++i )
+	{
+		auto const layer = blended(rng) ? DrawLayer::alpha : DrawLayer::opaque;
+		push_draw( source, make_draw_key( layer, pipeline(rng), material(rng), depth(rng) ), i );
+	}
+
+	RenderQueue radix, reference;
+	radix.items.reserve( aDrawCount );
+	reference.items.reserve( aDrawCount );
+
+	auto const stdMs = time_median_ms( [&] {
+		reference.items = source.items;
+		std::stable_sort( reference.items.begin(), reference.items.end(), [] (DrawItem const& aX, DrawItem const& aY) { return aX.key < aY.key; } );
+	} );
+	auto const radixMs = time_median_ms( [&] {
+		radix.items = source.items;
+		sort_queue( radix );
+	} );
+
+	std::printf( "Sorting %u draws, median of %d runs (including a copy of the queue):\n", aDrawCount, kBenchRepeats );
+	std::printf( "  std::stable_sort : %8.3f ms\n", stdMs );
+	std::printf( "  LSD radix sort   : %8.3f ms (%.1fx)\n", radixMs, stdMs / radixMs );
+
+	bool const same = std::equal( radix.items.begin(), radix.items.end(), reference.items.begin(), reference.items.end(), [] (DrawItem const& aX, DrawItem const& aY) {
+		return aX.key == aY.key && aX.object == aY.object;
+	} );
+	if( !same )
+		std::printf( "Warning: results differ\n" );
+}
@@ -0,0 +1,233 @@
+#include "scene_graph.hpp"
+
+#include <algorithm>
+
+#include <cassert>
+#include <cstring>
+
+#include "../labutils/error.hpp"
+#include "../labutils/to_string.hpp"
+namespace lut = labutils;
+
+namespace
+{
+	// Work items handed to the worker threads cover at most this many nodes.
+	// Smaller dirty subtrees are updated as a whole on a single thread.
+	constexpr std::uint32_t kUpdateGrain = 4096;
+
+	void update_range_( SceneGraph&, glm::mat4* aOut, std::uint32_t aBegin, std::uint32_t aEnd );
+
+	void split_subtree_( SceneGraph&, glm::mat4* aOut, NodeRange aSubtree, std::vector<NodeRange>& aItems );
+}
+
+std::uint32_t add_node( SceneGraph& aGraph, std::int32_t aParent, glm::mat4 const& aLocal )
+{
+	auto const index = std::uint32_t(aGraph.parent.size());
+
+	// Depth-first order: the new node must directly follow the current
+	// subtree of its parent.
+	assert( aParent < std::int32_t(index) );
+	assert( aParent < 0 || aParent + aGraph.subtreeSize[aParent] == index );
+
+	aGraph.parent.emplace_back( aParent );
+	aGraph.subtreeSize.emplace_back( 1 );
+	aGraph.local.emplace_back( aLocal );
+	aGraph.world.emplace_back( 1.f );
+	aGraph.dirty.emplace_back( 1 );
+	aGraph.dirtyNodes.emplace_back( index );
+
+	for( auto ancestor = aParent; ancestor >= 0; ancestor = aGraph.parent[ancestor] )
+		++aGraph.subtreeSize[ancestor];
+
+	return index;
+}
+
+void set_local_transform( SceneGraph& aGraph, std::uint32_t aNode, glm::mat4 const& aLocal )
+{
+	assert( aNode < aGraph.local.size() );
+	aGraph.local[aNode] = aLocal;
+
+	if( !aGraph.dirty[aNode] )
+	{
+		aGraph.dirty[aNode] = 1;
+		aGraph.dirtyNodes.emplace_back( aNode );
+	}
+}
+
+
+TransformRing create_transform_ring( lut::Allocator const& aAllocator, std::uint32_t aSlotCount, std::uint32_t aCapacity )
+{
+	assert( aSlotCount > 0 && aCapacity > 0 );
+
+	VkBufferCreateInfo bufferInfo{};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.size = VkDeviceSize(aSlotCount) * aCapacity * sizeof(glm::mat4);
+	bufferInfo.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+
+	// Persistently mapped; VMA unmaps the memory when the buffer is destroyed.
+	VmaAllocationCreateInfo allocInfo{};
+	allocInfo.usage = VMA_MEMORY_USAGE_CPU_TO_GPU;
+	allocInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+
+	VkBuffer buffer = VK_NULL_HANDLE;
+	VmaAllocation allocation = VK_NULL_HANDLE;
+	VmaAllocationInfo allocResult{};
+
+	if( auto const res = vmaCreateBuffer( aAllocator.allocator, &bufferInfo, &allocInfo, &buffer, &allocation, &allocResult ); VK_SUCCESS != res )
+	{
+		throw lut::Error( "Unable to allocate transform ring\n" "vmaCreateBuffer() returned %s", lut::to_string(res).c_str() );
+	}
+
+	TransformRing ret;
+	ret.buffer = lut::Buffer( aAllocator.allocator, buffer, allocation );
+	lut::set_memory_category( aAllocator, allocation, lut::MemoryCategory::geometry );
+	ret.mapped = static_cast<glm::mat4*>(allocResult.pMappedData);
+	ret.slotCount = aSlotCount;
+	ret.capacity = aCapacity;
+	ret.stale.resize( aSlotCount );
+	ret.allocator = aAllocator.allocator;
+
+	return ret;
+}
+
+VkDeviceSize transform_ring_offset( TransformRing const& aRing, std::uint32_t aSlot )
+{
+	assert( aSlot < aRing.slotCount );
+	return VkDeviceSize(aSlot) * aRing.capacity * sizeof(glm::mat4);
+}
+
+std::size_t update_transforms( SceneGraph& aGraph, TransformRing& aRing, std::uint32_t aSlot, lut::ThreadPool* aPool )
+{
+	assert( aSlot < aRing.slotCount );
+	assert( aGraph.local.size() <= aRing.capacity );
+
+	glm::mat4* const out = aRing.mapped + std::size_t(aSlot) * aRing.capacity;
+
+	// Bring the slot up to date with the changes that were made while it was
+	// in flight.
+	auto& stale = aRing.stale[aSlot];
+	bool const hadStale = !stale.empty();
+	for( auto const& range : stale )
+		std::memcpy( out + range.begin, aGraph.world.data() + range.begin, (range.end - range.begin) * sizeof(glm::mat4) );
+
+	stale.clear();
+
+	// Determine the roots of the dirty subtrees. After sorting, any dirty
+	// node that falls into the range of an earlier root is part of that
+	// subtree already.
+	auto& roots = aGraph.updated;
+	roots.clear();
+
+	std::sort( aGraph.dirtyNodes.begin(), aGraph.dirtyNodes.end() );
+
+	std::uint32_t coveredEnd = 0;
+	for( auto const node : aGraph.dirtyNodes )
+	{
+		aGraph.dirty[node] = 0;
+
+		if( node < coveredEnd )
+			continue;
+
+		coveredEnd = node + aGraph.subtreeSize[node];
+		roots.emplace_back( NodeRange{ node, coveredEnd } );
+	}
+
+	aGraph.dirtyNodes.clear();
+
+	std::size_t updatedCount = 0;
+	if( !roots.empty() )
+	{
+		// Split the dirty subtrees into independent work items. The storage
+		// is kept between frames; the parallel_for() lambda below reads the
+		// items through `items`, not through the thread_local itself.
+		thread_local std::vector<NodeRange> itemStorage;
+		auto& items = itemStorage;
+		items.clear();
+
+		for( auto const& root : roots )
+		{
+			split_subtree_( aGraph, out, root, items );
+			updatedCount += root.end - root.begin;
+		}
+
+		if( aPool && items.size() > 1 )
+		{
+			aPool->parallel_for( items.size(), 1, [&] ( std::size_t aBeg, std::size_t aEnd ) {
+				for( auto i = aBeg; i < aEnd; ++i )
+					update_range_( aGraph, out, items[i].begin, items[i].end );
+			} );
+		}
+		else
+		{
+			for( auto const& item : items )
+				update_range_( aGraph, out, item.begin, item.end );
+		}
+
+		// The other slots missed these changes
+		for( std::uint32_t i = 0; i < aRing.slotCount; ++i )
+		{
+			if( i != aSlot )
+				aRing.stale[i].insert( aRing.stale[i].end(), roots.begin(), roots.end() );
+		}
+	}
+
+	if( hadStale || !roots.empty() )
+	{
+		// No-op if the memory is HOST_COHERENT.
+		vmaFlushAllocation( aRing.allocator, aRing.buffer.allocation, transform_ring_offset( aRing, aSlot ), VkDeviceSize(aRing.capacity) * sizeof(glm::mat4) );
+	}
+
+	return updatedCount;
+}
+
+namespace
+{
+	void update_range_( SceneGraph& aGraph, glm::mat4* aOut, std::uint32_t aBegin, std::uint32_t aEnd )
+	{
+		// Parents precede their children, so the parent's world transform is
+		// either outside of the range (and up to date) or was just computed.
+		for( auto i = aBegin; i < aEnd; ++i )
+		{
+			auto const parent = aGraph.parent[i];
+
+			aGraph.world[i] = parent < 0 ? aGraph.local[i] : aGraph.world[parent] * aGraph.local[i];
+			aOut[i] = aGraph.world[i];
+		}
+	}
+
+	void split_subtree_( SceneGraph& aGraph, glm::mat4* aOut, NodeRange aSubtree, std::vector<NodeRange>& aItems )
+	{
+		// Large subtrees are split at their root: the root is updated right
+		// away, after which its child subtrees are independent of each other.
+		// Small neighbouring subtrees are merged into one work item. Uses an
+		// explicit stack, as hierarchies can be arbitrarily deep.
+		thread_local std::vector<NodeRange> stack, children;
+		stack.clear();
+		stack.emplace_back( aSubtree );
+
+		while( !stack.empty() )
+		{
+			auto const range = stack.back();
+			stack.pop_back();
+
+			if( range.end - range.begin <= kUpdateGrain )
+			{
+				if( !aItems.empty() && aItems.back().end == range.begin && range.end - aItems.back().begin <= kUpdateGrain )
+					aItems.back().end = range.end;
+				else
+					aItems.emplace_back( range );
+
+				continue;
+			}
+
+			update_range_( aGraph, aOut, range.begin, range.begin+1 );
+
+			children.clear();
+			for( auto child = range.begin+1; child < range.end; child += aGraph.subtreeSize[child] )
+				children.emplace_back( NodeRange{ child, child + aGraph.subtreeSize[child] } );
+
+			// Reversed, such that the items come out in ascending order
+			stack.insert( stack.end(), children.rbegin(), children.rend() );
+		}
+	}
+}
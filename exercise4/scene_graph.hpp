@@ -0,0 +1,80 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#include <volk/volk.h>
+
+#if !defined(GLM_FORCE_RADIANS)
+#	define GLM_FORCE_RADIANS
+#endif
+#include <glm/glm.hpp>
+
+#include "../labutils/vkbuffer.hpp"
+#include "../labutils/allocator.hpp"
+#include "../labutils/thread_pool.hpp"
+
+// Hierarchical transforms. Nodes are stored in depth-first (parent-before-
+// child) order in contiguous arrays. As a consequence, the subtree of node i
+// occupies the index range [i, i+subtreeSize[i]), and a node's world
+// transform can be computed as soon as all nodes before it are up to date.
+//
+// Changing a node's local transform marks its subtree as dirty. Only dirty
+// subtrees are recomputed by update_transforms(); a static scene costs
+// nothing beyond looking at an empty list.
+struct NodeRange
+{
+	std::uint32_t begin, end;
+};
+
+struct SceneGraph
+{
+	std::vector<std::int32_t> parent; // -1 for root nodes
+	std::vector<std::uint32_t> subtreeSize; // includes the node itself
+
+	std::vector<glm::mat4> local;
+	std::vector<glm::mat4> world;
+
+	std::vector<std::uint8_t> dirty;
+	std::vector<std::uint32_t> dirtyNodes; // nodes with dirty != 0
+
+	// Ranges that were recomputed by the last update_transforms() call
+	std::vector<NodeRange> updated;
+};
+
+// Appends a node. Nodes must be added in depth-first order: aParent must be
+// -1 or the most recently added node or one of its ancestors.
+std::uint32_t add_node( SceneGraph&, std::int32_t aParent, glm::mat4 const& aLocal = glm::mat4( 1.f ) );
+
+void set_local_transform( SceneGraph&, std::uint32_t aNode, glm::mat4 const& );
+
+
+// Per-frame copies of the world matrices, in persistently mapped host-visible
+// memory. The buffer holds one slot of aCapacity matrices per frame in
+// flight; slot i starts at byte offset i * aCapacity * sizeof(glm::mat4).
+// The matrices are read as per-instance vertex data, with the node index as
+// the instance index.
+struct TransformRing
+{
+	labutils::Buffer buffer;
+	glm::mat4* mapped = nullptr;
+
+	VmaAllocator allocator = VK_NULL_HANDLE;
+
+	std::uint32_t slotCount = 0;
+	std::uint32_t capacity = 0;
+
+	// Ranges that were updated while a slot was not current. These are
+	// copied to the slot the next time it is used.
+	std::vector<std::vector<NodeRange>> stale;
+};
+
+TransformRing create_transform_ring( labutils::Allocator const&, std::uint32_t aSlotCount, std::uint32_t aCapacity );
+
+VkDeviceSize transform_ring_offset( TransformRing const&, std::uint32_t aSlot );
+
+// Recomputes the world transforms of all dirty subtrees and writes them to
+// slot aSlot of the ring (which must no longer be in use by the GPU). Large
+// or many dirty subtrees are processed in parallel when a pool is given.
+// Returns the number of nodes whose world transform was recomputed.
+std::size_t update_transforms( SceneGraph&, TransformRing&, std::uint32_t aSlot, labutils::ThreadPool* = nullptr );
@@ -0,0 +1,211 @@
+#include "shader_reload.hpp"
+
+#include <system_error>
+
+#include <cstdio>
+#include <cassert>
+
+#include "../labutils/error.hpp"
+namespace lut = labutils;
+
+namespace fs = std::filesystem;
+
+#if defined(_WIN32)
+#	define popen_ _popen
+#	define pclose_ _pclose
+#else
+#	define popen_ popen
+#	define pclose_ pclose
+#endif
+
+namespace
+{
+	// Sources are checked at most this often
+	constexpr auto kPollInterval = std::chrono::milliseconds( 250 );
+
+	// Runs the command and captures its output (stdout and stderr). Returns
+	// the exit status.
+	int run_( std::string const& aCommand, std::string& aOutput )
+	{
+		std::FILE* pipe = popen_( (aCommand + " 2>&1").c_str(), "r" );
+		if( !pipe )
+		{
+			aOutput = "unable to start '" + aCommand + "'";
+			return -1;
+		}
+
+		char buffer[256];
+		while( std::fgets( buffer, sizeof(buffer), pipe ) )
+			aOutput += buffer;
+
+		return pclose_( pipe );
+	}
+}
+
+ShaderReloader::ShaderReloader( std::string aGlslc, std::string aSourceDir, std::string aSpirvDir )
+	: mGlslc( std::move(aGlslc) )
+	, mSourceDir( std::move(aSourceDir) )
+	, mSpirvDir( std::move(aSpirvDir) )
+	, mLastPoll( std::chrono::steady_clock::now() )
+{
+	// Record the current state; only later changes trigger a reload
+	std::error_code ec;
+	for( auto const& entry : fs::directory_iterator( mSourceDir, ec ) )
+	{
+		auto const ext = entry.path().extension();
+		if( ".vert" != ext && ".frag" != ext )
+			continue;
+
+		Source_ source;
+		source.glsl = entry.path().string();
+		source.spirv = mSpirvDir + "/" + entry.path().filename().string() + ".spv";
+		source.modified = fs::last_write_time( entry.path(), ec );
+		mSources.emplace_back( std::move(source) );
+	}
+
+	if( ec )
+		throw lut::Error( "Unable to list shader sources in '%s': %s", mSourceDir.c_str(), ec.message().c_str() );
+
+	std::fprintf( stderr, "Watching %zu shaders in '%s'\n", mSources.size(), mSourceDir.c_str() );
+}
+
+ShaderReloader::~ShaderReloader()
+{
+	// Jobs reference this object
+	for( auto& job : mJobs )
+		job.wait();
+}
+
+void ShaderReloader::poll( PipelineRegistry const& aRegistry, labutils::ThreadPool& aPool )
+{
+	auto const now = std::chrono::steady_clock::now();
+	if( now - mLastPoll < kPollInterval )
+		return;
+
+	mLastPoll = now;
+
+	// Forget about finished jobs
+	for( std::size_t i = 0; i < mJobs.size(); )
+	{
+		if( std::future_status::ready == mJobs[i].wait_for( std::chrono::seconds(0) ) )
+		{
+			mJobs[i].get();
+			mJobs[i] = std::move(mJobs.back());
+			mJobs.pop_back();
+		}
+		else
+			++i;
+	}
+
+	for( std::size_t i = 0; i < mSources.size(); ++i )
+	{
+		auto& source = mSources[i];
+
+		std::error_code ec;
+		auto const modified = fs::last_write_time( source.glsl, ec );
+		if( ec || modified == source.modified )
+			continue;
+
+		// A source that is being compiled is picked up again once its job has
+		// finished (its time stamp has not been updated yet).
+		{
+			std::lock_guard<std::mutex> lock( mMutex );
+			if( source.busy )
+				continue;
+
+			source.busy = true;
+		}
+
+		source.modified = modified;
+
+		// Pipelines are captured now; pipelines created later reference the
+		// new SPIR-V anyway.
+		auto descs = aRegistry.find_using_shader( source.spirv );
+
+		mJobs.emplace_back( aPool.submit( [this, &aRegistry, i, descs = std::move(descs)] () mutable {
+			job_( aRegistry, i, std::move(descs) );
+		} ) );
+	}
+}
+
+std::vector<labutils::Pipeline> ShaderReloader::apply( PipelineRegistry& aRegistry )
+{
+	std::vector<Result_> results;
+	{
+		std::lock_guard<std::mutex> lock( mMutex );
+		results.swap( mResults );
+	}
+
+	std::vector<lut::Pipeline> ret;
+	for( auto& result : results )
+	{
+		auto replaced = aRegistry.replace( result.descs, std::move(result.pipelines) );
+		for( auto& pipe : replaced )
+			ret.emplace_back( std::move(pipe) );
+	}
+
+	return ret;
+}
+
+void ShaderReloader::job_( PipelineRegistry const& aRegistry, std::size_t aSource, std::vector<PipelineDesc> aDescs )
+{
+	using Clock_ = std::chrono::steady_clock;
+	using Ms_ = std::chrono::duration<double,std::milli>;
+
+	auto const& source = mSources[aSource];
+	auto const start = Clock_::now();
+
+	// Compile to a temporary file, such that the existing SPIR-V is only
+	// replaced if compilation succeeds.
+	std::string const temp = source.spirv + ".tmp";
+	std::string const command = mGlslc + " -O -o \"" + temp + "\" \"" + source.glsl + "\"";
+
+	std::string output;
+	bool ok = 0 == run_( command, output );
+
+	if( !ok )
+	{
+		std::fprintf( stderr, "Shader reload: compiling '%s' failed; keeping the old version\n%s", source.glsl.c_str(), output.c_str() );
+	}
+	else
+	{
+		std::error_code ec;
+		fs::rename( temp, source.spirv, ec );
+		if( ec )
+		{
+			std::fprintf( stderr, "Shader reload: unable to replace '%s': %s\n", source.spirv.c_str(), ec.message().c_str() );
+			ok = false;
+		}
+	}
+
+	auto const compiled = Clock_::now();
+
+	Result_ result;
+	result.source = aSource;
+
+	if( ok && !aDescs.empty() )
+	{
+		try
+		{
+			result.pipelines = aRegistry.build( aDescs );
+			result.descs = std::move(aDescs);
+		}
+		catch( std::exception const& eErr )
+		{
+			std::fprintf( stderr, "Shader reload: unable to rebuild pipelines for '%s'; keeping the old ones\n%s\n", source.glsl.c_str(), eErr.what() );
+			ok = false;
+		}
+	}
+
+	if( ok )
+	{
+		auto const done = Clock_::now();
+		std::fprintf( stderr, "Shader reload: '%s' compiled in %.1f ms, %zu pipelines rebuilt in %.1f ms\n", source.glsl.c_str(), Ms_( compiled - start ).count(), result.pipelines.size(), Ms_( done - compiled ).count() );
+	}
+
+	std::lock_guard<std::mutex> lock( mMutex );
+	mSources[aSource].busy = false;
+
+	if( ok )
+		mResults.emplace_back( std::move(result) );
+}
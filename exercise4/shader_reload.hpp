@@ -0,0 +1,77 @@
+#pragma once
+
+#include <mutex>
+#include <string>
+#include <vector>
+#include <future>
+#include <chrono>
+#include <filesystem>
+
+#include "../labutils/vkobject.hpp"
+#include "../labutils/thread_pool.hpp"
+
+#include "pipelines.hpp"
+
+// Development aid: recompiles shaders when their sources change and rebuilds
+// the pipelines that use them.
+//
+// poll() checks the modification times of the GLSL sources. For each modified
+// source, a job on the thread pool runs glslc (writing to a temporary file
+// that then replaces the SPIR-V) and builds new versions of the affected
+// pipelines. apply() moves finished pipelines into the registry; it should be
+// called between frames, such that a frame never mixes old and new versions.
+//
+// If glslc or pipeline creation fails, the error is printed and the old
+// pipelines remain in use.
+class ShaderReloader final
+{
+	public:
+		ShaderReloader(
+			std::string aGlslc,
+			std::string aSourceDir,
+			std::string aSpirvDir
+		);
+		~ShaderReloader();
+
+		ShaderReloader( ShaderReloader const& ) = delete;
+		ShaderReloader& operator= (ShaderReloader const&) = delete;
+
+	public:
+		// Starts jobs for sources modified since the last call. The registry
+		// must outlive the jobs, i.e., the ShaderReloader.
+		void poll( PipelineRegistry const&, labutils::ThreadPool& );
+
+		// Swaps finished pipelines into the registry. Returns the replaced
+		// pipelines, which may still be in use by frames in flight.
+		std::vector<labutils::Pipeline> apply( PipelineRegistry& );
+
+	private:
+		struct Source_
+		{
+			std::string glsl;
+			std::string spirv;
+			std::filesystem::file_time_type modified;
+			bool busy = false;
+		};
+
+		struct Result_
+		{
+			std::size_t source;
+			std::vector<PipelineDesc> descs;
+			std::vector<labutils::Pipeline> pipelines;
+		};
+
+		void job_( PipelineRegistry const&, std::size_t aSource, std::vector<PipelineDesc> );
+
+	private:
+		std::string mGlslc;
+		std::string mSourceDir, mSpirvDir;
+
+		std::vector<Source_> mSources;
+		std::chrono::steady_clock::time_point mLastPoll;
+
+		std::vector<std::future<void>> mJobs;
+
+		std::mutex mMutex; // protects mResults and the busy flags
+		std::vector<Result_> mResults;
+};
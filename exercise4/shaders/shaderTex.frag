@@ -1,5 +1,13 @@
 #version 450 
 
+// Alpha handling, selected when the pipeline is created:
+//   0 = opaque (alpha is ignored)
+//   1 = blend (alpha is written for blending)
+//   2 = test (fragments with alpha below kAlphaCutoff are discarded)
+// The compiler removes the branches that a variant does not take.
+layout( constant_id = 0 ) const uint kAlphaMode = 0u;
+layout( constant_id = 1 ) const float kAlphaCutoff = 0.5;
+
 layout( location = 0 ) in vec2 v2fTexCoord;
 
 layout( set = 1, binding = 0 ) uniform sampler2D uTexColor;
@@ -8,5 +16,10 @@ layout( location = 0 ) out vec4 oColor;
 
 void main() 
 { 
-	oColor = vec4( texture( uTexColor, v2fTexCoord ).rgb, 1.f );
-} 
\ No newline at end of file
+	vec4 color = texture( uTexColor, v2fTexCoord ).rgba;
+
+	if( 2u == kAlphaMode && color.a < kAlphaCutoff )
+		discard;
+
+	oColor = (1u == kAlphaMode) ? color : vec4( color.rgb, 1.f );
+} 
@@ -3,6 +3,9 @@
 layout( location = 0 ) in vec3 iPosition; 
 layout( location = 1 ) in vec2 iTexCoord; 
 
+// Per-instance: world transform of the object (occupies locations 2-5)
+layout( location = 2 ) in mat4 iModel;
+
 layout( set = 0, binding = 0 ) uniform UScene 
 { 
 	mat4 camera; 
@@ -15,5 +18,5 @@ layout( location = 0 ) out vec2 v2fTexCoord;
 void main() 
 { 
 	v2fTexCoord = iTexCoord;
-	gl_Position = uScene.projCam * vec4( iPosition, 1.f ); 
+	gl_Position = uScene.projCam * iModel * vec4( iPosition, 1.f ); 
 } 
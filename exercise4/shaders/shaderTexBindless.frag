@@ -0,0 +1,33 @@
+#version 450 
+#extension GL_EXT_nonuniform_qualifier : require
+
+// Variant of shaderTex.frag for bindless textures (--bindless). The texture
+// is selected from a single large array by an index that is pushed per draw.
+// The extension allows the runtime-sized array. See bindless.hpp.
+
+// Alpha handling; as in shaderTex.frag
+layout( constant_id = 0 ) const uint kAlphaMode = 0u;
+layout( constant_id = 1 ) const float kAlphaCutoff = 0.5;
+
+layout( location = 0 ) in vec2 v2fTexCoord;
+
+layout( set = 1, binding = 0 ) uniform sampler2D uTextures[];
+
+layout( push_constant ) uniform Material
+{
+	uint textureIndex;
+} uMaterial;
+
+layout( location = 0 ) out vec4 oColor; 
+
+void main() 
+{ 
+	// The index is the same for the whole draw (dynamically uniform), so
+	// nonuniformEXT is not needed.
+	vec4 color = texture( uTextures[uMaterial.textureIndex], v2fTexCoord ).rgba;
+
+	if( 2u == kAlphaMode && color.a < kAlphaCutoff )
+		discard;
+
+	oColor = (1u == kAlphaMode) ? color : vec4( color.rgb, 1.f );
+} 
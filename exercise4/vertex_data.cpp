@@ -171,14 +171,14 @@ TexturedMesh create_plane_mesh(labutils::VulkanContext const& aContext, labutils
 	lut::Buffer vertexPosGPU = lut::create_buffer(
 		aAllocator,
 		sizeof(positions),
-		VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		kTexturedMeshUsage,
 		VMA_MEMORY_USAGE_GPU_ONLY
 	);
 
 	lut::Buffer vertexColGPU = lut::create_buffer(
 		aAllocator,
 		sizeof(texcoord),
-		VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		kTexturedMeshUsage,
 		VMA_MEMORY_USAGE_GPU_ONLY
 	);
 
@@ -317,14 +317,14 @@ TexturedMesh create_sprite_mesh(labutils::VulkanContext const& aContext, labutil
 	lut::Buffer vertexPosGPU = lut::create_buffer(
 		aAllocator,
 		sizeof(positions),
-		VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		kTexturedMeshUsage,
 		VMA_MEMORY_USAGE_GPU_ONLY
 	);
 
 	lut::Buffer vertexColGPU = lut::create_buffer(
 		aAllocator,
 		sizeof(texcoord),
-		VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		kTexturedMeshUsage,
 		VMA_MEMORY_USAGE_GPU_ONLY
 	);
 
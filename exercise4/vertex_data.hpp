@@ -23,6 +23,10 @@ struct TexturedMesh
 	std::uint32_t vertexCount; 
 };
 
+// Usage of the vertex buffers of TexturedMesh. They may be copied elsewhere
+// (see labutils::Defragmenter); positions are vec3, texcoords vec2.
+constexpr VkBufferUsageFlags kTexturedMeshUsage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+
 
 ColorizedMesh create_triangle_mesh( labutils::VulkanContext const&, labutils::Allocator const& );
 TexturedMesh create_plane_mesh(labutils::VulkanContext const&, labutils::Allocator const&);
@@ -21,14 +21,17 @@ namespace labutils
 
 	Allocator::Allocator( VmaAllocator aAllocator ) noexcept
 		: allocator( aAllocator )
+		, categories( new (std::nothrow) MemoryCategoryCounter[kMemoryCategoryCount] )
 	{}
 
 	Allocator::Allocator( Allocator&& aOther ) noexcept
 		: allocator( std::exchange( aOther.allocator, VK_NULL_HANDLE ) )
+		, categories( std::move(aOther.categories) )
 	{}
 	Allocator& Allocator::operator=( Allocator&& aOther ) noexcept
 	{
 		std::swap( allocator, aOther.allocator );
+		std::swap( categories, aOther.categories );
 		return *this;
 	}
 }
@@ -45,6 +48,7 @@ namespace labutils
 		functions.vkGetDeviceProcAddr     = vkGetDeviceProcAddr;
 
 		VmaAllocatorCreateInfo allocInfo{};
+		allocInfo.flags             = aContext.haveMemoryBudget ? VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT : 0;
 		allocInfo.vulkanApiVersion  = props.apiVersion;
 		allocInfo.physicalDevice    = aContext.physicalDevice;
 		allocInfo.device            = aContext.device;
@@ -63,3 +67,53 @@ namespace labutils
 	}
 }
 
+namespace labutils
+{
+	char const* to_string( MemoryCategory aCategory )
+	{
+		switch( aCategory )
+		{
+			case MemoryCategory::other: return "other";
+			case MemoryCategory::texture: return "texture";
+			case MemoryCategory::geometry: return "geometry";
+			case MemoryCategory::staging: return "staging";
+			case MemoryCategory::attachment: return "attachment";
+		}
+
+		return "unknown";
+	}
+
+	void set_memory_category( Allocator const& aAllocator, VmaAllocation aAllocation, MemoryCategory aCategory )
+	{
+		assert( std::size_t(aCategory) < kMemoryCategoryCount );
+
+		if( !aAllocator.categories )
+			return;
+
+		// Moving the allocation to a different category
+		release_memory_category( aAllocator.allocator, aAllocation );
+
+		VmaAllocationInfo info;
+		vmaGetAllocationInfo( aAllocator.allocator, aAllocation, &info );
+
+		auto& counter = aAllocator.categories[std::size_t(aCategory)];
+		counter.bytes += info.size;
+		++counter.allocations;
+
+		vmaSetAllocationUserData( aAllocator.allocator, aAllocation, &counter );
+	}
+
+	void release_memory_category( VmaAllocator aAllocator, VmaAllocation aAllocation ) noexcept
+	{
+		VmaAllocationInfo info;
+		vmaGetAllocationInfo( aAllocator, aAllocation, &info );
+
+		if( auto const counter = static_cast<MemoryCategoryCounter*>(info.pUserData) )
+		{
+			counter->bytes -= info.size;
+			--counter->allocations;
+
+			vmaSetAllocationUserData( aAllocator, aAllocation, nullptr );
+		}
+	}
+}
@@ -3,14 +3,38 @@
 #include <volk/volk.h>
 #include <vk_mem_alloc.h>
 
+#include <atomic>
+#include <memory>
 #include <utility>
 
 #include <cassert>
+#include <cstdint>
+#include <cstddef>
 
 #include "vulkan_context.hpp"
 
 namespace labutils
 {
+	// Resource categories for memory statistics (see memory_stats.hpp)
+	enum class MemoryCategory : std::uint32_t
+	{
+		other,
+		texture,
+		geometry,    // vertex, index and instance data
+		staging,     // uploads and readbacks
+		attachment   // render targets and depth buffers
+	};
+
+	constexpr std::size_t kMemoryCategoryCount = 5;
+
+	char const* to_string( MemoryCategory );
+
+	struct MemoryCategoryCounter
+	{
+		std::atomic<std::uint64_t> bytes{ 0 };
+		std::atomic<std::uint32_t> allocations{ 0 };
+	};
+
 	class Allocator
 	{
 		public:
@@ -26,7 +50,17 @@ namespace labutils
 
 		public:
 			VmaAllocator allocator = VK_NULL_HANDLE;
+
+			// Usage per MemoryCategory, indexed by the category
+			std::unique_ptr<MemoryCategoryCounter[]> categories;
 	};
 
 	Allocator create_allocator( VulkanContext const& );
+
+	// Counts the allocation under aCategory. The allocation's user data
+	// points to the counter; release_memory_category() removes the
+	// allocation from the count again. Buffer and Image do so when they are
+	// destroyed.
+	void set_memory_category( Allocator const&, VmaAllocation, MemoryCategory );
+	void release_memory_category( VmaAllocator, VmaAllocation ) noexcept;
 }
@@ -0,0 +1,198 @@
+#include "barrier_batch.hpp"
+
+#include <atomic>
+
+#include <cassert>
+
+namespace labutils
+{
+	namespace
+	{
+		std::atomic<std::uint64_t> gCalls_{ 0 };
+		std::atomic<std::uint64_t> gMemoryBarriers_{ 0 };
+		std::atomic<std::uint64_t> gBufferBarriers_{ 0 };
+		std::atomic<std::uint64_t> gImageBarriers_{ 0 };
+	}
+
+	BarrierCounters barrier_counters() noexcept
+	{
+		BarrierCounters ret;
+		ret.calls = gCalls_.load( std::memory_order_relaxed );
+		ret.memoryBarriers = gMemoryBarriers_.load( std::memory_order_relaxed );
+		ret.bufferBarriers = gBufferBarriers_.load( std::memory_order_relaxed );
+		ret.imageBarriers = gImageBarriers_.load( std::memory_order_relaxed );
+		return ret;
+	}
+}
+
+namespace labutils
+{
+	BarrierBatch::BarrierBatch( VulkanContext const& aContext )
+		: mSync2( aContext.haveSynchronization2 )
+	{}
+
+	BarrierBatch& BarrierBatch::memory( VkAccessFlags aSrcAccessMask, VkAccessFlags aDstAccessMask, VkPipelineStageFlags aSrcStageMask, VkPipelineStageFlags aDstStageMask )
+	{
+		VkMemoryBarrier2KHR mb{};
+		mb.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2_KHR;
+		mb.srcStageMask = aSrcStageMask;
+		mb.srcAccessMask = aSrcAccessMask;
+		mb.dstStageMask = aDstStageMask;
+		mb.dstAccessMask = aDstAccessMask;
+		mMemory.emplace_back( mb );
+		return *this;
+	}
+
+	BarrierBatch& BarrierBatch::buffer( VkBuffer aBuffer, VkAccessFlags aSrcAccessMask, VkAccessFlags aDstAccessMask, VkPipelineStageFlags aSrcStageMask, VkPipelineStageFlags aDstStageMask, VkDeviceSize aSize, VkDeviceSize aOffset )
+	{
+		assert( VK_NULL_HANDLE != aBuffer );
+
+		VkBufferMemoryBarrier2KHR bb{};
+		bb.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2_KHR;
+		bb.srcStageMask = aSrcStageMask;
+		bb.srcAccessMask = aSrcAccessMask;
+		bb.dstStageMask = aDstStageMask;
+		bb.dstAccessMask = aDstAccessMask;
+		bb.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		bb.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		bb.buffer = aBuffer;
+		bb.offset = aOffset;
+		bb.size = aSize;
+		mBuffers.emplace_back( bb );
+		return *this;
+	}
+
+	BarrierBatch& BarrierBatch::image( VkImage aImage, VkAccessFlags aSrcAccessMask, VkAccessFlags aDstAccessMask, VkImageLayout aSrcLayout, VkImageLayout aDstLayout, VkPipelineStageFlags aSrcStageMask, VkPipelineStageFlags aDstStageMask, VkImageSubresourceRange aRange )
+	{
+		assert( VK_NULL_HANDLE != aImage );
+
+		VkImageMemoryBarrier2KHR ib{};
+		ib.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2_KHR;
+		ib.srcStageMask = aSrcStageMask;
+		ib.srcAccessMask = aSrcAccessMask;
+		ib.dstStageMask = aDstStageMask;
+		ib.dstAccessMask = aDstAccessMask;
+		ib.oldLayout = aSrcLayout;
+		ib.newLayout = aDstLayout;
+		ib.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		ib.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		ib.image = aImage;
+		ib.subresourceRange = aRange;
+		mImages.emplace_back( ib );
+		return *this;
+	}
+
+	bool BarrierBatch::empty() const noexcept
+	{
+		return mMemory.empty() && mBuffers.empty() && mImages.empty();
+	}
+
+	std::uint32_t BarrierBatch::calls() const noexcept
+	{
+		return mCalls;
+	}
+
+	void BarrierBatch::flush( VkCommandBuffer aCmdBuff )
+	{
+		if( empty() )
+			return;
+
+		if( mSync2 )
+		{
+			VkDependencyInfoKHR depInfo{};
+			depInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO_KHR;
+			depInfo.memoryBarrierCount = std::uint32_t(mMemory.size());
+			depInfo.pMemoryBarriers = mMemory.data();
+			depInfo.bufferMemoryBarrierCount = std::uint32_t(mBuffers.size());
+			depInfo.pBufferMemoryBarriers = mBuffers.data();
+			depInfo.imageMemoryBarrierCount = std::uint32_t(mImages.size());
+			depInfo.pImageMemoryBarriers = mImages.data();
+
+			vkCmdPipelineBarrier2KHR( aCmdBuff, &depInfo );
+		}
+		else
+		{
+			VkPipelineStageFlags srcStages = 0, dstStages = 0;
+
+			std::vector<VkMemoryBarrier> memory;
+			memory.reserve( mMemory.size() );
+			for( auto const& mb2 : mMemory )
+			{
+				srcStages |= VkPipelineStageFlags(mb2.srcStageMask);
+				dstStages |= VkPipelineStageFlags(mb2.dstStageMask);
+
+				VkMemoryBarrier mb{};
+				mb.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+				mb.srcAccessMask = VkAccessFlags(mb2.srcAccessMask);
+				mb.dstAccessMask = VkAccessFlags(mb2.dstAccessMask);
+				memory.emplace_back( mb );
+			}
+
+			std::vector<VkBufferMemoryBarrier> buffers;
+			buffers.reserve( mBuffers.size() );
+			for( auto const& bb2 : mBuffers )
+			{
+				srcStages |= VkPipelineStageFlags(bb2.srcStageMask);
+				dstStages |= VkPipelineStageFlags(bb2.dstStageMask);
+
+				VkBufferMemoryBarrier bb{};
+				bb.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+				bb.srcAccessMask = VkAccessFlags(bb2.srcAccessMask);
+				bb.dstAccessMask = VkAccessFlags(bb2.dstAccessMask);
+				bb.srcQueueFamilyIndex = bb2.srcQueueFamilyIndex;
+				bb.dstQueueFamilyIndex = bb2.dstQueueFamilyIndex;
+				bb.buffer = bb2.buffer;
+				bb.offset = bb2.offset;
+				bb.size = bb2.size;
+				buffers.emplace_back( bb );
+			}
+
+			std::vector<VkImageMemoryBarrier> images;
+			images.reserve( mImages.size() );
+			for( auto const& ib2 : mImages )
+			{
+				srcStages |= VkPipelineStageFlags(ib2.srcStageMask);
+				dstStages |= VkPipelineStageFlags(ib2.dstStageMask);
+
+				VkImageMemoryBarrier ib{};
+				ib.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+				ib.srcAccessMask = VkAccessFlags(ib2.srcAccessMask);
+				ib.dstAccessMask = VkAccessFlags(ib2.dstAccessMask);
+				ib.oldLayout = ib2.oldLayout;
+				ib.newLayout = ib2.newLayout;
+				ib.srcQueueFamilyIndex = ib2.srcQueueFamilyIndex;
+				ib.dstQueueFamilyIndex = ib2.dstQueueFamilyIndex;
+				ib.image = ib2.image;
+				ib.subresourceRange = ib2.subresourceRange;
+				images.emplace_back( ib );
+			}
+
+			// Zero stage masks are only allowed with synchronization2
+			if( 0 == srcStages )
+				srcStages = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+			if( 0 == dstStages )
+				dstStages = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+
+			vkCmdPipelineBarrier( aCmdBuff,
+				srcStages, dstStages,
+				0,
+				std::uint32_t(memory.size()), memory.data(),
+				std::uint32_t(buffers.size()), buffers.data(),
+				std::uint32_t(images.size()), images.data()
+			);
+		}
+
+		++mCalls;
+
+		gCalls_.fetch_add( 1, std::memory_order_relaxed );
+		gMemoryBarriers_.fetch_add( mMemory.size(), std::memory_order_relaxed );
+		gBufferBarriers_.fetch_add( mBuffers.size(), std::memory_order_relaxed );
+		gImageBarriers_.fetch_add( mImages.size(), std::memory_order_relaxed );
+
+		mMemory.clear();
+		mBuffers.clear();
+		mImages.clear();
+	}
+}
+
+//EOF vim:syntax=cpp:foldmethod=marker:ts=4:noexpandtab:
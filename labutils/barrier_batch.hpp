@@ -0,0 +1,89 @@
+#pragma once
+
+#include <volk/volk.h>
+
+#include <vector>
+
+#include <cstdint>
+
+#include "vulkan_context.hpp"
+
+namespace labutils
+{
+	// Totals over all BarrierBatch::flush() calls in the process
+	struct BarrierCounters
+	{
+		std::uint64_t calls = 0; // vkCmdPipelineBarrier(2KHR)() calls
+		std::uint64_t memoryBarriers = 0;
+		std::uint64_t bufferBarriers = 0;
+		std::uint64_t imageBarriers = 0;
+	};
+
+	BarrierCounters barrier_counters() noexcept;
+
+	// Collects barriers and records them with a single pipeline barrier
+	// command.
+	//
+	// With VK_KHR_synchronization2 (VulkanContext::haveSynchronization2),
+	// vkCmdPipelineBarrier2KHR() is used, and each barrier keeps its own
+	// stage masks. Otherwise, vkCmdPipelineBarrier() is used with the union
+	// of all stage masks, which is correct but may wait for more work than
+	// necessary. Zero stage masks are allowed in either case.
+	//
+	// The argument order follows image_barrier() and buffer_barrier().
+	class BarrierBatch final
+	{
+		public:
+			explicit BarrierBatch( VulkanContext const& );
+
+			BarrierBatch( BarrierBatch const& ) = delete;
+			BarrierBatch& operator= (BarrierBatch const&) = delete;
+
+		public:
+			BarrierBatch& memory(
+				VkAccessFlags aSrcAccessMask,
+				VkAccessFlags aDstAccessMask,
+				VkPipelineStageFlags aSrcStageMask,
+				VkPipelineStageFlags aDstStageMask
+			);
+			BarrierBatch& buffer(
+				VkBuffer,
+				VkAccessFlags aSrcAccessMask,
+				VkAccessFlags aDstAccessMask,
+				VkPipelineStageFlags aSrcStageMask,
+				VkPipelineStageFlags aDstStageMask,
+				VkDeviceSize aSize = VK_WHOLE_SIZE,
+				VkDeviceSize aOffset = 0
+			);
+			BarrierBatch& image(
+				VkImage,
+				VkAccessFlags aSrcAccessMask,
+				VkAccessFlags aDstAccessMask,
+				VkImageLayout aSrcLayout,
+				VkImageLayout aDstLayout,
+				VkPipelineStageFlags aSrcStageMask,
+				VkPipelineStageFlags aDstStageMask,
+				VkImageSubresourceRange = VkImageSubresourceRange{ VK_IMAGE_ASPECT_COLOR_BIT,0,1,0,1 }
+			);
+
+			bool empty() const noexcept;
+
+			// Pipeline barrier commands recorded by this batch so far
+			std::uint32_t calls() const noexcept;
+
+			// Records the collected barriers, if any, and clears the batch
+			void flush( VkCommandBuffer );
+
+		private:
+			bool mSync2;
+			std::uint32_t mCalls = 0;
+
+			// Kept in the synchronization2 form; the stage and access bits
+			// of the original flags have the same values.
+			std::vector<VkMemoryBarrier2KHR> mMemory;
+			std::vector<VkBufferMemoryBarrier2KHR> mBuffers;
+			std::vector<VkImageMemoryBarrier2KHR> mImages;
+	};
+}
+
+//EOF vim:syntax=cpp:foldmethod=marker:ts=4:noexpandtab:
@@ -1,5 +1,7 @@
 #include "context_helpers.hxx"
 
+#include <cassert>
+
 #include "error.hpp"
 #include "to_string.hpp"
 namespace lut = labutils;
@@ -164,3 +166,110 @@ namespace labutils::detail
 		return ret;
 	}
 }
+
+namespace labutils::detail
+{
+	void select_device_features( VulkanContext& aContext, DeviceConfig const& aConfig, std::vector<char const*>& aExtensions, DeviceFeatureChain& aFeatures )
+	{
+		assert( VK_NULL_HANDLE != aContext.physicalDevice );
+
+		VkPhysicalDeviceProperties props;
+		vkGetPhysicalDeviceProperties( aContext.physicalDevice, &props );
+
+		// Descriptor indexing is core in Vulkan 1.2. Earlier devices need the
+		// extension (which depends on VK_KHR_maintenance3, core in 1.1).
+		bool const core12 = VK_API_VERSION_MINOR(props.apiVersion) >= 2 || VK_API_VERSION_MAJOR(props.apiVersion) > 1;
+		auto const extensions = get_device_extensions( aContext.physicalDevice );
+
+		if( aConfig.descriptorIndexing && (core12 || extensions.count( VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME )) )
+		{
+			VkPhysicalDeviceDescriptorIndexingFeatures supported{};
+			supported.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+
+			VkPhysicalDeviceFeatures2 features{};
+			features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+			features.pNext = &supported;
+
+			vkGetPhysicalDeviceFeatures2( aContext.physicalDevice, &features );
+
+			if( supported.runtimeDescriptorArray && supported.descriptorBindingPartiallyBound && supported.descriptorBindingSampledImageUpdateAfterBind && supported.descriptorBindingUpdateUnusedWhilePending && features.features.shaderSampledImageArrayDynamicIndexing )
+			{
+				auto& enable = aFeatures.descriptorIndexing;
+				enable.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+				enable.pNext = const_cast<void*>(aFeatures.head);
+				enable.runtimeDescriptorArray = VK_TRUE;
+				enable.descriptorBindingPartiallyBound = VK_TRUE;
+				enable.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+				enable.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+				aFeatures.head = &enable;
+
+				// The texture index is dynamically uniform (push constant)
+				aFeatures.core.shaderSampledImageArrayDynamicIndexing = VK_TRUE;
+
+				if( !core12 )
+					aExtensions.emplace_back( VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME );
+
+				aContext.haveDescriptorIndexing = true;
+			}
+		}
+
+		// VK_EXT_memory_budget only adds a query structure; there are no
+		// features to enable.
+		if( aConfig.memoryBudget && extensions.count( VK_EXT_MEMORY_BUDGET_EXTENSION_NAME ) )
+		{
+			aExtensions.emplace_back( VK_EXT_MEMORY_BUDGET_EXTENSION_NAME );
+			aContext.haveMemoryBudget = true;
+		}
+
+		// VK_KHR_synchronization2 is not core in Vulkan 1.2
+		if( aConfig.synchronization2 && extensions.count( VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME ) )
+		{
+			VkPhysicalDeviceSynchronization2FeaturesKHR supported{};
+			supported.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES_KHR;
+
+			VkPhysicalDeviceFeatures2 features{};
+			features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+			features.pNext = &supported;
+
+			vkGetPhysicalDeviceFeatures2( aContext.physicalDevice, &features );
+
+			if( supported.synchronization2 )
+			{
+				auto& enable = aFeatures.synchronization2;
+				enable.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES_KHR;
+				enable.pNext = const_cast<void*>(aFeatures.head);
+				enable.synchronization2 = VK_TRUE;
+				aFeatures.head = &enable;
+
+				aExtensions.emplace_back( VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME );
+				aContext.haveSynchronization2 = true;
+			}
+		}
+
+		// VK_KHR_dynamic_rendering depends on VK_KHR_create_renderpass2 and
+		// VK_KHR_depth_stencil_resolve, both core in Vulkan 1.2
+		if( aConfig.dynamicRendering && core12 && extensions.count( VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME ) )
+		{
+			VkPhysicalDeviceDynamicRenderingFeaturesKHR supported{};
+			supported.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR;
+
+			VkPhysicalDeviceFeatures2 features{};
+			features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+			features.pNext = &supported;
+
+			vkGetPhysicalDeviceFeatures2( aContext.physicalDevice, &features );
+
+			if( supported.dynamicRendering )
+			{
+				auto& enable = aFeatures.dynamicRendering;
+				enable.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR;
+				enable.pNext = const_cast<void*>(aFeatures.head);
+				enable.dynamicRendering = VK_TRUE;
+				aFeatures.head = &enable;
+
+				aExtensions.emplace_back( VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME );
+				aContext.haveDynamicRendering = true;
+			}
+		}
+	}
+}
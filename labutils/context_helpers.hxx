@@ -11,6 +11,8 @@
 #include <vector>
 #include <unordered_set>
 
+#include "vulkan_context.hpp"
+
 namespace labutils
 {
 	namespace detail
@@ -30,5 +32,33 @@ namespace labutils
 
 
 		std::unordered_set<std::string> get_device_extensions( VkPhysicalDevice );
+
+
+		// Feature structures for VkDeviceCreateInfo::pNext. The structures
+		// point to each other, so the object must not be moved once filled.
+		struct DeviceFeatureChain
+		{
+			DeviceFeatureChain() = default;
+
+			DeviceFeatureChain( DeviceFeatureChain const& ) = delete;
+			DeviceFeatureChain& operator= (DeviceFeatureChain const&) = delete;
+
+			VkPhysicalDeviceFeatures core{};
+			VkPhysicalDeviceDescriptorIndexingFeatures descriptorIndexing{};
+			VkPhysicalDeviceSynchronization2FeaturesKHR synchronization2{};
+			VkPhysicalDeviceDynamicRenderingFeaturesKHR dynamicRendering{};
+
+			void const* head = nullptr;
+		};
+
+		// Enables the features requested by DeviceConfig that the physical
+		// device supports. Appends any required extensions to aExtensions,
+		// fills in aFeatures and sets the have* flags of aContext.
+		void select_device_features(
+			VulkanContext& aContext,
+			DeviceConfig const&,
+			std::vector<char const*>& aExtensions,
+			DeviceFeatureChain& aFeatures
+		);
 	}
 }
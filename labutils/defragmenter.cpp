@@ -0,0 +1,490 @@
+#include "defragmenter.hpp"
+
+#include <limits>
+#include <utility>
+#include <algorithm>
+
+#include <cassert>
+
+#include "error.hpp"
+#include "vkutil.hpp"
+#include "barrier_batch.hpp"
+#include "to_string.hpp"
+
+namespace labutils
+{
+	Defragmenter::Defragmenter( VulkanContext const& aContext, Allocator const& aAllocator, DefragmentationConfig const& aConfig )
+		: mContext( &aContext )
+		, mAllocator( aAllocator.allocator )
+		, mConfig( aConfig )
+	{
+		assert( mConfig.maxBytesPerRound > 0 && mConfig.maxMovesPerRound > 0 );
+
+		mPool = create_command_pool( aContext, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT );
+		mCmdBuff = alloc_command_buffer( aContext, mPool.handle );
+		mFence = create_fence( aContext );
+
+		mMoves.resize( mConfig.maxMovesPerRound );
+	}
+
+	Defragmenter::~Defragmenter()
+	{
+		// Errors cannot be reported from here. Waiting can only fail if the
+		// device was lost, in which case nothing is in use anymore.
+		if( mPassPending )
+			vkWaitForFences( mContext->device, 1, &mFence.handle, VK_TRUE, std::numeric_limits<std::uint64_t>::max() );
+
+		for( auto const buffer : mOldBuffers )
+			vkDestroyBuffer( mContext->device, buffer, nullptr );
+		for( auto const image : mOldImages )
+			vkDestroyImage( mContext->device, image, nullptr );
+
+		if( VK_NULL_HANDLE != mRound )
+		{
+			if( mPassPending )
+				vmaEndDefragmentationPass( mAllocator, mRound );
+
+			vmaDefragmentationEnd( mAllocator, mRound );
+		}
+	}
+
+	void Defragmenter::add_buffer( Buffer& aBuffer, VkDeviceSize aSize, VkBufferUsageFlags aUsage, MovedFn aOnMoved )
+	{
+		assert( VK_NULL_HANDLE != aBuffer.allocation );
+		assert( (aUsage & VK_BUFFER_USAGE_TRANSFER_SRC_BIT) && (aUsage & VK_BUFFER_USAGE_TRANSFER_DST_BIT) );
+
+		Resource_ res{};
+		res.buffer = &aBuffer;
+		res.bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		res.bufferInfo.size = aSize;
+		res.bufferInfo.usage = aUsage;
+		res.bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		res.onMoved = std::move(aOnMoved);
+
+		mResources.emplace_back( std::move(res) );
+	}
+	void Defragmenter::add_image( Image& aImage, VkImageCreateInfo const& aInfo, VkImageLayout aLayout, MovedFn aOnMoved )
+	{
+		assert( VK_NULL_HANDLE != aImage.allocation );
+		assert( !aInfo.pNext && VK_SHARING_MODE_EXCLUSIVE == aInfo.sharingMode );
+		assert( (aInfo.usage & VK_IMAGE_USAGE_TRANSFER_SRC_BIT) && (aInfo.usage & VK_IMAGE_USAGE_TRANSFER_DST_BIT) );
+
+		Resource_ res{};
+		res.image = &aImage;
+		res.imageInfo = aInfo;
+		res.imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		res.layout = aLayout;
+		res.onMoved = std::move(aOnMoved);
+
+		mResources.emplace_back( std::move(res) );
+	}
+
+	void Defragmenter::remove( Buffer const& aBuffer )
+	{
+		remove_( aBuffer.allocation );
+	}
+	void Defragmenter::remove( Image const& aImage )
+	{
+		remove_( aImage.allocation );
+	}
+
+	void Defragmenter::step()
+	{
+		// Wait (without blocking) for the copies of the previous pass
+		if( mPassPending )
+		{
+			auto const res = vkGetFenceStatus( mContext->device, mFence.handle );
+			if( VK_NOT_READY == res )
+				return;
+
+			if( VK_SUCCESS != res )
+			{
+				throw Error( "Unable to query defragmentation fence\n" "vkGetFenceStatus() returned %s", to_string(res).c_str() );
+			}
+
+			end_pass_();
+			return;
+		}
+
+		// Moves left over from the current round?
+		if( VK_NULL_HANDLE != mRound )
+		{
+			begin_pass_();
+			return;
+		}
+
+		if( mIdle > 0 )
+		{
+			--mIdle;
+			return;
+		}
+
+		if( !mResources.empty() )
+			begin_round_();
+	}
+
+	auto Defragmenter::stats() const noexcept -> Stats const&
+	{
+		return mStats;
+	}
+
+	void Defragmenter::begin_round_()
+	{
+		assert( VK_NULL_HANDLE == mRound );
+
+		std::vector<VmaAllocation> allocations;
+		allocations.reserve( mResources.size() );
+		for( auto const& res : mResources )
+			allocations.emplace_back( res.buffer ? res.buffer->allocation : res.image->allocation );
+
+		// Moves are copied on the GPU only. CPU moves (memcpy between mapped
+		// blocks) would not update the resources' handles.
+		VmaDefragmentationInfo2 info{};
+		info.flags = VMA_DEFRAGMENTATION_FLAG_INCREMENTAL;
+		info.allocationCount = std::uint32_t(allocations.size());
+		info.pAllocations = allocations.data();
+		info.maxCpuBytesToMove = 0;
+		info.maxCpuAllocationsToMove = 0;
+		info.maxGpuBytesToMove = mConfig.maxBytesPerRound;
+		info.maxGpuAllocationsToMove = mConfig.maxMovesPerRound;
+
+		VmaDefragmentationContext ctx = VK_NULL_HANDLE;
+		auto const res = vmaDefragmentationBegin( mAllocator, &info, nullptr, &ctx );
+		if( VK_SUCCESS == res )
+		{
+			// Nothing to do
+			mIdle = mConfig.idleSteps;
+			return;
+		}
+
+		if( VK_NOT_READY != res )
+		{
+			throw Error( "Unable to begin defragmentation\n" "vmaDefragmentationBegin() returned %s", to_string(res).c_str() );
+		}
+
+		mRound = ctx;
+		++mStats.rounds;
+
+		begin_pass_();
+	}
+
+	void Defragmenter::begin_pass_()
+	{
+		assert( VK_NULL_HANDLE != mRound && !mPassPending );
+
+		// VMA plans the round's moves during the first pass
+		VmaDefragmentationPassInfo pass{};
+		pass.moveCount = std::uint32_t(mMoves.size());
+		pass.pMoves = mMoves.data();
+
+		if( auto const res = vmaBeginDefragmentationPass( mAllocator, mRound, &pass ); VK_SUCCESS != res )
+		{
+			throw Error( "Unable to begin defragmentation pass\n" "vmaBeginDefragmentationPass() returned %s", to_string(res).c_str() );
+		}
+
+		if( 0 == pass.moveCount )
+		{
+			// Memory is as compact as the limits allow
+			vmaEndDefragmentationPass( mAllocator, mRound );
+			end_round_();
+
+			mIdle = mConfig.idleSteps;
+			return;
+		}
+
+		// New handles; only swapped in once the copies have been submitted
+		std::vector<std::pair<Resource_*,VkBuffer>> newBuffers;
+		std::vector<std::pair<Resource_*,VkImage>> newImages;
+
+		try
+		{
+			if( auto const res = vkResetCommandBuffer( mCmdBuff, 0 ); VK_SUCCESS != res )
+			{
+				throw Error( "Unable to reset defragmentation command buffer\n" "vkResetCommandBuffer() returned %s", to_string(res).c_str() );
+			}
+
+			VkCommandBufferBeginInfo beginInfo{};
+			beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+			beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+			if( auto const res = vkBeginCommandBuffer( mCmdBuff, &beginInfo ); VK_SUCCESS != res )
+			{
+				throw Error( "Unable to begin recording defragmentation command buffer\n" "vkBeginCommandBuffer() returned %s", to_string(res).c_str() );
+			}
+
+			for( std::uint32_t i = 0; i < pass.moveCount; ++i )
+			{
+				auto& res = find_( mMoves[i].allocation );
+
+				VkBuffer buffer = VK_NULL_HANDLE;
+				VkImage image = VK_NULL_HANDLE;
+				record_move_( res, mMoves[i], buffer, image );
+
+				if( res.buffer )
+					newBuffers.emplace_back( &res, buffer );
+				else
+					newImages.emplace_back( &res, image );
+			}
+
+			if( auto const res = vkEndCommandBuffer( mCmdBuff ); VK_SUCCESS != res )
+			{
+				throw Error( "Unable to end recording defragmentation command buffer\n" "vkEndCommandBuffer() returned %s", to_string(res).c_str() );
+			}
+
+			if( auto const res = vkResetFences( mContext->device, 1, &mFence.handle ); VK_SUCCESS != res )
+			{
+				throw Error( "Unable to reset defragmentation fence\n" "vkResetFences() returned %s", to_string(res).c_str() );
+			}
+
+			// The copies go to the same queue as the frames. Submission order
+			// and the barriers in record_move_() order them after all frames
+			// submitted so far, and before any frame submitted later.
+			VkSubmitInfo submitInfo{};
+			submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+			submitInfo.commandBufferCount = 1;
+			submitInfo.pCommandBuffers = &mCmdBuff;
+
+			if( auto const res = vkQueueSubmit( mContext->graphicsQueue, 1, &submitInfo, mFence.handle ); VK_SUCCESS != res )
+			{
+				throw Error( "Unable to submit defragmentation copies\n" "vkQueueSubmit() returned %s", to_string(res).c_str() );
+			}
+		}
+		catch( ... )
+		{
+			// Nothing was submitted. Drop the new handles and abandon the
+			// round. vmaEndDefragmentationPass() would commit the pass's
+			// moves, i.e., point the allocations at memory that was never
+			// copied to while the resources remain bound to the old memory.
+			// Ending the round alone leaves the allocations where they are.
+			for( auto const& entry : newBuffers )
+				vkDestroyBuffer( mContext->device, entry.second, nullptr );
+			for( auto const& entry : newImages )
+				vkDestroyImage( mContext->device, entry.second, nullptr );
+
+			vkResetCommandBuffer( mCmdBuff, 0 );
+
+			end_round_();
+
+			throw;
+		}
+
+		mPassPending = true;
+
+		// Swap in the new handles. Listeners replace the objects that refer
+		// to the old ones (views, descriptors).
+		for( auto const& [res, buffer] : newBuffers )
+		{
+			mOldBuffers.emplace_back( std::exchange( res->buffer->buffer, buffer ) );
+			if( res->onMoved )
+				res->onMoved();
+		}
+		for( auto const& [res, image] : newImages )
+		{
+			mOldImages.emplace_back( std::exchange( res->image->image, image ) );
+			if( res->onMoved )
+				res->onMoved();
+		}
+	}
+
+	void Defragmenter::end_pass_()
+	{
+		assert( mPassPending );
+
+		// The copies have completed, and with them all frames that were
+		// submitted earlier.
+		for( auto const buffer : mOldBuffers )
+			vkDestroyBuffer( mContext->device, buffer, nullptr );
+		for( auto const image : mOldImages )
+			vkDestroyImage( mContext->device, image, nullptr );
+
+		mOldBuffers.clear();
+		mOldImages.clear();
+
+		mPassPending = false;
+
+		// Releases the old locations. VMA frees blocks that became empty.
+		auto const res = vmaEndDefragmentationPass( mAllocator, mRound );
+		if( VK_NOT_READY == res )
+			return; // more moves in this round
+
+		if( VK_SUCCESS != res )
+		{
+			throw Error( "Unable to end defragmentation pass\n" "vmaEndDefragmentationPass() returned %s", to_string(res).c_str() );
+		}
+
+		end_round_();
+	}
+
+	void Defragmenter::end_round_()
+	{
+		assert( VK_NULL_HANDLE != mRound );
+
+		auto const ctx = std::exchange( mRound, VK_NULL_HANDLE );
+		if( auto const res = vmaDefragmentationEnd( mAllocator, ctx ); VK_SUCCESS != res )
+		{
+			throw Error( "Unable to end defragmentation\n" "vmaDefragmentationEnd() returned %s", to_string(res).c_str() );
+		}
+	}
+
+	void Defragmenter::finish_()
+	{
+		if( mPassPending )
+		{
+			if( auto const res = vkWaitForFences( mContext->device, 1, &mFence.handle, VK_TRUE, std::numeric_limits<std::uint64_t>::max() ); VK_SUCCESS != res )
+			{
+				throw Error( "Unable to wait for defragmentation fence\n" "vkWaitForFences() returned %s", to_string(res).c_str() );
+			}
+
+			end_pass_();
+		}
+
+		// Moves that were planned but not started are dropped
+		if( VK_NULL_HANDLE != mRound )
+			end_round_();
+	}
+
+	void Defragmenter::remove_( VmaAllocation aAllocation )
+	{
+		// VMA may hold on to the allocation until the end of the round
+		finish_();
+
+		auto const it = std::find_if( mResources.begin(), mResources.end(), [aAllocation] (Resource_ const& aRes) {
+			return aAllocation == (aRes.buffer ? aRes.buffer->allocation : aRes.image->allocation);
+		} );
+
+		if( mResources.end() != it )
+			mResources.erase( it );
+	}
+
+	auto Defragmenter::find_( VmaAllocation aAllocation ) -> Resource_&
+	{
+		for( auto& res : mResources )
+		{
+			if( aAllocation == (res.buffer ? res.buffer->allocation : res.image->allocation) )
+				return res;
+		}
+
+		throw Error( "Defragmentation moved an allocation that was not registered" );
+	}
+
+	void Defragmenter::record_move_( Resource_& aRes, VmaDefragmentationPassMoveInfo const& aMove, VkBuffer& aNewBuffer, VkImage& aNewImage )
+	{
+		// The old resource may still be written by frames that were submitted
+		// earlier; the new one is read by any frame that is submitted later.
+		// Both are covered by barriers against all commands.
+		if( aRes.buffer )
+		{
+			if( auto const res = vkCreateBuffer( mContext->device, &aRes.bufferInfo, nullptr, &aNewBuffer ); VK_SUCCESS != res )
+			{
+				throw Error( "Unable to create buffer for defragmentation\n" "vkCreateBuffer() returned %s", to_string(res).c_str() );
+			}
+
+			if( auto const res = vkBindBufferMemory( mContext->device, aNewBuffer, aMove.memory, aMove.offset ); VK_SUCCESS != res )
+			{
+				vkDestroyBuffer( mContext->device, aNewBuffer, nullptr );
+				throw Error( "Unable to bind buffer memory for defragmentation\n" "vkBindBufferMemory() returned %s", to_string(res).c_str() );
+			}
+
+			buffer_barrier( mCmdBuff, aRes.buffer->buffer,
+				VK_ACCESS_MEMORY_WRITE_BIT,
+				VK_ACCESS_TRANSFER_READ_BIT,
+				VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+				VK_PIPELINE_STAGE_TRANSFER_BIT
+			);
+
+			VkBufferCopy copy{};
+			copy.size = aRes.bufferInfo.size;
+			vkCmdCopyBuffer( mCmdBuff, aRes.buffer->buffer, aNewBuffer, 1, &copy );
+
+			buffer_barrier( mCmdBuff, aNewBuffer,
+				VK_ACCESS_TRANSFER_WRITE_BIT,
+				VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT,
+				VK_PIPELINE_STAGE_TRANSFER_BIT,
+				VK_PIPELINE_STAGE_ALL_COMMANDS_BIT
+			);
+
+			++mStats.movedAllocations;
+			mStats.movedBytes += aRes.bufferInfo.size;
+			return;
+		}
+
+		auto const& info = aRes.imageInfo;
+		if( auto const res = vkCreateImage( mContext->device, &info, nullptr, &aNewImage ); VK_SUCCESS != res )
+		{
+			throw Error( "Unable to create image for defragmentation\n" "vkCreateImage() returned %s", to_string(res).c_str() );
+		}
+
+		if( auto const res = vkBindImageMemory( mContext->device, aNewImage, aMove.memory, aMove.offset ); VK_SUCCESS != res )
+		{
+			vkDestroyImage( mContext->device, aNewImage, nullptr );
+			throw Error( "Unable to bind image memory for defragmentation\n" "vkBindImageMemory() returned %s", to_string(res).c_str() );
+		}
+
+		VkImageSubresourceRange const range{
+			VK_IMAGE_ASPECT_COLOR_BIT,
+			0, info.mipLevels,
+			0, info.arrayLayers
+		};
+
+		BarrierBatch( *mContext )
+			.image( aRes.image->image,
+				VK_ACCESS_MEMORY_WRITE_BIT,
+				VK_ACCESS_TRANSFER_READ_BIT,
+				aRes.layout,
+				VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+				VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+				VK_PIPELINE_STAGE_TRANSFER_BIT,
+				range
+			)
+			.image( aNewImage,
+				0,
+				VK_ACCESS_TRANSFER_WRITE_BIT,
+				VK_IMAGE_LAYOUT_UNDEFINED,
+				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+				VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+				VK_PIPELINE_STAGE_TRANSFER_BIT,
+				range
+			)
+			.flush( mCmdBuff );
+
+		// One region per mip level
+		std::vector<VkImageCopy> copies( info.mipLevels );
+		for( std::uint32_t level = 0; level < info.mipLevels; ++level )
+		{
+			auto& copy = copies[level];
+			copy.srcSubresource = VkImageSubresourceLayers{ VK_IMAGE_ASPECT_COLOR_BIT, level, 0, info.arrayLayers };
+			copy.srcOffset = VkOffset3D{ 0, 0, 0 };
+			copy.dstSubresource = copy.srcSubresource;
+			copy.dstOffset = VkOffset3D{ 0, 0, 0 };
+			copy.extent = VkExtent3D{
+				std::max( info.extent.width >> level, 1u ),
+				std::max( info.extent.height >> level, 1u ),
+				std::max( info.extent.depth >> level, 1u )
+			};
+		}
+
+		vkCmdCopyImage( mCmdBuff,
+			aRes.image->image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			aNewImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			std::uint32_t(copies.size()), copies.data()
+		);
+
+		image_barrier( mCmdBuff, aNewImage,
+			VK_ACCESS_TRANSFER_WRITE_BIT,
+			VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT,
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			aRes.layout,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+			range
+		);
+
+		VkMemoryRequirements memReqs{};
+		vkGetImageMemoryRequirements( mContext->device, aNewImage, &memReqs );
+
+		++mStats.movedAllocations;
+		mStats.movedBytes += memReqs.size;
+	}
+}
+
+//EOF vim:syntax=cpp:foldmethod=marker:ts=4:noexpandtab:
@@ -0,0 +1,144 @@
+#pragma once
+
+#include <volk/volk.h>
+#include <vk_mem_alloc.h>
+
+#include <vector>
+#include <functional>
+
+#include <cstdint>
+
+#include "vkobject.hpp"
+#include "vkimage.hpp"
+#include "vkbuffer.hpp"
+#include "allocator.hpp"
+#include "vulkan_context.hpp"
+
+namespace labutils
+{
+	// Limits for a Defragmenter
+	struct DefragmentationConfig
+	{
+		// Upper bound for the data moved per round, and for the number of
+		// resources moved per round. The copies of one round are submitted
+		// at once, so these bound the extra GPU work in any single frame.
+		VkDeviceSize maxBytesPerRound = 16*1024*1024;
+		std::uint32_t maxMovesPerRound = 16;
+
+		// Number of step() calls to wait after a round that found nothing
+		// to move before trying again.
+		std::uint32_t idleSteps = 300;
+	};
+
+	// Incremental defragmentation of device-local memory.
+	//
+	// Resources are registered with the defragmenter. Each call to step()
+	// advances a small state machine: it asks VMA which of the registered
+	// allocations to move (at most maxBytesPerRound/maxMovesPerRound), creates
+	// new VkBuffer/VkImage handles at the destinations, and copies the
+	// contents with a command buffer that is submitted to the graphics queue
+	// right away. The Buffer/Image objects are updated to refer to the new
+	// handles, and the registered callback is invoked, such that views and
+	// descriptors can be replaced. Frames recorded afterwards must only use the
+	// new handles.
+	//
+	// The old handles are destroyed, and their memory released to VMA, only
+	// once the copy's fence has been signalled. As the copy is submitted after
+	// all earlier frames, the fence also covers any frames that used the old
+	// handles. Callers must likewise defer destroying objects that they
+	// replace in the callback (see DeletionQueue).
+	//
+	// Only device-local resources that are never mapped should be registered.
+	// Buffers need VK_BUFFER_USAGE_TRANSFER_SRC_BIT and _DST_BIT; images need
+	// the equivalent usage flags, must be color images, and must be in the
+	// given layout whenever no frame is executing.
+	class Defragmenter final
+	{
+		public:
+			using MovedFn = std::function<void()>;
+
+			struct Stats
+			{
+				std::uint64_t rounds = 0;
+				std::uint64_t movedAllocations = 0;
+				VkDeviceSize movedBytes = 0;
+			};
+
+		public:
+			Defragmenter( VulkanContext const&, Allocator const&, DefragmentationConfig const& = {} );
+
+			// Waits for a pending copy. The device should be idle, or at least
+			// not use the registered resources anymore.
+			~Defragmenter();
+
+			Defragmenter( Defragmenter const& ) = delete;
+			Defragmenter& operator= (Defragmenter const&) = delete;
+
+		public:
+			// The objects must remain at the same address until they are
+			// removed (or the defragmenter is destroyed). aSize is the size
+			// that the buffer was created with.
+			void add_buffer( Buffer&, VkDeviceSize aSize, VkBufferUsageFlags, MovedFn = {} );
+			void add_image( Image&, VkImageCreateInfo const&, VkImageLayout, MovedFn = {} );
+
+			// Finishes the current round first, which may wait for the GPU.
+			void remove( Buffer const& );
+			void remove( Image const& );
+
+			// Call once per frame, before recording the frame's commands
+			void step();
+
+			Stats const& stats() const noexcept;
+
+		private:
+			struct Resource_
+			{
+				Buffer* buffer;
+				Image* image;
+
+				VkBufferCreateInfo bufferInfo;
+				VkImageCreateInfo imageInfo;
+				VkImageLayout layout;
+
+				MovedFn onMoved;
+			};
+
+			void begin_round_();
+			void begin_pass_();
+			void end_pass_();
+			void end_round_();
+
+			void finish_();
+			void remove_( VmaAllocation );
+
+			Resource_& find_( VmaAllocation );
+
+			// Creates the new handle, and records the copy into it
+			void record_move_( Resource_&, VmaDefragmentationPassMoveInfo const&, VkBuffer&, VkImage& );
+
+		private:
+			VulkanContext const* mContext;
+			VmaAllocator mAllocator;
+			DefragmentationConfig mConfig;
+
+			std::vector<Resource_> mResources;
+
+			VmaDefragmentationContext mRound = VK_NULL_HANDLE;
+			std::uint32_t mIdle = 0;
+
+			CommandPool mPool;
+			VkCommandBuffer mCmdBuff = VK_NULL_HANDLE;
+			Fence mFence;
+			bool mPassPending = false;
+
+			std::vector<VmaDefragmentationPassMoveInfo> mMoves;
+
+			// Handles replaced by the pending pass
+			std::vector<VkBuffer> mOldBuffers;
+			std::vector<VkImage> mOldImages;
+
+			Stats mStats;
+	};
+}
+
+//EOF vim:syntax=cpp:foldmethod=marker:ts=4:noexpandtab:
@@ -0,0 +1,54 @@
+#include "deletion_queue.hpp"
+
+#include <cassert>
+
+namespace labutils
+{
+	struct DeletionQueue::Deferred_ final : DeletionQueue::Retired_
+	{
+		explicit Deferred_( std::function<void()> aFn )
+			: fn( std::move(aFn) )
+		{}
+
+		~Deferred_()
+		{
+			if( fn )
+				fn();
+		}
+
+		std::function<void()> fn;
+	};
+
+	DeletionQueue::~DeletionQueue()
+	{
+		// Destroy in the order in which the objects were retired
+		flush();
+	}
+
+	void DeletionQueue::defer( std::function<void()> aFn, std::uint64_t aSerial )
+	{
+		assert( mEntries.empty() || mEntries.back().serial <= aSerial );
+
+		mEntries.emplace_back( Entry_{ aSerial, std::make_unique<Deferred_>( std::move(aFn) ) } );
+	}
+
+	void DeletionQueue::collect( std::uint64_t aCompletedSerial )
+	{
+		// Serials are non-decreasing, so the retired objects are ordered
+		while( !mEntries.empty() && mEntries.front().serial <= aCompletedSerial )
+			mEntries.pop_front();
+	}
+
+	void DeletionQueue::flush()
+	{
+		while( !mEntries.empty() )
+			mEntries.pop_front();
+	}
+
+	std::size_t DeletionQueue::size() const noexcept
+	{
+		return mEntries.size();
+	}
+}
+
+//EOF vim:syntax=cpp:foldmethod=marker:ts=4:noexpandtab:
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <deque>
+#include <memory>
+#include <functional>
+#include <utility>
+
+#include <cstdint>
+
+namespace labutils
+{
+	// Defers the destruction of objects until the GPU no longer uses them.
+	//
+	// Objects are retired together with a serial, typically the number of
+	// frames that had been submitted when the object was replaced. Once the
+	// caller knows that all work up to some serial has completed, collect()
+	// destroys the objects that were retired with that serial or an earlier
+	// one. Any move-only owner works, e.g. the UniqueHandle wrappers, Buffer
+	// or Image, or a std::vector of them. For anything else (e.g. handing a
+	// descriptor set back to its allocator), defer() runs a function instead.
+	//
+	// Serials passed to retire() must not decrease.
+	class DeletionQueue final
+	{
+		public:
+			DeletionQueue() = default;
+			~DeletionQueue();
+
+			DeletionQueue( DeletionQueue const& ) = delete;
+			DeletionQueue& operator= (DeletionQueue const&) = delete;
+
+		public:
+			template< typename tObject >
+			void retire( tObject&&, std::uint64_t aSerial );
+
+			// Calls aFn when the entry is destroyed (by collect() or flush())
+			void defer( std::function<void()> aFn, std::uint64_t aSerial );
+
+			// Destroys all objects with a serial <= aCompletedSerial
+			void collect( std::uint64_t aCompletedSerial );
+
+			// Destroys all objects. Only call once the device is idle.
+			void flush();
+
+			std::size_t size() const noexcept;
+
+		private:
+			struct Retired_
+			{
+				virtual ~Retired_() = default;
+			};
+
+			template< typename tObject >
+			struct RetiredObject_;
+
+			struct Deferred_;
+
+			struct Entry_
+			{
+				std::uint64_t serial;
+				std::unique_ptr<Retired_> object;
+			};
+
+			std::deque<Entry_> mEntries;
+	};
+}
+
+#include "deletion_queue.inl"
+
+//EOF vim:syntax=cpp:foldmethod=marker:ts=4:noexpandtab:
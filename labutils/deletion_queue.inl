@@ -0,0 +1,25 @@
+#include <cassert>
+#include <type_traits>
+
+namespace labutils
+{
+	template< typename tObject >
+	struct DeletionQueue::RetiredObject_ final : DeletionQueue::Retired_
+	{
+		explicit RetiredObject_( tObject&& aObject )
+			: object( std::move(aObject) )
+		{}
+
+		tObject object;
+	};
+
+	template< typename tObject >
+	inline
+	void DeletionQueue::retire( tObject&& aObject, std::uint64_t aSerial )
+	{
+		static_assert( !std::is_lvalue_reference_v<tObject>, "retire() takes ownership; use std::move()" );
+		assert( mEntries.empty() || mEntries.back().serial <= aSerial );
+
+		mEntries.emplace_back( Entry_{ aSerial, std::make_unique<RetiredObject_<tObject>>( std::move(aObject) ) } );
+	}
+}
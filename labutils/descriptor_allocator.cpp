@@ -0,0 +1,150 @@
+#include "descriptor_allocator.hpp"
+
+#include <utility>
+
+#include <cassert>
+
+#include "error.hpp"
+#include "to_string.hpp"
+
+namespace labutils
+{
+	DescriptorAllocator::DescriptorAllocator( VulkanContext const& aContext, std::uint32_t aSetsPerPool, std::initializer_list<VkDescriptorPoolSize> aPoolSizes )
+		: mDevice( aContext.device )
+		, mSetsPerPool( aSetsPerPool )
+		, mPoolSizes( aPoolSizes )
+	{
+		assert( aSetsPerPool > 0 );
+
+		if( mPoolSizes.empty() )
+		{
+			mPoolSizes = {
+				{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2*aSetsPerPool },
+				{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2*aSetsPerPool }
+			};
+		}
+	}
+
+	DescriptorAllocator::DescriptorAllocator( DescriptorAllocator&& aOther ) noexcept
+		: mDevice( std::exchange( aOther.mDevice, VK_NULL_HANDLE ) )
+		, mSetsPerPool( std::exchange( aOther.mSetsPerPool, 0 ) )
+		, mPoolSizes( std::move(aOther.mPoolSizes) )
+		, mPools( std::move(aOther.mPools) )
+		, mCurrent( std::exchange( aOther.mCurrent, 0 ) )
+		, mRecycled( std::move(aOther.mRecycled) )
+	{}
+	DescriptorAllocator& DescriptorAllocator::operator=( DescriptorAllocator&& aOther ) noexcept
+	{
+		std::swap( mDevice, aOther.mDevice );
+		std::swap( mSetsPerPool, aOther.mSetsPerPool );
+		std::swap( mPoolSizes, aOther.mPoolSizes );
+		std::swap( mPools, aOther.mPools );
+		std::swap( mCurrent, aOther.mCurrent );
+		std::swap( mRecycled, aOther.mRecycled );
+		return *this;
+	}
+
+	VkDescriptorSet DescriptorAllocator::allocate( VkDescriptorSetLayout aLayout )
+	{
+		for( auto it = mRecycled.begin(); it != mRecycled.end(); ++it )
+		{
+			if( aLayout == it->first )
+			{
+				auto const dset = it->second;
+				mRecycled.erase( it );
+				return dset;
+			}
+		}
+
+		VkDescriptorSet dset = VK_NULL_HANDLE;
+		allocate( 1, &aLayout, &dset );
+		return dset;
+	}
+
+	void DescriptorAllocator::allocate( std::uint32_t aCount, VkDescriptorSetLayout const* aLayouts, VkDescriptorSet* aSets )
+	{
+		assert( VK_NULL_HANDLE != mDevice );
+		assert( aCount <= mSetsPerPool );
+
+		if( mPools.empty() )
+			mPools.emplace_back( DescriptorPool( mDevice, create_pool_() ) );
+
+		VkDescriptorSetAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocInfo.descriptorSetCount = aCount;
+		allocInfo.pSetLayouts = aLayouts;
+
+		// Try the current pool. If it is exhausted, try the next one, which
+		// is either a previously reset pool or a new one.
+		for( std::size_t attempt = 0; attempt < 2; ++attempt )
+		{
+			allocInfo.descriptorPool = mPools[mCurrent].handle;
+
+			auto const res = vkAllocateDescriptorSets( mDevice, &allocInfo, aSets );
+			if( VK_SUCCESS == res )
+				return;
+
+			if( VK_ERROR_OUT_OF_POOL_MEMORY != res && VK_ERROR_FRAGMENTED_POOL != res )
+			{
+				throw Error( "Unable to allocate %u descriptor sets\n" "vkAllocateDescriptorSets() returned %s", aCount, to_string(res).c_str() );
+			}
+
+			if( 0 != attempt )
+			{
+				throw Error( "Unable to allocate %u descriptor sets from an empty pool\n" "vkAllocateDescriptorSets() returned %s", aCount, to_string(res).c_str() );
+			}
+
+			++mCurrent;
+			if( mCurrent == mPools.size() )
+				mPools.emplace_back( DescriptorPool( mDevice, create_pool_() ) );
+		}
+	}
+
+	void DescriptorAllocator::recycle( VkDescriptorSetLayout aLayout, VkDescriptorSet aSet )
+	{
+		assert( VK_NULL_HANDLE != aSet );
+		mRecycled.emplace_back( aLayout, aSet );
+	}
+
+	void DescriptorAllocator::reset()
+	{
+		mRecycled.clear();
+
+		if( mPools.empty() )
+			return;
+
+		for( std::size_t i = 0; i <= mCurrent; ++i )
+		{
+			if( auto const res = vkResetDescriptorPool( mDevice, mPools[i].handle, 0 ); VK_SUCCESS != res )
+			{
+				throw Error( "Unable to reset descriptor pool\n" "vkResetDescriptorPool() returned %s", to_string(res).c_str() );
+			}
+		}
+
+		mCurrent = 0;
+	}
+
+	std::size_t DescriptorAllocator::pool_count() const noexcept
+	{
+		return mPools.size();
+	}
+
+	VkDescriptorPool DescriptorAllocator::create_pool_()
+	{
+		VkDescriptorPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		poolInfo.maxSets = mSetsPerPool;
+		poolInfo.poolSizeCount = std::uint32_t(mPoolSizes.size());
+		poolInfo.pPoolSizes = mPoolSizes.data();
+
+		VkDescriptorPool pool = VK_NULL_HANDLE;
+		if( auto const res = vkCreateDescriptorPool( mDevice, &poolInfo, nullptr, &pool ); VK_SUCCESS != res )
+		{
+			throw Error( "Unable to create descriptor pool\n" "vkCreateDescriptorPool() returned %s", to_string(res).c_str() );
+		}
+
+		return pool;
+	}
+}
+
+//EOF vim:syntax=cpp:foldmethod=marker:ts=4:noexpandtab:
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <volk/volk.h>
+
+#include <vector>
+#include <utility>
+#include <initializer_list>
+
+#include <cstdint>
+
+#include "vkobject.hpp"
+#include "vulkan_context.hpp"
+
+namespace labutils
+{
+	// Descriptor set allocator that grows on demand.
+	//
+	// Sets are allocated from the current pool. When that pool runs out
+	// (VK_ERROR_OUT_OF_POOL_MEMORY or VK_ERROR_FRAGMENTED_POOL), allocation
+	// moves on to the next pool, creating one if necessary. Individual sets
+	// are never freed. Instead, reset() resets all pools at once with
+	// vkResetDescriptorPool(); the pools are kept and reused, so an allocator
+	// that is reset every frame stops creating pools (or allocating memory)
+	// once it has reached its peak size. Long-lived sets that are no longer
+	// needed can be handed back with recycle(), and are then returned by a
+	// later allocate() with the same layout.
+	//
+	// A typical use is one allocator for long-lived sets, plus one per frame
+	// in flight for sets that are only used by a single frame. The latter is
+	// reset once the frame's fence has been signalled.
+	class DescriptorAllocator final
+	{
+		public:
+			DescriptorAllocator() noexcept = default;
+
+			// aPoolSizes is the number of descriptors of each type per pool.
+			// The default covers uniform buffers and combined image samplers.
+			explicit DescriptorAllocator(
+				VulkanContext const&,
+				std::uint32_t aSetsPerPool = 256,
+				std::initializer_list<VkDescriptorPoolSize> aPoolSizes = {}
+			);
+
+			~DescriptorAllocator() = default;
+
+			DescriptorAllocator( DescriptorAllocator const& ) = delete;
+			DescriptorAllocator& operator= (DescriptorAllocator const&) = delete;
+
+			DescriptorAllocator( DescriptorAllocator&& ) noexcept;
+			DescriptorAllocator& operator= (DescriptorAllocator&&) noexcept;
+
+		public:
+			VkDescriptorSet allocate( VkDescriptorSetLayout );
+
+			// Allocates aCount sets with a single vkAllocateDescriptorSets()
+			// call (all sets come from the same pool).
+			void allocate( std::uint32_t aCount, VkDescriptorSetLayout const* aLayouts, VkDescriptorSet* aSets );
+
+			// Makes the set available to allocate( aLayout ). The set must no
+			// longer be in use by the GPU; its contents are kept.
+			void recycle( VkDescriptorSetLayout, VkDescriptorSet );
+
+			// Invalidates all sets allocated so far
+			void reset();
+
+			std::size_t pool_count() const noexcept;
+
+		private:
+			VkDescriptorPool create_pool_();
+
+		private:
+			VkDevice mDevice = VK_NULL_HANDLE;
+
+			std::uint32_t mSetsPerPool = 0;
+			std::vector<VkDescriptorPoolSize> mPoolSizes;
+
+			// Pools [0, mCurrent] are in use
+			std::vector<DescriptorPool> mPools;
+			std::size_t mCurrent = 0;
+
+			// Sets passed to recycle()
+			std::vector<std::pair<VkDescriptorSetLayout,VkDescriptorSet>> mRecycled;
+	};
+}
+
+//EOF vim:syntax=cpp:foldmethod=marker:ts=4:noexpandtab:
@@ -0,0 +1,166 @@
+#include "descriptor_writer.hpp"
+
+#include <cassert>
+
+#include "error.hpp"
+#include "to_string.hpp"
+
+namespace labutils
+{
+#	if !defined(NDEBUG) // only used in assertions
+	namespace
+	{
+		bool is_buffer_type_( VkDescriptorType aType ) noexcept
+		{
+			switch( aType )
+			{
+				case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER:
+				case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER:
+				case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC:
+				case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC:
+					return true;
+
+				default:
+					return false;
+			}
+		}
+
+		bool is_image_type_( VkDescriptorType aType ) noexcept
+		{
+			switch( aType )
+			{
+				case VK_DESCRIPTOR_TYPE_SAMPLER:
+				case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER:
+				case VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE:
+				case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE:
+				case VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT:
+					return true;
+
+				default:
+					return false;
+			}
+		}
+	}
+#	endif // ~ !NDEBUG
+
+	DescriptorWriter& DescriptorWriter::write_buffer( VkDescriptorSet aSet, std::uint32_t aBinding, VkDescriptorType aType, VkBuffer aBuffer, VkDeviceSize aOffset, VkDeviceSize aRange )
+	{
+		assert( VK_NULL_HANDLE != aSet );
+		assert( is_buffer_type_( aType ) );
+
+		VkDescriptorBufferInfo info{};
+		info.buffer = aBuffer;
+		info.offset = aOffset;
+		info.range = aRange;
+
+		VkWriteDescriptorSet write{};
+		write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write.dstSet = aSet;
+		write.dstBinding = aBinding;
+		write.descriptorType = aType;
+		write.descriptorCount = 1;
+
+		mWrites.emplace_back( write );
+		mInfoIndices.emplace_back( mBufferInfos.size() );
+		mBufferInfos.emplace_back( info );
+
+		return *this;
+	}
+
+	DescriptorWriter& DescriptorWriter::write_image( VkDescriptorSet aSet, std::uint32_t aBinding, VkDescriptorType aType, VkImageView aView, VkSampler aSampler, VkImageLayout aLayout, std::uint32_t aArrayElement )
+	{
+		assert( VK_NULL_HANDLE != aSet );
+		assert( is_image_type_( aType ) );
+
+		VkDescriptorImageInfo info{};
+		info.sampler = aSampler;
+		info.imageView = aView;
+		info.imageLayout = aLayout;
+
+		VkWriteDescriptorSet write{};
+		write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write.dstSet = aSet;
+		write.dstBinding = aBinding;
+		write.dstArrayElement = aArrayElement;
+		write.descriptorType = aType;
+		write.descriptorCount = 1;
+
+		mWrites.emplace_back( write );
+		mInfoIndices.emplace_back( mImageInfos.size() );
+		mImageInfos.emplace_back( info );
+
+		return *this;
+	}
+
+	std::size_t DescriptorWriter::pending() const noexcept
+	{
+		return mWrites.size();
+	}
+
+	void DescriptorWriter::update( VulkanContext const& aContext )
+	{
+		assert( mWrites.size() == mInfoIndices.size() );
+
+		if( mWrites.empty() )
+			return;
+
+		for( std::size_t i = 0; i < mWrites.size(); ++i )
+		{
+			auto& write = mWrites[i];
+
+			switch( write.descriptorType )
+			{
+				case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER:
+				case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER:
+				case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC:
+				case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC:
+					write.pBufferInfo = &mBufferInfos[mInfoIndices[i]];
+					break;
+
+				case VK_DESCRIPTOR_TYPE_SAMPLER:
+				case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER:
+				case VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE:
+				case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE:
+				case VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT:
+					write.pImageInfo = &mImageInfos[mInfoIndices[i]];
+					break;
+
+				default:
+					assert( false ); // rejected by write_buffer()/write_image()
+					break;
+			}
+		}
+
+		vkUpdateDescriptorSets( aContext.device, std::uint32_t(mWrites.size()), mWrites.data(), 0, nullptr );
+
+		mWrites.clear();
+		mInfoIndices.clear();
+		mBufferInfos.clear();
+		mImageInfos.clear();
+	}
+}
+
+namespace labutils
+{
+	DescriptorUpdateTemplate create_descriptor_update_template( VulkanContext const& aContext, VkDescriptorSetLayout aLayout, std::vector<VkDescriptorUpdateTemplateEntry> const& aEntries )
+	{
+		VkDescriptorUpdateTemplateCreateInfo templateInfo{};
+		templateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_UPDATE_TEMPLATE_CREATE_INFO;
+		templateInfo.descriptorUpdateEntryCount = std::uint32_t(aEntries.size());
+		templateInfo.pDescriptorUpdateEntries = aEntries.data();
+		templateInfo.templateType = VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_DESCRIPTOR_SET;
+		templateInfo.descriptorSetLayout = aLayout;
+
+		VkDescriptorUpdateTemplate handle = VK_NULL_HANDLE;
+		if( auto const res = vkCreateDescriptorUpdateTemplate( aContext.device, &templateInfo, nullptr, &handle ); VK_SUCCESS != res )
+		{
+			throw Error( "Unable to create descriptor update template\n"
+				"vkCreateDescriptorUpdateTemplate() returned %s", to_string(res).c_str()
+			);
+		}
+
+		return DescriptorUpdateTemplate( aContext.device, handle );
+	}
+}
+
+//EOF vim:syntax=cpp:foldmethod=marker:ts=4:noexpandtab:
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <volk/volk.h>
+
+#include <vector>
+
+#include <cstdint>
+#include <cstddef>
+
+#include "vkobject.hpp"
+#include "vulkan_context.hpp"
+
+namespace labutils
+{
+	// Collects descriptor writes, possibly for many different sets, and
+	// applies them with a single vkUpdateDescriptorSets() call.
+	//
+	// The buffer and image infos are copied into the writer, so callers need
+	// not keep them alive until update(). After update(), the writer is empty
+	// and can be reused.
+	class DescriptorWriter final
+	{
+		public:
+			DescriptorWriter() = default;
+
+			// Uniform or storage buffers (including the dynamic variants)
+			DescriptorWriter& write_buffer(
+				VkDescriptorSet,
+				std::uint32_t aBinding,
+				VkDescriptorType,
+				VkBuffer,
+				VkDeviceSize aOffset = 0,
+				VkDeviceSize aRange = VK_WHOLE_SIZE
+			);
+
+			// Samplers, (combined image) samplers, sampled and storage images,
+			// and input attachments. Texel buffers are not supported.
+			DescriptorWriter& write_image(
+				VkDescriptorSet,
+				std::uint32_t aBinding,
+				VkDescriptorType,
+				VkImageView,
+				VkSampler,
+				VkImageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+				std::uint32_t aArrayElement = 0
+			);
+
+			// Number of writes that update() would perform
+			std::size_t pending() const noexcept;
+
+			void update( VulkanContext const& );
+
+		private:
+			std::vector<VkWriteDescriptorSet> mWrites;
+
+			// Index into mBufferInfos or mImageInfos for each write. The
+			// pointers in mWrites are only set in update(), as the vectors
+			// may reallocate until then.
+			std::vector<std::size_t> mInfoIndices;
+
+			std::vector<VkDescriptorBufferInfo> mBufferInfos;
+			std::vector<VkDescriptorImageInfo> mImageInfos;
+	};
+
+	// Creates a template for sets with aLayout. The entries describe where
+	// each binding's descriptor infos (e.g. VkDescriptorImageInfo) are found
+	// in a user-defined struct. The set is then written from an instance of
+	// that struct with a single vkUpdateDescriptorSetWithTemplate() call.
+	DescriptorUpdateTemplate create_descriptor_update_template(
+		VulkanContext const&,
+		VkDescriptorSetLayout aLayout,
+		std::vector<VkDescriptorUpdateTemplateEntry> const& aEntries
+	);
+}
+
+//EOF vim:syntax=cpp:foldmethod=marker:ts=4:noexpandtab:
@@ -0,0 +1,57 @@
+#include "embedded_spirv.hpp"
+
+#include <vector>
+
+#include <cassert>
+#include <cstring>
+
+namespace labutils
+{
+	namespace
+	{
+		// Function-local static: registrations run during static
+		// initialization of other translation units.
+		std::vector<EmbeddedSpirv const*>& registry_()
+		{
+			static std::vector<EmbeddedSpirv const*> registry;
+			return registry;
+		}
+	}
+
+	EmbeddedSpirvRegistration::EmbeddedSpirvRegistration( EmbeddedSpirv const* aShaders, std::size_t aCount )
+	{
+		for( std::size_t i = 0; i < aCount; ++i )
+			registry_().emplace_back( aShaders+i );
+	}
+
+	EmbeddedSpirv const* find_embedded_spirv( char const* aPath )
+	{
+		assert( aPath );
+
+		auto const& registry = registry_();
+		if( registry.empty() )
+			return nullptr;
+
+		char const* name = aPath;
+		for( char const* ptr = aPath; *ptr; ++ptr )
+		{
+			if( '/' == *ptr || '\\' == *ptr )
+				name = ptr+1;
+		}
+
+		for( auto const* shader : registry )
+		{
+			if( 0 == std::strcmp( shader->name, name ) )
+				return shader;
+		}
+
+		return nullptr;
+	}
+
+	std::size_t embedded_spirv_count()
+	{
+		return registry_().size();
+	}
+}
+
+//EOF vim:syntax=cpp:foldmethod=marker:ts=4:noexpandtab:
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace labutils
+{
+	// SPIR-V compiled into the executable (see util/embed_spirv.lua and the
+	// --embed-shaders premake option). Generated sources register their
+	// shaders during static initialization; lookups happen by file name, so
+	// "assets/exercise4/shaders/shaderTex.vert.spv" finds the embedded
+	// "shaderTex.vert.spv" regardless of the working directory.
+	struct EmbeddedSpirv
+	{
+		char const* name; // file name without directories
+		std::uint32_t const* words;
+		std::size_t wordCount;
+	};
+
+	struct EmbeddedSpirvRegistration
+	{
+		EmbeddedSpirvRegistration( EmbeddedSpirv const*, std::size_t aCount );
+	};
+
+	// Returns the embedded shader whose name matches the file name of
+	// aPath, or nullptr.
+	EmbeddedSpirv const* find_embedded_spirv( char const* aPath );
+
+	std::size_t embedded_spirv_count();
+}
+
+//EOF vim:syntax=cpp:foldmethod=marker:ts=4:noexpandtab:
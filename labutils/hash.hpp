@@ -0,0 +1,14 @@
+#pragma once
+
+#include <cstddef>
+
+namespace labutils
+{
+	// Mixes aValue into the hash aSeed; see boost::hash_combine()
+	inline void hash_combine( std::size_t& aSeed, std::size_t aValue ) noexcept
+	{
+		aSeed ^= aValue + 0x9e3779b9 + (aSeed << 6) + (aSeed >> 2);
+	}
+}
+
+//EOF vim:syntax=cpp:foldmethod=marker:ts=4:noexpandtab:
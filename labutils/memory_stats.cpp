@@ -0,0 +1,129 @@
+#include "memory_stats.hpp"
+
+#include <algorithm>
+
+#include <cassert>
+#include <cinttypes>
+
+#include "error.hpp"
+
+namespace labutils
+{
+	MemoryStats get_memory_stats( Allocator const& aAllocator )
+	{
+		assert( VK_NULL_HANDLE != aAllocator.allocator );
+
+		VkPhysicalDeviceMemoryProperties const* memProps = nullptr;
+		vmaGetMemoryProperties( aAllocator.allocator, &memProps );
+
+		VmaBudget budgets[VK_MAX_MEMORY_HEAPS]{};
+		vmaGetHeapBudgets( aAllocator.allocator, budgets );
+
+		MemoryStats ret{};
+		for( std::uint32_t i = 0; i < memProps->memoryHeapCount; ++i )
+		{
+			auto& heap = ret.heaps.emplace_back();
+			heap.flags = memProps->memoryHeaps[i].flags;
+			heap.size = memProps->memoryHeaps[i].size;
+			heap.usage = budgets[i].usage;
+			heap.budget = budgets[i].budget;
+			heap.blockBytes = budgets[i].blockBytes;
+			heap.allocationBytes = budgets[i].allocationBytes;
+		}
+
+		if( aAllocator.categories )
+		{
+			for( std::size_t i = 0; i < kMemoryCategoryCount; ++i )
+			{
+				ret.categories[i].bytes = aAllocator.categories[i].bytes;
+				ret.categories[i].allocations = aAllocator.categories[i].allocations;
+			}
+		}
+
+		return ret;
+	}
+
+	float max_budget_fraction( MemoryStats const& aStats )
+	{
+		float ret = 0.f;
+		for( auto const& heap : aStats.heaps )
+		{
+			if( heap.budget > 0 )
+				ret = std::max( ret, float(double(heap.usage) / double(heap.budget)) );
+		}
+
+		return ret;
+	}
+
+	void print_memory_stats( std::FILE* aOut, MemoryStats const& aStats )
+	{
+		constexpr double kMiB = 1024.0 * 1024.0;
+
+		for( std::size_t i = 0; i < aStats.heaps.size(); ++i )
+		{
+			auto const& heap = aStats.heaps[i];
+
+			// Heaps that the application has not touched
+			if( 0 == heap.blockBytes && 0 == heap.usage )
+				continue;
+
+			std::fprintf( aOut, "  heap %zu (%s): %.1f of %.1f MiB budget used; VMA blocks %.1f MiB, %.1f MiB allocated\n",
+				i,
+				(heap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) ? "device" : "host",
+				heap.usage / kMiB,
+				heap.budget / kMiB,
+				heap.blockBytes / kMiB,
+				heap.allocationBytes / kMiB
+			);
+		}
+
+		for( std::size_t i = 0; i < kMemoryCategoryCount; ++i )
+		{
+			auto const& cat = aStats.categories[i];
+			std::fprintf( aOut, "  %-10s %8.2f MiB in %u allocations\n", to_string( MemoryCategory(i) ), cat.bytes / kMiB, cat.allocations );
+		}
+	}
+
+	std::string build_memory_stats_json( Allocator const& aAllocator, bool aDetailed )
+	{
+		assert( VK_NULL_HANDLE != aAllocator.allocator );
+
+		auto const stats = get_memory_stats( aAllocator );
+
+		std::string ret = "{\n\"Categories\": {";
+		for( std::size_t i = 0; i < kMemoryCategoryCount; ++i )
+		{
+			char entry[128];
+			std::snprintf( entry, sizeof(entry), "%s\n  \"%s\": { \"Bytes\": %" PRIu64 ", \"Allocations\": %u }", i ? "," : "", to_string( MemoryCategory(i) ), stats.categories[i].bytes, stats.categories[i].allocations );
+			ret += entry;
+		}
+		ret += "\n},\n\"Allocator\": ";
+
+		char* vmaJson = nullptr;
+		vmaBuildStatsString( aAllocator.allocator, &vmaJson, aDetailed ? VK_TRUE : VK_FALSE );
+		ret += vmaJson;
+		vmaFreeStatsString( aAllocator.allocator, vmaJson );
+
+		ret += "\n}\n";
+		return ret;
+	}
+
+	void write_memory_stats_json( Allocator const& aAllocator, char const* aPath, bool aDetailed )
+	{
+		assert( aPath );
+
+		auto const json = build_memory_stats_json( aAllocator, aDetailed );
+
+		std::FILE* fout = std::fopen( aPath, "wb" );
+		if( !fout )
+			throw Error( "Unable to open '%s' for writing", aPath );
+
+		auto const written = std::fwrite( json.data(), 1, json.size(), fout );
+		std::fclose( fout );
+
+		if( written != json.size() )
+			throw Error( "Unable to write memory statistics to '%s'", aPath );
+	}
+}
+
+//EOF vim:syntax=cpp:foldmethod=marker:ts=4:noexpandtab:
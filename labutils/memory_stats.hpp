@@ -0,0 +1,71 @@
+#pragma once
+
+#include <volk/volk.h>
+#include <vk_mem_alloc.h>
+
+#include <string>
+#include <vector>
+
+#include <cstdio>
+#include <cstdint>
+
+#include "allocator.hpp"
+
+namespace labutils
+{
+	// GPU memory statistics.
+	//
+	// Heap budgets come from vmaGetHeapBudgets(). With VK_EXT_memory_budget
+	// (DeviceConfig::memoryBudget), usage and budget are reported by the
+	// driver and include memory used by other processes; otherwise VMA
+	// estimates them from the heap sizes. The allocator must be told about
+	// new frames with vmaSetCurrentFrameIndex() for the driver values to be
+	// refreshed.
+	//
+	// The difference between blockBytes and allocationBytes is memory that
+	// VMA holds in VkDeviceMemory blocks but that is not used by any
+	// allocation, i.e., free space and fragmentation.
+	struct MemoryHeapStats
+	{
+		VkMemoryHeapFlags flags;
+		VkDeviceSize size;
+
+		VkDeviceSize usage;
+		VkDeviceSize budget;
+
+		VkDeviceSize blockBytes;
+		VkDeviceSize allocationBytes;
+	};
+
+	struct MemoryCategoryStats
+	{
+		std::uint64_t bytes;
+		std::uint32_t allocations;
+	};
+
+	struct MemoryStats
+	{
+		std::vector<MemoryHeapStats> heaps;
+
+		// Indexed by MemoryCategory (see set_memory_category())
+		MemoryCategoryStats categories[kMemoryCategoryCount];
+	};
+
+	// Cheap enough to call every frame
+	MemoryStats get_memory_stats( Allocator const& );
+
+	// Highest usage/budget ratio of any heap
+	float max_budget_fraction( MemoryStats const& );
+
+	void print_memory_stats( std::FILE*, MemoryStats const& );
+
+	// JSON snapshot. The "Categories" object holds the per-category usage,
+	// "Allocator" the output of vmaBuildStatsString(). With aDetailed, the
+	// latter lists every block and allocation, which shows fragmentation.
+	std::string build_memory_stats_json( Allocator const&, bool aDetailed = true );
+
+	// Writes build_memory_stats_json() to aPath
+	void write_memory_stats_json( Allocator const&, char const* aPath, bool aDetailed = true );
+}
+
+//EOF vim:syntax=cpp:foldmethod=marker:ts=4:noexpandtab:
@@ -0,0 +1,346 @@
+#include "mip_generator.hpp"
+
+#include <algorithm>
+
+#include <cassert>
+
+#include "error.hpp"
+#include "vkutil.hpp"
+#include "to_string.hpp"
+
+namespace labutils
+{
+	namespace
+	{
+		// Descriptor sets that may be pending between reset()s
+		constexpr std::uint32_t kMaxPendingSets_ = 8;
+
+		// Must match mipgen.comp
+		constexpr std::uint32_t kTileSize_ = 64;
+
+		struct PushConstants_
+		{
+			std::uint32_t levelCount;
+			std::uint32_t srgb;
+		};
+
+		ImageView create_level_view_( VulkanContext const& aContext, VkImage aImage, std::uint32_t aLevel )
+		{
+			// Storage only; the image may also have usages that the UNORM
+			// format does not support (it is created with EXTENDED_USAGE).
+			VkImageViewUsageCreateInfo usageInfo{};
+			usageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_USAGE_CREATE_INFO;
+			usageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT;
+
+			VkImageViewCreateInfo viewInfo{};
+			viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+			viewInfo.pNext = &usageInfo;
+			viewInfo.image = aImage;
+			viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+			viewInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
+			viewInfo.components = VkComponentMapping{};
+			viewInfo.subresourceRange = VkImageSubresourceRange{ VK_IMAGE_ASPECT_COLOR_BIT, aLevel, 1, 0, 1 };
+
+			VkImageView view = VK_NULL_HANDLE;
+			if( auto const res = vkCreateImageView( aContext.device, &viewInfo, nullptr, &view ); VK_SUCCESS != res )
+			{
+				throw Error( "Unable to create mip level view\n" "vkCreateImageView() returned %s", to_string(res).c_str() );
+			}
+
+			return ImageView( aContext.device, view );
+		}
+	}
+
+	MipGenerator::MipGenerator( VulkanContext const& aContext, Allocator const& aAllocator, char const* aSpirvPath )
+		: mContext( &aContext )
+	{
+		VkPhysicalDeviceProperties props;
+		vkGetPhysicalDeviceProperties( aContext.physicalDevice, &props );
+
+		// EXTENDED_USAGE images and VkImageViewUsageCreateInfo are core in
+		// Vulkan 1.1.
+		mExtendedUsage = VK_API_VERSION_MINOR(props.apiVersion) >= 1 || VK_API_VERSION_MAJOR(props.apiVersion) > 1;
+
+		VkFormatProperties formatProps;
+		vkGetPhysicalDeviceFormatProperties( aContext.physicalDevice, VK_FORMAT_R8G8B8A8_UNORM, &formatProps );
+
+		// 256 invocations per workgroup exceed the guaranteed minimum (128)
+		mStorageSupported = mExtendedUsage
+			&& (formatProps.optimalTilingFeatures & VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT)
+			&& props.limits.maxComputeWorkGroupInvocations >= 256
+			&& props.limits.maxComputeWorkGroupSize[0] >= 256
+		;
+
+		if( !mStorageSupported )
+			return;
+
+		// Descriptor set layout
+		VkDescriptorSetLayoutBinding bindings[3]{};
+		bindings[0].binding = 0;
+		bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+		bindings[0].descriptorCount = 1;
+		bindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+		bindings[1].binding = 1;
+		bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+		bindings[1].descriptorCount = kMaxLevels;
+		bindings[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+		bindings[2].binding = 2;
+		bindings[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[2].descriptorCount = 1;
+		bindings[2].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+		VkDescriptorSetLayoutCreateInfo setInfo{};
+		setInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		setInfo.bindingCount = sizeof(bindings) / sizeof(bindings[0]);
+		setInfo.pBindings = bindings;
+
+		VkDescriptorSetLayout setLayout = VK_NULL_HANDLE;
+		if( auto const res = vkCreateDescriptorSetLayout( aContext.device, &setInfo, nullptr, &setLayout ); VK_SUCCESS != res )
+		{
+			throw Error( "Unable to create descriptor set layout\n" "vkCreateDescriptorSetLayout() returned %s", to_string(res).c_str() );
+		}
+
+		mSetLayout = DescriptorSetLayout( aContext.device, setLayout );
+
+		// Pipeline layout
+		VkPushConstantRange pushRange{};
+		pushRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		pushRange.offset = 0;
+		pushRange.size = sizeof(PushConstants_);
+
+		VkPipelineLayoutCreateInfo layoutInfo{};
+		layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		layoutInfo.setLayoutCount = 1;
+		layoutInfo.pSetLayouts = &mSetLayout.handle;
+		layoutInfo.pushConstantRangeCount = 1;
+		layoutInfo.pPushConstantRanges = &pushRange;
+
+		VkPipelineLayout pipeLayout = VK_NULL_HANDLE;
+		if( auto const res = vkCreatePipelineLayout( aContext.device, &layoutInfo, nullptr, &pipeLayout ); VK_SUCCESS != res )
+		{
+			throw Error( "Unable to create pipeline layout\n" "vkCreatePipelineLayout() returned %s", to_string(res).c_str() );
+		}
+
+		mPipeLayout = PipelineLayout( aContext.device, pipeLayout );
+
+		// Pipeline
+		ShaderModule const shader = load_shader_module( aContext, aSpirvPath );
+
+		VkComputePipelineCreateInfo pipeInfo{};
+		pipeInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+		pipeInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		pipeInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+		pipeInfo.stage.module = shader.handle;
+		pipeInfo.stage.pName = "main";
+		pipeInfo.layout = mPipeLayout.handle;
+
+		VkPipeline pipe = VK_NULL_HANDLE;
+		if( auto const res = vkCreateComputePipelines( aContext.device, VK_NULL_HANDLE, 1, &pipeInfo, nullptr, &pipe ); VK_SUCCESS != res )
+		{
+			throw Error( "Unable to create mip generation pipeline\n" "vkCreateComputePipelines() returned %s", to_string(res).c_str() );
+		}
+
+		mPipeline = Pipeline( aContext.device, pipe );
+
+		// Descriptor pool
+		VkDescriptorPoolSize const pools[] = {
+			{ VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, kMaxPendingSets_ * (1+kMaxLevels) },
+			{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, kMaxPendingSets_ }
+		};
+
+		VkDescriptorPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		poolInfo.maxSets = kMaxPendingSets_;
+		poolInfo.poolSizeCount = sizeof(pools) / sizeof(pools[0]);
+		poolInfo.pPoolSizes = pools;
+
+		VkDescriptorPool pool = VK_NULL_HANDLE;
+		if( auto const res = vkCreateDescriptorPool( aContext.device, &poolInfo, nullptr, &pool ); VK_SUCCESS != res )
+		{
+			throw Error( "Unable to create descriptor pool\n" "vkCreateDescriptorPool() returned %s", to_string(res).c_str() );
+		}
+
+		mPool = DescriptorPool( aContext.device, pool );
+
+		mCounter = create_buffer( aAllocator, sizeof(std::uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_ONLY );
+	}
+
+	bool MipGenerator::supports( VkFormat aFormat, VkExtent2D const& aExtent, std::uint32_t aMipLevels ) const noexcept
+	{
+		if( !mStorageSupported )
+			return false;
+
+		if( VK_FORMAT_R8G8B8A8_UNORM != aFormat && VK_FORMAT_R8G8B8A8_SRGB != aFormat )
+			return false;
+
+		if( aExtent.width > kMaxExtent || aExtent.height > kMaxExtent )
+			return false;
+
+		return aMipLevels >= 1 && aMipLevels-1 <= kMaxLevels;
+	}
+
+	VkImageCreateFlags MipGenerator::image_flags( VkFormat aFormat ) noexcept
+	{
+		if( VK_FORMAT_R8G8B8A8_SRGB == aFormat )
+			return VK_IMAGE_CREATE_MUTABLE_FORMAT_BIT | VK_IMAGE_CREATE_EXTENDED_USAGE_BIT;
+
+		return 0;
+	}
+	VkImageUsageFlags MipGenerator::image_usage() noexcept
+	{
+		return VK_IMAGE_USAGE_STORAGE_BIT;
+	}
+
+	void MipGenerator::record( VkCommandBuffer aCmdBuff, BarrierBatch& aBarriers, VkImage aImage, VkFormat aFormat, VkExtent2D const& aExtent, std::uint32_t aMipLevels )
+	{
+		assert( supports( aFormat, aExtent, aMipLevels ) );
+
+		if( aMipLevels <= 1 )
+		{
+			aBarriers.image( aImage,
+				VK_ACCESS_TRANSFER_WRITE_BIT,
+				VK_ACCESS_SHADER_READ_BIT,
+				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+				VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+				VK_PIPELINE_STAGE_TRANSFER_BIT,
+				VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT
+			).flush( aCmdBuff );
+			return;
+		}
+
+		if( mPendingSets == kMaxPendingSets_ )
+		{
+			throw Error( "MipGenerator: more than %u pending records; call reset() after the commands have completed", kMaxPendingSets_ );
+		}
+
+		// Views: level 0 and each generated level. Unused array elements
+		// repeat the last level; the shader never accesses them.
+		auto const levels = aMipLevels - 1;
+		auto const firstView = mViews.size();
+		for( std::uint32_t level = 0; level < aMipLevels; ++level )
+			mViews.emplace_back( create_level_view_( *mContext, aImage, level ) );
+
+		VkDescriptorImageInfo sourceInfo{ VK_NULL_HANDLE, mViews[firstView].handle, VK_IMAGE_LAYOUT_GENERAL };
+
+		VkDescriptorImageInfo levelInfos[kMaxLevels];
+		for( std::uint32_t i = 0; i < kMaxLevels; ++i )
+		{
+			auto const level = std::min( i+1, levels );
+			levelInfos[i] = VkDescriptorImageInfo{ VK_NULL_HANDLE, mViews[firstView+level].handle, VK_IMAGE_LAYOUT_GENERAL };
+		}
+
+		VkDescriptorBufferInfo counterInfo{ mCounter.buffer, 0, VK_WHOLE_SIZE };
+
+		VkDescriptorSet dset = alloc_desc_set( *mContext, mPool.handle, mSetLayout.handle );
+		++mPendingSets;
+
+		VkWriteDescriptorSet writes[3]{};
+		writes[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		writes[0].dstSet = dset;
+		writes[0].dstBinding = 0;
+		writes[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+		writes[0].descriptorCount = 1;
+		writes[0].pImageInfo = &sourceInfo;
+
+		writes[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		writes[1].dstSet = dset;
+		writes[1].dstBinding = 1;
+		writes[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+		writes[1].descriptorCount = kMaxLevels;
+		writes[1].pImageInfo = levelInfos;
+
+		writes[2].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		writes[2].dstSet = dset;
+		writes[2].dstBinding = 2;
+		writes[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		writes[2].descriptorCount = 1;
+		writes[2].pBufferInfo = &counterInfo;
+
+		vkUpdateDescriptorSets( mContext->device, sizeof(writes) / sizeof(writes[0]), writes, 0, nullptr );
+
+		// The counter starts at zero; afterwards, each dispatch leaves it at
+		// zero for the next one.
+		if( !mCounterCleared )
+		{
+			vkCmdFillBuffer( aCmdBuff, mCounter.buffer, 0, VK_WHOLE_SIZE, 0 );
+			mCounterCleared = true;
+
+			aBarriers.buffer( mCounter.buffer,
+				VK_ACCESS_TRANSFER_WRITE_BIT,
+				VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+				VK_PIPELINE_STAGE_TRANSFER_BIT,
+				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT
+			);
+		}
+		else
+		{
+			aBarriers.buffer( mCounter.buffer,
+				VK_ACCESS_SHADER_WRITE_BIT,
+				VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT
+			);
+		}
+
+		aBarriers
+			.image( aImage,
+				VK_ACCESS_TRANSFER_WRITE_BIT,
+				VK_ACCESS_SHADER_READ_BIT,
+				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+				VK_IMAGE_LAYOUT_GENERAL,
+				VK_PIPELINE_STAGE_TRANSFER_BIT,
+				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+				VkImageSubresourceRange{ VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 }
+			)
+			.image( aImage,
+				0,
+				VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+				VK_IMAGE_LAYOUT_UNDEFINED,
+				VK_IMAGE_LAYOUT_GENERAL,
+				VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+				VkImageSubresourceRange{ VK_IMAGE_ASPECT_COLOR_BIT, 1, levels, 0, 1 }
+			)
+			.flush( aCmdBuff );
+
+		PushConstants_ const push{ levels, VK_FORMAT_R8G8B8A8_SRGB == aFormat ? 1u : 0u };
+
+		vkCmdBindPipeline( aCmdBuff, VK_PIPELINE_BIND_POINT_COMPUTE, mPipeline.handle );
+		vkCmdBindDescriptorSets( aCmdBuff, VK_PIPELINE_BIND_POINT_COMPUTE, mPipeLayout.handle, 0, 1, &dset, 0, nullptr );
+		vkCmdPushConstants( aCmdBuff, mPipeLayout.handle, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push), &push );
+
+		vkCmdDispatch( aCmdBuff,
+			(aExtent.width + kTileSize_-1) / kTileSize_,
+			(aExtent.height + kTileSize_-1) / kTileSize_,
+			1
+		);
+
+		aBarriers.image( aImage,
+			VK_ACCESS_SHADER_WRITE_BIT,
+			VK_ACCESS_SHADER_READ_BIT,
+			VK_IMAGE_LAYOUT_GENERAL,
+			VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+			VkImageSubresourceRange{ VK_IMAGE_ASPECT_COLOR_BIT, 0, aMipLevels, 0, 1 }
+		).flush( aCmdBuff );
+	}
+
+	void MipGenerator::reset()
+	{
+		if( VK_NULL_HANDLE != mPool.handle )
+		{
+			if( auto const res = vkResetDescriptorPool( mContext->device, mPool.handle, 0 ); VK_SUCCESS != res )
+			{
+				throw Error( "Unable to reset descriptor pool\n" "vkResetDescriptorPool() returned %s", to_string(res).c_str() );
+			}
+		}
+
+		mPendingSets = 0;
+		mViews.clear();
+	}
+}
+
+//EOF vim:syntax=cpp:foldmethod=marker:ts=4:noexpandtab:
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <volk/volk.h>
+
+#include <vector>
+
+#include <cstdint>
+
+#include "vkobject.hpp"
+#include "vkbuffer.hpp"
+#include "allocator.hpp"
+#include "barrier_batch.hpp"
+#include "vulkan_context.hpp"
+
+namespace labutils
+{
+	// Per-texture results of mip generation (see load_image_texture2d())
+	struct MipGenerationStats
+	{
+		bool compute = false; // false: vkCmdBlitImage() chain
+
+		// Pipeline barrier commands recorded for mip generation
+		std::uint32_t barrierCalls = 0;
+
+		// GPU time from the end of the level 0 upload to the end of mip
+		// generation, if the queue supports timestamps
+		bool haveGpuTime = false;
+		double gpuMs = 0.0;
+	};
+
+	// Single pass compute mip generation.
+	//
+	// One dispatch generates up to kMaxLevels levels below level 0. The
+	// compute shader (exercise4/shaders/mipgen.comp) reduces 64x64 tiles of
+	// level 0 to 1x1 in shared memory; the last workgroup to finish reduces
+	// the remaining levels. Compared to a chain of blits, there are no
+	// barriers between levels.
+	//
+	// Only RGBA8 images are supported. The image is written through UNORM
+	// storage views, so sRGB images must be created with the flags and usage
+	// returned by image_flags() and image_usage(). The shader converts sRGB
+	// data to linear and back, i.e., filtering is sRGB correct.
+	//
+	// Descriptor sets and views are kept for each record() until reset(),
+	// which must only be called once the recorded commands have completed.
+	class MipGenerator final
+	{
+		public:
+			static constexpr std::uint32_t kMaxLevels = 12;
+
+			// Level 6 of larger images does not fit the single 64x64 tile
+			// that the last workgroup reduces.
+			static constexpr std::uint32_t kMaxExtent = 4096;
+
+		public:
+			MipGenerator( VulkanContext const&, Allocator const&, char const* aSpirvPath );
+
+			MipGenerator( MipGenerator const& ) = delete;
+			MipGenerator& operator= (MipGenerator const&) = delete;
+
+		public:
+			// False if the device cannot write the format through a storage
+			// view, or if the image is larger than kMaxExtent or has too many
+			// levels. Use a blit chain then.
+			bool supports( VkFormat, VkExtent2D const&, std::uint32_t aMipLevels ) const noexcept;
+
+			static VkImageCreateFlags image_flags( VkFormat ) noexcept;
+			static VkImageUsageFlags image_usage() noexcept;
+
+			// Expects level 0 to be in VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			// written by a transfer; the contents of the other levels are
+			// discarded. Leaves all levels in SHADER_READ_ONLY_OPTIMAL, ready
+			// for sampling in fragment shaders. Barriers are recorded through
+			// aBarriers.
+			void record( VkCommandBuffer, BarrierBatch& aBarriers, VkImage, VkFormat, VkExtent2D const&, std::uint32_t aMipLevels );
+
+			void reset();
+
+		private:
+			VulkanContext const* mContext;
+
+			bool mStorageSupported = false;
+			bool mExtendedUsage = false; // Vulkan 1.1
+
+			DescriptorSetLayout mSetLayout;
+			PipelineLayout mPipeLayout;
+			Pipeline mPipeline;
+
+			DescriptorPool mPool;
+			std::uint32_t mPendingSets = 0;
+			std::vector<ImageView> mViews;
+
+			// Workgroups that have finished; the last one resets it to zero
+			Buffer mCounter;
+			bool mCounterCleared = false;
+	};
+}
+
+//EOF vim:syntax=cpp:foldmethod=marker:ts=4:noexpandtab:
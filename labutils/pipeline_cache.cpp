@@ -0,0 +1,178 @@
+#include "pipeline_cache.hpp"
+
+#include <string>
+#include <vector>
+#include <system_error>
+#include <filesystem>
+
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <cassert>
+
+#include "error.hpp"
+#include "to_string.hpp"
+
+namespace labutils
+{
+	namespace
+	{
+		constexpr char kFileMagic[4] = { 'L', 'U', 'P', 'C' };
+		constexpr std::uint32_t kFileVersion = 1;
+
+		struct FileHeader_
+		{
+			char magic[4];
+			std::uint32_t version;
+			std::uint64_t coldCreateUs; // microseconds
+			std::uint64_t dataSize;
+		};
+
+		bool read_file_( char const* aPath, std::vector<std::uint8_t>& aData )
+		{
+			std::FILE* fin = std::fopen( aPath, "rb" );
+			if( !fin )
+				return false;
+
+			std::fseek( fin, 0, SEEK_END );
+			auto const bytes = std::ftell( fin );
+			std::fseek( fin, 0, SEEK_SET );
+
+			if( bytes < 0 )
+			{
+				std::fclose( fin );
+				return false;
+			}
+
+			aData.resize( std::size_t(bytes) );
+			auto const read = std::fread( aData.data(), 1, aData.size(), fin );
+			std::fclose( fin );
+
+			return read == aData.size();
+		}
+
+		bool matches_device_( VulkanContext const& aContext, std::uint8_t const* aData, std::size_t aSize )
+		{
+			VkPipelineCacheHeaderVersionOne header;
+			if( aSize < sizeof(header) )
+				return false;
+
+			std::memcpy( &header, aData, sizeof(header) );
+
+			if( header.headerSize < sizeof(header) || header.headerSize > aSize )
+				return false;
+			if( VK_PIPELINE_CACHE_HEADER_VERSION_ONE != header.headerVersion )
+				return false;
+
+			VkPhysicalDeviceProperties props;
+			vkGetPhysicalDeviceProperties( aContext.physicalDevice, &props );
+
+			return header.vendorID == props.vendorID
+				&& header.deviceID == props.deviceID
+				&& 0 == std::memcmp( header.pipelineCacheUUID, props.pipelineCacheUUID, VK_UUID_SIZE )
+			;
+		}
+	}
+
+	PipelineCache create_pipeline_cache( VulkanContext const& aContext, char const* aPath, PipelineCacheSeed* aSeed )
+	{
+		assert( aPath );
+
+		PipelineCacheSeed seed;
+
+		// Load and validate the file. Any problem results in an empty cache;
+		// a stale or foreign cache is not an error.
+		std::vector<std::uint8_t> file;
+		std::uint8_t const* data = nullptr;
+
+		if( read_file_( aPath, file ) && file.size() >= sizeof(FileHeader_) )
+		{
+			FileHeader_ header;
+			std::memcpy( &header, file.data(), sizeof(header) );
+
+			auto const available = file.size() - sizeof(header);
+
+			if( 0 == std::memcmp( header.magic, kFileMagic, sizeof(kFileMagic) )
+				&& kFileVersion == header.version
+				&& header.dataSize == available
+				&& matches_device_( aContext, file.data() + sizeof(header), available ) )
+			{
+				data = file.data() + sizeof(header);
+
+				seed.seeded = true;
+				seed.bytes = available;
+				seed.coldCreateMs = header.coldCreateUs / 1000.0;
+			}
+		}
+
+		VkPipelineCacheCreateInfo cacheInfo{};
+		cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+		cacheInfo.initialDataSize = seed.bytes;
+		cacheInfo.pInitialData = data;
+
+		VkPipelineCache cache = VK_NULL_HANDLE;
+		if( auto const res = vkCreatePipelineCache( aContext.device, &cacheInfo, nullptr, &cache ); VK_SUCCESS != res )
+		{
+			throw Error( "Unable to create pipeline cache\n" "vkCreatePipelineCache() returned %s", to_string(res).c_str() );
+		}
+
+		if( aSeed )
+			*aSeed = seed;
+
+		return PipelineCache( aContext.device, cache );
+	}
+
+	void save_pipeline_cache( VulkanContext const& aContext, VkPipelineCache aCache, char const* aPath, double aColdCreateMs )
+	{
+		assert( VK_NULL_HANDLE != aCache );
+		assert( aPath );
+
+		std::size_t size = 0;
+		if( auto const res = vkGetPipelineCacheData( aContext.device, aCache, &size, nullptr ); VK_SUCCESS != res )
+		{
+			throw Error( "Unable to query pipeline cache size\n" "vkGetPipelineCacheData() returned %s", to_string(res).c_str() );
+		}
+
+		std::vector<std::uint8_t> data( size );
+		if( auto const res = vkGetPipelineCacheData( aContext.device, aCache, &size, data.data() ); VK_SUCCESS != res && VK_INCOMPLETE != res )
+		{
+			throw Error( "Unable to retrieve pipeline cache data\n" "vkGetPipelineCacheData() returned %s", to_string(res).c_str() );
+		}
+
+		FileHeader_ header{};
+		std::memcpy( header.magic, kFileMagic, sizeof(kFileMagic) );
+		header.version = kFileVersion;
+		header.coldCreateUs = std::uint64_t(aColdCreateMs * 1000.0);
+		header.dataSize = size;
+
+		// Write to a temporary file next to the destination, then rename.
+		std::string const tempPath = std::string(aPath) + ".tmp";
+
+		std::FILE* fout = std::fopen( tempPath.c_str(), "wb" );
+		if( !fout )
+			throw Error( "Cannot open '%s' for writing", tempPath.c_str() );
+
+		bool ok = 1 == std::fwrite( &header, sizeof(header), 1, fout );
+		ok = ok && size == std::fwrite( data.data(), 1, size, fout );
+		ok = (0 == std::fflush( fout )) && ok;
+		ok = (0 == std::fclose( fout )) && ok;
+
+		if( !ok )
+		{
+			std::remove( tempPath.c_str() );
+			throw Error( "Error writing pipeline cache to '%s'", tempPath.c_str() );
+		}
+
+		// std::filesystem::rename() replaces an existing destination on all
+		// platforms (unlike std::rename() on Windows).
+		std::error_code ec;
+		std::filesystem::rename( tempPath, aPath, ec );
+		if( ec )
+		{
+			std::remove( tempPath.c_str() );
+			throw Error( "Unable to replace '%s' with '%s': %s", aPath, tempPath.c_str(), ec.message().c_str() );
+		}
+	}
+}
+
+//EOF vim:syntax=cpp:foldmethod=marker:ts=4:noexpandtab:
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <volk/volk.h>
+
+#include <cstddef>
+
+#include "vkobject.hpp"
+#include "vulkan_context.hpp"
+
+namespace labutils
+{
+	// Persistent pipeline cache.
+	//
+	// The file holds a small header followed by the data returned by
+	// vkGetPipelineCacheData(). Besides a magic number, the header records
+	// how long pipeline creation took without a cache, such that later runs
+	// can report the time saved.
+	//
+	// Cache data is only used if its Vulkan header matches the device, i.e.,
+	// if vendorID, deviceID and pipelineCacheUUID are identical. Otherwise
+	// (and if the file is missing or malformed) an empty cache is created.
+	struct PipelineCacheSeed
+	{
+		bool seeded = false; // true if the cache was initialized from the file
+		std::size_t bytes = 0; // size of the cache data from the file
+
+		// Pipeline creation time recorded in the file (only if seeded)
+		double coldCreateMs = 0.0;
+	};
+
+	PipelineCache create_pipeline_cache( VulkanContext const&, char const* aPath, PipelineCacheSeed* = nullptr );
+
+	// Writes the cache contents to aPath. The data is first written to a
+	// temporary file, which then replaces aPath. An interrupted write thus
+	// never leaves a truncated cache behind.
+	//
+	// aColdCreateMs is the pipeline creation time without a cache that is
+	// stored in the file header.
+	void save_pipeline_cache( VulkanContext const&, VkPipelineCache, char const* aPath, double aColdCreateMs );
+}
+
+//EOF vim:syntax=cpp:foldmethod=marker:ts=4:noexpandtab:
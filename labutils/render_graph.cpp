@@ -0,0 +1,559 @@
+#include "render_graph.hpp"
+
+#include <utility>
+#include <algorithm>
+
+#include <cassert>
+
+#include "error.hpp"
+#include "to_string.hpp"
+
+namespace labutils
+{
+	namespace
+	{
+		constexpr VkAccessFlags kWriteAccess_ = VK_ACCESS_SHADER_WRITE_BIT
+			| VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT
+			| VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT
+			| VK_ACCESS_TRANSFER_WRITE_BIT
+			| VK_ACCESS_HOST_WRITE_BIT
+			| VK_ACCESS_MEMORY_WRITE_BIT
+		;
+	}
+
+	// Tracked while planning barriers. writeStages/writeAccess is the last
+	// write (or layout transition); readStages/readAccess are the reads
+	// since, which the write has been made visible to. writeStages is zero
+	// if there is nothing that readers need to wait for.
+	struct RenderGraph::State_
+	{
+		VkImageLayout layout;
+
+		VkPipelineStageFlags writeStages;
+		VkAccessFlags writeAccess;
+
+		VkPipelineStageFlags readStages;
+		VkAccessFlags readAccess;
+	};
+
+	auto RenderGraph::Pass::read( Resource aResource, ResourceUse const& aUse ) -> Pass&
+	{
+		mUses.emplace_back( Use_{ aResource, aUse, false } );
+		return *this;
+	}
+	auto RenderGraph::Pass::write( Resource aResource, ResourceUse const& aUse ) -> Pass&
+	{
+		mUses.emplace_back( Use_{ aResource, aUse, true } );
+		return *this;
+	}
+	auto RenderGraph::Pass::side_effects() -> Pass&
+	{
+		mSideEffects = true;
+		return *this;
+	}
+
+
+	RenderGraph::RenderGraph( VulkanContext const& aContext, Allocator const& aAllocator )
+		: mContext( &aContext )
+		, mAllocator( &aAllocator )
+	{}
+
+	RenderGraph::~RenderGraph()
+	{
+		mViews.clear();
+
+		for( auto const& res : mResources )
+		{
+			if( res.transient && VK_NULL_HANDLE != res.image )
+				vkDestroyImage( mContext->device, res.image, nullptr );
+		}
+
+		for( auto const alloc : mMemory )
+		{
+			release_memory_category( mAllocator->allocator, alloc );
+			vmaFreeMemory( mAllocator->allocator, alloc );
+		}
+	}
+
+	auto RenderGraph::import_image( char const* aName, VkImageAspectFlags aAspect, ResourceUse const& aPrevious, std::optional<ResourceUse> aExport ) -> Resource
+	{
+		assert( !mCompiled );
+
+		Resource_ res{};
+		res.name = aName;
+		res.isImage = true;
+		res.aspect = aAspect;
+		res.previous = aPrevious;
+		res.exported = aExport;
+
+		mResources.emplace_back( std::move(res) );
+		return Resource(mResources.size()-1);
+	}
+	auto RenderGraph::import_buffer( char const* aName, ResourceUse const& aPrevious, std::optional<ResourceUse> aExport ) -> Resource
+	{
+		assert( !mCompiled );
+
+		Resource_ res{};
+		res.name = aName;
+		res.isImage = false;
+		res.previous = aPrevious;
+		res.exported = aExport;
+
+		mResources.emplace_back( std::move(res) );
+		return Resource(mResources.size()-1);
+	}
+
+	auto RenderGraph::create_image( char const* aName, TransientImageDesc const& aDesc ) -> Resource
+	{
+		assert( !mCompiled );
+
+		Resource_ res{};
+		res.name = aName;
+		res.isImage = true;
+		res.aspect = aDesc.aspect;
+		res.previous = ResourceUse{ 0, 0, VK_IMAGE_LAYOUT_UNDEFINED };
+		res.transient = true;
+		res.desc = aDesc;
+
+		mResources.emplace_back( std::move(res) );
+		return Resource(mResources.size()-1);
+	}
+
+	auto RenderGraph::add_pass( char const* aName, ExecuteFn aExecute ) -> Pass&
+	{
+		assert( !mCompiled );
+
+		auto& pass = mPasses.emplace_back();
+		pass.mName = aName;
+		pass.mExecute = std::move(aExecute);
+		return pass;
+	}
+
+	void RenderGraph::compile()
+	{
+		assert( !mCompiled );
+
+		std::vector<bool> alive;
+		cull_( alive );
+
+		for( std::size_t i = 0; i < mPasses.size(); ++i )
+		{
+			if( alive[i] )
+				mOrder.emplace_back( i );
+		}
+
+		mStats.passes = std::uint32_t(mOrder.size());
+		mStats.culledPasses = std::uint32_t(mPasses.size() - mOrder.size());
+
+		create_transients_();
+		plan_barriers_();
+
+		for( auto const& batch : mBarriers )
+		{
+			if( batch.empty() )
+				continue;
+
+			++mStats.barrierBatches;
+			for( auto const& barrier : batch )
+			{
+				if( mResources[barrier.resource].isImage )
+					++mStats.imageBarriers;
+				else
+					++mStats.bufferBarriers;
+			}
+		}
+
+		mCompiled = true;
+	}
+
+	void RenderGraph::set_image( Resource aResource, VkImage aImage )
+	{
+		assert( aResource < mResources.size() );
+		assert( mResources[aResource].isImage && !mResources[aResource].transient );
+		mResources[aResource].image = aImage;
+	}
+	void RenderGraph::set_buffer( Resource aResource, VkBuffer aBuffer )
+	{
+		assert( aResource < mResources.size() );
+		assert( !mResources[aResource].isImage );
+		mResources[aResource].buffer = aBuffer;
+	}
+
+	VkImage RenderGraph::image( Resource aResource ) const
+	{
+		assert( aResource < mResources.size() );
+		return mResources[aResource].image;
+	}
+	VkImageView RenderGraph::image_view( Resource aResource ) const
+	{
+		assert( aResource < mViews.size() );
+		return mViews[aResource].handle;
+	}
+
+	void RenderGraph::execute( VkCommandBuffer aCmdBuff ) const
+	{
+		assert( mCompiled );
+		assert( mBarriers.size() == mOrder.size()+1 );
+
+		BarrierBatch batch( *mContext );
+
+		for( std::size_t i = 0; i < mOrder.size(); ++i )
+		{
+			record_barriers_( batch, mBarriers[i] );
+			batch.flush( aCmdBuff );
+
+			mPasses[mOrder[i]].mExecute( aCmdBuff );
+		}
+
+		record_barriers_( batch, mBarriers.back() );
+		batch.flush( aCmdBuff );
+	}
+
+	auto RenderGraph::stats() const noexcept -> Stats const&
+	{
+		return mStats;
+	}
+
+	void RenderGraph::cull_( std::vector<bool>& aAlive ) const
+	{
+		// Walk backwards: a pass is needed if it writes something that is
+		// exported or read by a later pass that is needed.
+		std::vector<bool> needed( mResources.size(), false );
+		for( std::size_t i = 0; i < mResources.size(); ++i )
+			needed[i] = mResources[i].exported.has_value();
+
+		aAlive.assign( mPasses.size(), false );
+		for( std::size_t i = mPasses.size(); i-- > 0; )
+		{
+			auto const& pass = mPasses[i];
+
+			bool keep = pass.mSideEffects;
+			for( auto const& use : pass.mUses )
+			{
+				if( use.write && needed[use.resource] )
+					keep = true;
+			}
+
+			if( !keep )
+				continue;
+
+			aAlive[i] = true;
+			for( auto const& use : pass.mUses )
+			{
+				if( !use.write )
+					needed[use.resource] = true;
+			}
+		}
+	}
+
+	void RenderGraph::create_transients_()
+	{
+		// Lifetime of each transient image, as positions in mOrder
+		constexpr auto kUnused = ~std::size_t(0);
+		std::vector<std::pair<std::size_t,std::size_t>> lifetimes( mResources.size(), { kUnused, 0 } );
+
+		for( std::size_t i = 0; i < mOrder.size(); ++i )
+		{
+			for( auto const& use : mPasses[mOrder[i]].mUses )
+			{
+				auto& life = lifetimes[use.resource];
+				if( kUnused == life.first )
+					life.first = i;
+				life.second = i;
+			}
+		}
+
+		// Create images first; their memory requirements decide the sharing
+		std::vector<Resource> transients;
+		std::vector<VkMemoryRequirements> reqs( mResources.size() );
+
+		for( Resource i = 0; i < mResources.size(); ++i )
+		{
+			auto& res = mResources[i];
+			if( !res.transient || kUnused == lifetimes[i].first )
+				continue;
+
+			VkImageCreateInfo imageInfo{};
+			imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+			imageInfo.imageType = VK_IMAGE_TYPE_2D;
+			imageInfo.format = res.desc.format;
+			imageInfo.extent = VkExtent3D{ res.desc.extent.width, res.desc.extent.height, 1 };
+			imageInfo.mipLevels = 1;
+			imageInfo.arrayLayers = 1;
+			imageInfo.samples = res.desc.samples;
+			imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+			imageInfo.usage = res.desc.usage;
+			imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+			imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+			if( auto const err = vkCreateImage( mContext->device, &imageInfo, nullptr, &res.image ); VK_SUCCESS != err )
+			{
+				throw Error( "Unable to create transient image '%s'\n" "vkCreateImage() returned %s", res.name.c_str(), to_string(err).c_str() );
+			}
+
+			vkGetImageMemoryRequirements( mContext->device, res.image, &reqs[i] );
+			transients.emplace_back( i );
+
+			++mStats.transientImages;
+			mStats.transientBytes += reqs[i].size;
+		}
+
+		// Assign the largest images first. An image joins the first memory
+		// slot that is compatible and whose occupants are all dead by the
+		// time it is first used, or all born after it was last used.
+		std::stable_sort( transients.begin(), transients.end(), [&] (Resource aA, Resource aB) {
+			return reqs[aA].size > reqs[aB].size;
+		} );
+
+		struct Slot
+		{
+			VkMemoryRequirements reqs;
+			std::vector<Resource> occupants;
+		};
+		std::vector<Slot> slots;
+
+		for( auto const i : transients )
+		{
+			auto const& life = lifetimes[i];
+
+			auto const fits = [&] (Slot const& aSlot) {
+				if( 0 == (aSlot.reqs.memoryTypeBits & reqs[i].memoryTypeBits) )
+					return false;
+
+				for( auto const other : aSlot.occupants )
+				{
+					auto const& otherLife = lifetimes[other];
+					if( life.first <= otherLife.second && otherLife.first <= life.second )
+						return false;
+				}
+
+				return true;
+			};
+
+			auto slot = std::find_if( slots.begin(), slots.end(), fits );
+			if( slots.end() == slot )
+			{
+				slots.emplace_back( Slot{ reqs[i], {} } );
+				slot = std::prev( slots.end() );
+			}
+			else
+			{
+				slot->reqs.size = std::max( slot->reqs.size, reqs[i].size );
+				slot->reqs.alignment = std::max( slot->reqs.alignment, reqs[i].alignment );
+				slot->reqs.memoryTypeBits &= reqs[i].memoryTypeBits;
+			}
+
+			slot->occupants.emplace_back( i );
+		}
+
+		// One allocation per slot. All occupants are bound at offset zero.
+		mViews.resize( mResources.size() );
+
+		for( auto& slot : slots )
+		{
+			VmaAllocationCreateInfo allocInfo{};
+			allocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+
+			VmaAllocation alloc = VK_NULL_HANDLE;
+			if( auto const err = vmaAllocateMemory( mAllocator->allocator, &slot.reqs, &allocInfo, &alloc, nullptr ); VK_SUCCESS != err )
+			{
+				throw Error( "Unable to allocate %llu bytes for transient images\n" "vmaAllocateMemory() returned %s", (unsigned long long)slot.reqs.size, to_string(err).c_str() );
+			}
+
+			mMemory.emplace_back( alloc );
+			set_memory_category( *mAllocator, alloc, MemoryCategory::attachment );
+			mStats.transientMemory += slot.reqs.size;
+
+			// Occupants in the order in which they are used. Each one has to
+			// wait for the one before; the first for the last one of the
+			// previous execution.
+			std::sort( slot.occupants.begin(), slot.occupants.end(), [&] (Resource aA, Resource aB) {
+				return lifetimes[aA].first < lifetimes[aB].first;
+			} );
+
+			for( std::size_t j = 0; j < slot.occupants.size(); ++j )
+			{
+				auto const i = slot.occupants[j];
+				auto& res = mResources[i];
+
+				res.memory = mMemory.size()-1;
+				res.predecessor = slot.occupants[(j + slot.occupants.size() - 1) % slot.occupants.size()];
+
+				if( auto const err = vmaBindImageMemory( mAllocator->allocator, alloc, res.image ); VK_SUCCESS != err )
+				{
+					throw Error( "Unable to bind transient image '%s'\n" "vmaBindImageMemory() returned %s", res.name.c_str(), to_string(err).c_str() );
+				}
+
+				VkImageViewCreateInfo viewInfo{};
+				viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+				viewInfo.image = res.image;
+				viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+				viewInfo.format = res.desc.format;
+				viewInfo.subresourceRange = VkImageSubresourceRange{ res.aspect, 0, 1, 0, 1 };
+
+				VkImageView view = VK_NULL_HANDLE;
+				if( auto const err = vkCreateImageView( mContext->device, &viewInfo, nullptr, &view ); VK_SUCCESS != err )
+				{
+					throw Error( "Unable to create view for transient image '%s'\n" "vkCreateImageView() returned %s", res.name.c_str(), to_string(err).c_str() );
+				}
+
+				mViews[i] = ImageView( mContext->device, view );
+			}
+		}
+	}
+
+	void RenderGraph::plan_barriers_()
+	{
+		std::vector<State_> states( mResources.size() );
+		for( std::size_t i = 0; i < mResources.size(); ++i )
+		{
+			auto const& prev = mResources[i].previous;
+			auto const written = 0 != (prev.access & kWriteAccess_);
+
+			states[i] = State_{
+				prev.layout,
+				written ? prev.stages : 0, prev.access & kWriteAccess_,
+				prev.stages, prev.access & ~kWriteAccess_
+			};
+		}
+
+		// Location of the barrier before the first use of each transient
+		// image. Its source scope is filled in once the last use of the
+		// predecessor is known.
+		std::vector<std::pair<std::size_t,std::size_t>> firstBarrier( mResources.size(), { ~std::size_t(0), 0 } );
+
+		mBarriers.assign( mOrder.size()+1, {} );
+
+		for( std::size_t i = 0; i < mOrder.size(); ++i )
+		{
+			auto& batch = mBarriers[i];
+
+			// A pass may declare several uses of the same resource; these
+			// are combined, since barriers within a batch are not ordered
+			// with respect to each other.
+			std::vector<Pass::Use_> uses;
+			for( auto const& use : mPasses[mOrder[i]].mUses )
+			{
+				auto const it = std::find_if( uses.begin(), uses.end(), [&] (Pass::Use_ const& aUse) {
+					return aUse.resource == use.resource;
+				} );
+
+				if( uses.end() == it )
+				{
+					uses.emplace_back( use );
+					continue;
+				}
+
+				assert( !mResources[use.resource].isImage || it->use.layout == use.use.layout );
+				it->use.stages |= use.use.stages;
+				it->use.access |= use.use.access;
+				it->write = it->write || use.write;
+			}
+
+			for( auto const& use : uses )
+			{
+				auto const& res = mResources[use.resource];
+				bool const first = res.transient && ~std::size_t(0) == firstBarrier[use.resource].first;
+
+				if( plan_use_( states[use.resource], res, use.resource, use.use, use.write || first, batch ) && first )
+					firstBarrier[use.resource] = { i, batch.size()-1 };
+			}
+		}
+
+		// Exported resources are left in their final state
+		for( Resource i = 0; i < mResources.size(); ++i )
+		{
+			if( auto const& exported = mResources[i].exported )
+				plan_use_( states[i], mResources[i], i, *exported, false, mBarriers.back() );
+		}
+
+		for( Resource i = 0; i < mResources.size(); ++i )
+		{
+			if( ~std::size_t(0) == firstBarrier[i].first )
+				continue;
+
+			auto const& pred = states[mResources[i].predecessor];
+			auto& barrier = mBarriers[firstBarrier[i].first][firstBarrier[i].second];
+
+			barrier.srcStages = pred.writeStages | pred.readStages;
+			barrier.srcAccess = pred.writeAccess;
+			barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED; // contents are discarded
+		}
+	}
+
+	bool RenderGraph::plan_use_( State_& aState, Resource_ const& aRes, Resource aResource, ResourceUse const& aUse, bool aWrite, Barriers_& aBarriers )
+	{
+		bool const transition = aRes.isImage && aState.layout != aUse.layout;
+
+		if( aWrite || transition )
+		{
+			// Write-after-write and write-after-read hazards. Layout
+			// transitions count as writes.
+			aBarriers.emplace_back( Barrier_{
+				aResource,
+				aState.writeStages | aState.readStages, aUse.stages,
+				aState.writeAccess, aUse.access,
+				aState.layout, aRes.isImage ? aUse.layout : VK_IMAGE_LAYOUT_UNDEFINED
+			} );
+
+			// Later readers in other stages wait for the transition by
+			// waiting for these stages.
+			if( aWrite )
+				aState = State_{ aUse.layout, aUse.stages, aUse.access & kWriteAccess_, 0, 0 };
+			else
+				aState = State_{ aUse.layout, aUse.stages, 0, aUse.stages, aUse.access };
+
+			return true;
+		}
+
+		// Read-after-read needs no barrier, unless the last write has not
+		// yet been made visible to these stages.
+		bool const covered = 0 == (aUse.stages & ~aState.readStages) && 0 == (aUse.access & ~aState.readAccess);
+		bool const emit = 0 != aState.writeStages && !covered;
+
+		if( emit )
+		{
+			aBarriers.emplace_back( Barrier_{
+				aResource,
+				aState.writeStages, aUse.stages,
+				aState.writeAccess, aUse.access,
+				aState.layout, aState.layout
+			} );
+		}
+
+		aState.readStages |= aUse.stages;
+		aState.readAccess |= aUse.access;
+		return emit;
+	}
+
+	void RenderGraph::record_barriers_( BarrierBatch& aBatch, Barriers_ const& aBarriers ) const
+	{
+		for( auto const& barrier : aBarriers )
+		{
+			auto const& res = mResources[barrier.resource];
+
+			if( res.isImage )
+			{
+				assert( VK_NULL_HANDLE != res.image );
+
+				aBatch.image( res.image,
+					barrier.srcAccess, barrier.dstAccess,
+					barrier.oldLayout, barrier.newLayout,
+					barrier.srcStages, barrier.dstStages,
+					VkImageSubresourceRange{ res.aspect, 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS }
+				);
+			}
+			else
+			{
+				assert( VK_NULL_HANDLE != res.buffer );
+
+				aBatch.buffer( res.buffer,
+					barrier.srcAccess, barrier.dstAccess,
+					barrier.srcStages, barrier.dstStages
+				);
+			}
+		}
+	}
+}
+
+//EOF vim:syntax=cpp:foldmethod=marker:ts=4:noexpandtab:
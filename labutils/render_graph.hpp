@@ -0,0 +1,217 @@
+#pragma once
+
+#include <volk/volk.h>
+#include <vk_mem_alloc.h>
+
+#include <string>
+#include <vector>
+#include <optional>
+#include <functional>
+
+#include <cstdint>
+
+#include "vkobject.hpp"
+#include "allocator.hpp"
+#include "barrier_batch.hpp"
+#include "vulkan_context.hpp"
+
+namespace labutils
+{
+	// How a pass accesses a resource: the pipeline stages, the access types
+	// and, for images, the layout that the image must be in.
+	struct ResourceUse
+	{
+		VkPipelineStageFlags stages;
+		VkAccessFlags access;
+		VkImageLayout layout;
+	};
+
+	// Common uses
+	constexpr ResourceUse kUseTransferRead{ VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL };
+	constexpr ResourceUse kUseTransferWrite{ VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL };
+	constexpr ResourceUse kUseUniformRead{ VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_UNIFORM_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED };
+	constexpr ResourceUse kUseSampledRead{ VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+	constexpr ResourceUse kUseColorAttachment{ VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+	constexpr ResourceUse kUseDepthAttachment{ VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL };
+	constexpr ResourceUse kUsePresent{ VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR };
+
+	// Image that is created and owned by a RenderGraph
+	struct TransientImageDesc
+	{
+		VkFormat format;
+		VkExtent2D extent;
+		VkImageUsageFlags usage;
+		VkImageAspectFlags aspect = VK_IMAGE_ASPECT_COLOR_BIT;
+		VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+	};
+
+	// Frame graph.
+	//
+	// Passes declare the resources they read and write, together with how
+	// they use them (ResourceUse). compile() then
+	//  - culls passes whose results are never used: a pass is kept if it has
+	//    side effects, or if it writes a resource that is exported or read by
+	//    a pass that is kept;
+	//  - plans the barriers before each pass. Barriers are only placed where
+	//    a hazard exists (a write, or a layout change, or a read that the last
+	//    write has not been made visible to yet), and all barriers before a
+	//    pass are issued with a single vkCmdPipelineBarrier();
+	//  - creates the transient images. Images whose lifetimes (first to last
+	//    pass that uses them) do not overlap share the same memory.
+	//
+	// Imported resources are owned elsewhere. Their handles may change
+	// between executions (e.g. the current swap chain image). aPrevious
+	// describes the last use before the graph runs, typically by the
+	// previous frame or by whatever signals the semaphore that the frame
+	// waits on. Exported resources are left in the given final state
+	// after the last pass; other resources are left as the last pass used
+	// them.
+	//
+	// The graph is compiled once and executed each frame; passes read their
+	// per-frame inputs when executed. Transient images are synchronized
+	// against their use by the previous execution, so executions must be
+	// submitted to the same queue.
+	class RenderGraph final
+	{
+		public:
+			using Resource = std::uint32_t;
+			using ExecuteFn = std::function<void(VkCommandBuffer)>;
+
+			class Pass
+			{
+				public:
+					Pass& read( Resource, ResourceUse const& );
+					Pass& write( Resource, ResourceUse const& );
+
+					// Never culled (e.g. writes to host-visible memory)
+					Pass& side_effects();
+
+				private:
+					friend class RenderGraph;
+
+					struct Use_
+					{
+						Resource resource;
+						ResourceUse use;
+						bool write;
+					};
+
+					std::string mName;
+					ExecuteFn mExecute;
+					std::vector<Use_> mUses;
+					bool mSideEffects = false;
+			};
+
+			struct Stats
+			{
+				std::uint32_t passes = 0;
+				std::uint32_t culledPasses = 0;
+
+				// Per execution
+				std::uint32_t barrierBatches = 0;
+				std::uint32_t imageBarriers = 0;
+				std::uint32_t bufferBarriers = 0;
+
+				// Transient images, the sum of their sizes, and the memory that
+				// they actually occupy after aliasing
+				std::uint32_t transientImages = 0;
+				VkDeviceSize transientBytes = 0;
+				VkDeviceSize transientMemory = 0;
+			};
+
+		public:
+			RenderGraph( VulkanContext const&, Allocator const& );
+			~RenderGraph();
+
+			RenderGraph( RenderGraph const& ) = delete;
+			RenderGraph& operator= (RenderGraph const&) = delete;
+
+		public:
+			Resource import_image( char const* aName, VkImageAspectFlags, ResourceUse const& aPrevious, std::optional<ResourceUse> aExport = {} );
+			Resource import_buffer( char const* aName, ResourceUse const& aPrevious, std::optional<ResourceUse> aExport = {} );
+
+			Resource create_image( char const* aName, TransientImageDesc const& );
+
+			// The reference is valid until the next add_pass()
+			Pass& add_pass( char const* aName, ExecuteFn );
+
+			void compile();
+
+			// Handles of imported resources; set before execute()
+			void set_image( Resource, VkImage );
+			void set_buffer( Resource, VkBuffer );
+
+			// Transient images exist once the graph has been compiled
+			VkImage image( Resource ) const;
+			VkImageView image_view( Resource ) const;
+
+			// Records all passes that were not culled, with their barriers
+			void execute( VkCommandBuffer ) const;
+
+			Stats const& stats() const noexcept;
+
+		private:
+			struct Resource_
+			{
+				std::string name;
+				bool isImage;
+				VkImageAspectFlags aspect;
+
+				ResourceUse previous;
+				std::optional<ResourceUse> exported;
+
+				// Transient images only: the allocation that the image is bound
+				// to, and the image that used this memory before it (itself,
+				// in the previous execution, if the memory is not shared).
+				bool transient;
+				TransientImageDesc desc;
+				std::size_t memory;
+				Resource predecessor;
+
+				VkImage image;
+				VkBuffer buffer;
+			};
+
+			struct Barrier_
+			{
+				Resource resource;
+
+				VkPipelineStageFlags srcStages, dstStages;
+				VkAccessFlags srcAccess, dstAccess;
+				VkImageLayout oldLayout, newLayout;
+			};
+
+			// Barriers issued together (see BarrierBatch)
+			using Barriers_ = std::vector<Barrier_>;
+
+			struct State_;
+
+			void cull_( std::vector<bool>& aAlive ) const;
+			void create_transients_();
+			void plan_barriers_();
+
+			static bool plan_use_( State_&, Resource_ const&, Resource, ResourceUse const&, bool aWrite, Barriers_& );
+
+			void record_barriers_( BarrierBatch&, Barriers_ const& ) const;
+
+		private:
+			VulkanContext const* mContext;
+			Allocator const* mAllocator;
+
+			std::vector<Resource_> mResources;
+			std::vector<Pass> mPasses;
+
+			bool mCompiled = false;
+			std::vector<std::size_t> mOrder; // passes that are kept
+			// Barriers before each kept pass, plus those after the last one
+			std::vector<Barriers_> mBarriers;
+
+			// Transient images and the allocations that they are bound to
+			std::vector<VmaAllocation> mMemory;
+			std::vector<ImageView> mViews; // indexed like mResources
+
+			Stats mStats;
+	};
+}
+
+//EOF vim:syntax=cpp:foldmethod=marker:ts=4:noexpandtab:
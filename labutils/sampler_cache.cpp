@@ -0,0 +1,131 @@
+#include "sampler_cache.hpp"
+
+#include <cassert>
+#include <cstring>
+
+#include "hash.hpp"
+#include "error.hpp"
+#include "to_string.hpp"
+
+namespace labutils
+{
+	namespace
+	{
+		// Keys hash and compare the bit patterns of floats, so that equal
+		// keys always hash equally (0.f and -0.f are different keys, and a
+		// NaN equals itself).
+		std::size_t float_bits_( float aValue )
+		{
+			std::uint32_t bits;
+			std::memcpy( &bits, &aValue, sizeof(bits) );
+			return bits;
+		}
+	}
+
+	SamplerCache::SamplerCache( VulkanContext const& aContext )
+		: mContext( &aContext )
+	{
+		VkPhysicalDeviceProperties props;
+		vkGetPhysicalDeviceProperties( aContext.physicalDevice, &props );
+
+		mMaxCount = props.limits.maxSamplerAllocationCount;
+	}
+
+	VkSampler SamplerCache::get( VkSamplerCreateInfo const& aInfo )
+	{
+		assert( VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO == aInfo.sType );
+		assert( !aInfo.pNext );
+
+		Key_ const key{
+			aInfo.flags,
+			aInfo.magFilter, aInfo.minFilter,
+			aInfo.mipmapMode,
+			aInfo.addressModeU, aInfo.addressModeV, aInfo.addressModeW,
+			aInfo.mipLodBias,
+			aInfo.anisotropyEnable,
+			aInfo.maxAnisotropy,
+			aInfo.compareEnable,
+			aInfo.compareOp,
+			aInfo.minLod, aInfo.maxLod,
+			aInfo.borderColor,
+			aInfo.unnormalizedCoordinates
+		};
+
+		std::lock_guard<std::mutex> lock( mMutex );
+
+		if( auto const it = mSamplers.find( key ); mSamplers.end() != it )
+		{
+			++mHits;
+			return it->second.handle;
+		}
+
+		if( mSamplers.size() >= mMaxCount )
+			throw Error( "Unable to create sampler: %zu samplers exist, the device limit is %u", mSamplers.size(), mMaxCount );
+
+		VkSampler sampler = VK_NULL_HANDLE;
+		if( auto const res = vkCreateSampler( mContext->device, &aInfo, nullptr, &sampler ); VK_SUCCESS != res )
+		{
+			throw Error( "Unable to create sampler\n" "vkCreateSampler() returned %s", to_string(res).c_str() );
+		}
+
+		return mSamplers.emplace( key, Sampler( mContext->device, sampler ) ).first->second.handle;
+	}
+
+	std::size_t SamplerCache::live_count() const
+	{
+		std::lock_guard<std::mutex> lock( mMutex );
+		return mSamplers.size();
+	}
+
+	std::size_t SamplerCache::hit_count() const
+	{
+		std::lock_guard<std::mutex> lock( mMutex );
+		return mHits;
+	}
+
+	std::uint32_t SamplerCache::max_count() const noexcept
+	{
+		return mMaxCount;
+	}
+}
+
+namespace labutils
+{
+	bool SamplerCache::Key_::operator== (Key_ const& aOther) const noexcept
+	{
+		return flags == aOther.flags
+			&& magFilter == aOther.magFilter
+			&& minFilter == aOther.minFilter
+			&& mipmapMode == aOther.mipmapMode
+			&& addressModeU == aOther.addressModeU
+			&& addressModeV == aOther.addressModeV
+			&& addressModeW == aOther.addressModeW
+			&& float_bits_( mipLodBias ) == float_bits_( aOther.mipLodBias )
+			&& anisotropyEnable == aOther.anisotropyEnable
+			&& float_bits_( maxAnisotropy ) == float_bits_( aOther.maxAnisotropy )
+			&& compareEnable == aOther.compareEnable
+			&& compareOp == aOther.compareOp
+			&& float_bits_( minLod ) == float_bits_( aOther.minLod )
+			&& float_bits_( maxLod ) == float_bits_( aOther.maxLod )
+			&& borderColor == aOther.borderColor
+			&& unnormalizedCoordinates == aOther.unnormalizedCoordinates
+		;
+	}
+
+	std::size_t SamplerCache::KeyHash_::operator() (Key_ const& aKey) const noexcept
+	{
+		std::size_t ret = std::size_t(aKey.flags);
+		hash_combine( ret, std::size_t(aKey.magFilter) | std::size_t(aKey.minFilter) << 4 | std::size_t(aKey.mipmapMode) << 8 );
+		hash_combine( ret, std::size_t(aKey.addressModeU) | std::size_t(aKey.addressModeV) << 4 | std::size_t(aKey.addressModeW) << 8 );
+		hash_combine( ret, float_bits_( aKey.mipLodBias ) );
+		hash_combine( ret, std::size_t(aKey.anisotropyEnable) | std::size_t(aKey.compareEnable) << 1 | std::size_t(aKey.unnormalizedCoordinates) << 2 );
+		hash_combine( ret, float_bits_( aKey.maxAnisotropy ) );
+		hash_combine( ret, std::size_t(aKey.compareOp) );
+		hash_combine( ret, float_bits_( aKey.minLod ) );
+		hash_combine( ret, float_bits_( aKey.maxLod ) );
+		hash_combine( ret, std::size_t(aKey.borderColor) );
+		return ret;
+	}
+}
+
+//EOF vim:syntax=cpp:foldmethod=marker:ts=4:noexpandtab:
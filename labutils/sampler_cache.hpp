@@ -0,0 +1,85 @@
+#pragma once
+
+#include <volk/volk.h>
+
+#include <mutex>
+#include <unordered_map>
+
+#include <cstdint>
+#include <cstddef>
+
+#include "vkobject.hpp"
+#include "vulkan_context.hpp"
+
+namespace labutils
+{
+	// Sampler cache.
+	//
+	// Samplers are looked up by the contents of their VkSamplerCreateInfo.
+	// Requests with identical parameters share a single VkSampler, so
+	// materials can ask for any filter and address modes without creating
+	// duplicates. Drivers limit the number of samplers that may exist at
+	// once (maxSamplerAllocationCount, as low as 4000); live_count() tracks
+	// how many the cache holds, and get() throws rather than exceeding the
+	// limit.
+	//
+	// Samplers are owned by the cache and remain valid until it is
+	// destroyed. The cache may be used from several threads at once.
+	class SamplerCache final
+	{
+		public:
+			explicit SamplerCache( VulkanContext const& );
+
+			SamplerCache( SamplerCache const& ) = delete;
+			SamplerCache& operator= (SamplerCache const&) = delete;
+
+		public:
+			// aInfo.pNext must be null (extension structures are not part
+			// of the key).
+			VkSampler get( VkSamplerCreateInfo const& aInfo );
+
+			// Number of distinct samplers created by the cache
+			std::size_t live_count() const;
+
+			// Number of get() calls that returned an existing sampler
+			std::size_t hit_count() const;
+
+			// The device's maxSamplerAllocationCount
+			std::uint32_t max_count() const noexcept;
+
+		private:
+			// VkSamplerCreateInfo without sType and pNext
+			struct Key_
+			{
+				VkSamplerCreateFlags flags;
+				VkFilter magFilter, minFilter;
+				VkSamplerMipmapMode mipmapMode;
+				VkSamplerAddressMode addressModeU, addressModeV, addressModeW;
+				float mipLodBias;
+				VkBool32 anisotropyEnable;
+				float maxAnisotropy;
+				VkBool32 compareEnable;
+				VkCompareOp compareOp;
+				float minLod, maxLod;
+				VkBorderColor borderColor;
+				VkBool32 unnormalizedCoordinates;
+
+				bool operator== (Key_ const&) const noexcept;
+			};
+
+			struct KeyHash_
+			{
+				std::size_t operator() (Key_ const&) const noexcept;
+			};
+
+		private:
+			VulkanContext const* mContext;
+			std::uint32_t mMaxCount = 0;
+
+			mutable std::mutex mMutex;
+			std::unordered_map<Key_, Sampler, KeyHash_> mSamplers;
+			std::size_t mHits = 0;
+	};
+}
+
+//EOF vim:syntax=cpp:foldmethod=marker:ts=4:noexpandtab:
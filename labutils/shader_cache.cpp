@@ -0,0 +1,266 @@
+#include "shader_cache.hpp"
+
+#include <iterator>
+#include <algorithm>
+#include <system_error>
+
+#include <cassert>
+#include <cstddef>
+
+#if defined(_WIN32)
+#	if !defined(WIN32_LEAN_AND_MEAN)
+#		define WIN32_LEAN_AND_MEAN
+#	endif
+#	if !defined(NOMINMAX)
+#		define NOMINMAX
+#	endif
+#	include <windows.h>
+#else
+#	include <fcntl.h>
+#	include <unistd.h>
+#	include <sys/mman.h>
+#	include <sys/stat.h>
+#endif
+
+#include "error.hpp"
+#include "to_string.hpp"
+#include "embedded_spirv.hpp"
+
+namespace labutils
+{
+	namespace
+	{
+		// Read-only mapping of a whole file
+		class MappedFile_ final
+		{
+			public:
+				explicit MappedFile_( char const* aPath );
+				~MappedFile_();
+
+				MappedFile_( MappedFile_ const& ) = delete;
+				MappedFile_& operator= (MappedFile_ const&) = delete;
+
+			public:
+				void const* data = nullptr;
+				std::size_t size = 0;
+
+#			if defined(_WIN32)
+			private:
+				HANDLE mFile = INVALID_HANDLE_VALUE;
+				HANDLE mMapping = nullptr;
+#			endif
+		};
+
+#		if defined(_WIN32)
+		MappedFile_::MappedFile_( char const* aPath )
+		{
+			mFile = CreateFileA( aPath, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr );
+			if( INVALID_HANDLE_VALUE == mFile )
+				throw Error( "Cannot open '%s' for reading", aPath );
+
+			LARGE_INTEGER fileSize;
+			if( !GetFileSizeEx( mFile, &fileSize ) )
+			{
+				CloseHandle( mFile );
+				throw Error( "Unable to determine size of '%s'", aPath );
+			}
+
+			size = std::size_t(fileSize.QuadPart);
+			if( 0 == size )
+				return;
+
+			mMapping = CreateFileMappingA( mFile, nullptr, PAGE_READONLY, 0, 0, nullptr );
+			if( mMapping )
+				data = MapViewOfFile( mMapping, FILE_MAP_READ, 0, 0, 0 );
+
+			if( !data )
+			{
+				if( mMapping )
+					CloseHandle( mMapping );
+				CloseHandle( mFile );
+				throw Error( "Unable to map '%s'", aPath );
+			}
+		}
+		MappedFile_::~MappedFile_()
+		{
+			if( data )
+				UnmapViewOfFile( data );
+			if( mMapping )
+				CloseHandle( mMapping );
+			if( INVALID_HANDLE_VALUE != mFile )
+				CloseHandle( mFile );
+		}
+#		else // POSIX
+		MappedFile_::MappedFile_( char const* aPath )
+		{
+			int const fd = ::open( aPath, O_RDONLY );
+			if( -1 == fd )
+				throw Error( "Cannot open '%s' for reading", aPath );
+
+			struct stat st;
+			if( 0 != ::fstat( fd, &st ) )
+			{
+				::close( fd );
+				throw Error( "Unable to determine size of '%s'", aPath );
+			}
+
+			size = std::size_t(st.st_size);
+			if( 0 == size )
+			{
+				::close( fd );
+				return;
+			}
+
+			void* const ptr = ::mmap( nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0 );
+			::close( fd ); // the mapping remains valid
+
+			if( MAP_FAILED == ptr )
+				throw Error( "Unable to map '%s'", aPath );
+
+			data = ptr;
+		}
+		MappedFile_::~MappedFile_()
+		{
+			if( data )
+				::munmap( const_cast<void*>(data), size );
+		}
+#		endif // ~ platform
+
+		// 64-bit FNV-1a, processing four bytes (one SPIR-V word) at a time
+		std::uint64_t hash_words_( std::uint32_t const* aWords, std::size_t aCount )
+		{
+			std::uint64_t hash = 14695981039346656037ull;
+			for( std::size_t i = 0; i < aCount; ++i )
+			{
+				hash ^= aWords[i];
+				hash *= 1099511628211ull;
+			}
+			return hash;
+		}
+	}
+
+	ShaderModuleCache::ShaderModuleCache( VulkanContext const& aContext )
+		: mContext( &aContext )
+		, mByHash( std::make_shared<HashIndex_>() )
+	{}
+
+	std::shared_ptr<ShaderModule const> ShaderModuleCache::get( char const* aSpirvPath )
+	{
+		assert( aSpirvPath );
+
+		namespace fs = std::filesystem;
+
+		// Embedded shaders never change and need no file access
+		if( auto const* embedded = find_embedded_spirv( aSpirvPath ) )
+			return get_embedded_( aSpirvPath, *embedded );
+
+		std::error_code sizeEc, timeEc;
+		auto const size = fs::file_size( aSpirvPath, sizeEc );
+		auto const modified = fs::last_write_time( aSpirvPath, timeEc );
+		if( auto const& ec = sizeEc ? sizeEc : timeEc )
+			throw Error( "Cannot open '%s' for reading: %s", aSpirvPath, ec.message().c_str() );
+
+		std::lock_guard<std::mutex> lock( mMutex );
+
+		auto& entry = mByPath[aSpirvPath];
+		if( entry.module && entry.size == size && entry.modified == modified )
+			return entry.module;
+
+		// (Re-)load the file. The mapping is only needed while the module is
+		// created.
+		MappedFile_ const file( aSpirvPath );
+		++mFileLoads;
+
+		// SPIR-V consists of a number of 32-bit = 4 byte words 
+		if( 0 == file.size || 0 != file.size % 4 )
+			throw Error( "'%s' is not a valid SPIR-V file (size %zu)", aSpirvPath, file.size );
+
+		auto module = find_or_create_( aSpirvPath, static_cast<std::uint32_t const*>(file.data), file.size / 4 );
+
+		entry.size = size;
+		entry.modified = modified;
+		entry.module = module;
+
+		return module;
+	}
+
+	std::shared_ptr<ShaderModule const> ShaderModuleCache::get_embedded_( char const* aSpirvPath, EmbeddedSpirv const& aEmbedded )
+	{
+		std::lock_guard<std::mutex> lock( mMutex );
+
+		auto& entry = mByPath[aSpirvPath];
+		if( !entry.module )
+		{
+			entry.size = 0;
+			entry.modified = {};
+			entry.module = find_or_create_( aSpirvPath, aEmbedded.words, aEmbedded.wordCount );
+		}
+
+		return entry.module;
+	}
+
+	std::shared_ptr<ShaderModule const> ShaderModuleCache::find_or_create_( char const* aSpirvPath, std::uint32_t const* aWords, std::size_t aWordCount )
+	{
+		auto const hash = hash_words_( aWords, aWordCount );
+
+		{
+			// No module reference may be dropped while the index is locked:
+			// dropping the last one runs the deleter below, which locks the
+			// index as well.
+			std::lock_guard<std::mutex> indexLock( mByHash->mutex );
+
+			auto const [begin, end] = mByHash->entries.equal_range( hash );
+			for( auto it = begin; it != end; ++it )
+			{
+				auto const& words = it->second.words;
+				if( words.size() != aWordCount || !std::equal( words.begin(), words.end(), aWords ) )
+					continue;
+
+				if( auto module = it->second.module.lock() )
+					return module;
+			}
+		}
+
+		VkShaderModuleCreateInfo moduleInfo{};
+		moduleInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+		moduleInfo.codeSize = aWordCount * sizeof(std::uint32_t);
+		moduleInfo.pCode = aWords;
+
+		VkShaderModule smod = VK_NULL_HANDLE;
+		if( auto const res = vkCreateShaderModule( mContext->device, &moduleInfo, nullptr, &smod ); VK_SUCCESS != res )
+		{
+			throw Error( "Unable to create shader module from %s\n" "vkCreateShaderModule() returned %s", aSpirvPath, to_string(res).c_str() );
+		}
+
+		// Removes the module's (now expired) entry from the index
+		std::weak_ptr<HashIndex_> const index = mByHash;
+		auto const release_ = [index, hash] ( ShaderModule const* aModule ) {
+			if( auto const idx = index.lock() )
+			{
+				std::lock_guard<std::mutex> indexLock( idx->mutex );
+
+				auto const [begin, end] = idx->entries.equal_range( hash );
+				for( auto it = begin; it != end; )
+					it = it->second.module.expired() ? idx->entries.erase( it ) : std::next( it );
+			}
+
+			delete aModule;
+		};
+
+		std::shared_ptr<ShaderModule const> module( new ShaderModule( mContext->device, smod ), release_ );
+
+		HashEntry_ entry{ std::vector<std::uint32_t>( aWords, aWords + aWordCount ), module };
+
+		std::lock_guard<std::mutex> indexLock( mByHash->mutex );
+		mByHash->entries.emplace( hash, std::move(entry) );
+		return module;
+	}
+
+	std::size_t ShaderModuleCache::file_loads() const
+	{
+		std::lock_guard<std::mutex> lock( mMutex );
+		return mFileLoads;
+	}
+}
+
+//EOF vim:syntax=cpp:foldmethod=marker:ts=4:noexpandtab:
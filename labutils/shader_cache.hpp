@@ -0,0 +1,91 @@
+#pragma once
+
+#include <volk/volk.h>
+
+#include <mutex>
+#include <memory>
+#include <string>
+#include <vector>
+#include <filesystem>
+#include <unordered_map>
+
+#include <cstdint>
+
+#include "vkobject.hpp"
+#include "embedded_spirv.hpp"
+#include "vulkan_context.hpp"
+
+namespace labutils
+{
+	// Shader module cache.
+	//
+	// Shaders embedded into the executable (see embedded_spirv.hpp) are used
+	// without accessing the file system. Other SPIR-V files are memory
+	// mapped and the mapping is passed directly to vkCreateShaderModule().
+	// Modules are keyed by path and by a hash of the file contents:
+	//  - a path whose size and modification time are unchanged returns the
+	//    cached module without touching the file,
+	//  - a modified file is mapped and hashed again; if the contents match
+	//    a live module (e.g., the same binary under another path, or a file
+	//    that was rewritten with identical contents), that module is shared.
+	//    The cache keeps a copy of each live module's words, such that files
+	//    whose hashes collide are told apart.
+	//
+	// Modules are reference counted. The cache keeps the current module of
+	// each path alive; modules replaced because their file changed are
+	// destroyed once the last user releases them.
+	//
+	// The cache may be used from several threads at once.
+	class ShaderModuleCache final
+	{
+		public:
+			explicit ShaderModuleCache( VulkanContext const& );
+
+			ShaderModuleCache( ShaderModuleCache const& ) = delete;
+			ShaderModuleCache& operator= (ShaderModuleCache const&) = delete;
+
+		public:
+			std::shared_ptr<ShaderModule const> get( char const* aSpirvPath );
+
+			// Number of files mapped (and modules looked up by hash) so far
+			std::size_t file_loads() const;
+
+		private:
+			struct PathEntry_
+			{
+				std::uintmax_t size;
+				std::filesystem::file_time_type modified;
+				std::shared_ptr<ShaderModule const> module;
+			};
+
+			std::shared_ptr<ShaderModule const> get_embedded_( char const*, EmbeddedSpirv const& );
+
+			// Expects mMutex to be locked by the caller
+			std::shared_ptr<ShaderModule const> find_or_create_( char const*, std::uint32_t const*, std::size_t );
+
+			struct HashEntry_
+			{
+				std::vector<std::uint32_t> words;
+				std::weak_ptr<ShaderModule const> module;
+			};
+
+			// Live modules by content hash. A module's entry is removed when
+			// the module is destroyed, which may happen after the cache is
+			// gone; hence the separate, shared state.
+			struct HashIndex_
+			{
+				std::mutex mutex;
+				std::unordered_multimap<std::uint64_t, HashEntry_> entries;
+			};
+
+		private:
+			VulkanContext const* mContext;
+
+			mutable std::mutex mMutex;
+			std::unordered_map<std::string, PathEntry_> mByPath;
+			std::shared_ptr<HashIndex_> mByHash;
+			std::size_t mFileLoads = 0;
+	};
+}
+
+//EOF vim:syntax=cpp:foldmethod=marker:ts=4:noexpandtab:
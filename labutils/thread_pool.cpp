@@ -0,0 +1,134 @@
+#include "thread_pool.hpp"
+
+#include <memory>
+#include <utility>
+#include <algorithm>
+
+#include <cassert>
+
+namespace labutils
+{
+	ThreadPool::ThreadPool( std::size_t aThreadCount )
+	{
+		if( 0 == aThreadCount )
+		{
+			auto const hw = std::thread::hardware_concurrency();
+			aThreadCount = hw > 1 ? hw-1 : 1;
+		}
+
+		mThreads.reserve( aThreadCount );
+		for( std::size_t i = 0; i < aThreadCount; ++i )
+			mThreads.emplace_back( [this] { worker_(); } );
+	}
+
+	ThreadPool::~ThreadPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock( mMutex );
+			mStop = true;
+		}
+
+		mWake.notify_all();
+
+		for( auto& thread : mThreads )
+			thread.join();
+	}
+
+	std::size_t ThreadPool::thread_count() const noexcept
+	{
+		return mThreads.size();
+	}
+
+	void ThreadPool::parallel_for( std::size_t aCount, std::size_t aGrain, std::function<void(std::size_t,std::size_t)> const& aFunc )
+	{
+		if( 0 == aCount )
+			return;
+
+		aGrain = std::max<std::size_t>( aGrain, 1 );
+		std::size_t const chunks = (aCount + aGrain - 1) / aGrain;
+
+		if( 1 == chunks || mThreads.empty() )
+		{
+			aFunc( 0, aCount );
+			return;
+		}
+
+		// Shared between the caller and the helpers. Helpers may start after
+		// the caller has already finished all chunks (e.g., if the workers are
+		// busy), so the state must outlive this call.
+		struct State_
+		{
+			std::function<void(std::size_t,std::size_t)> func;
+			std::size_t count, grain, chunks;
+			std::atomic<std::size_t> next{ 0 };
+			std::atomic<std::size_t> done{ 0 };
+
+			std::mutex mutex;
+			std::condition_variable finished;
+		};
+
+		auto state = std::make_shared<State_>();
+		state->func = aFunc;
+		state->count = aCount;
+		state->grain = aGrain;
+		state->chunks = chunks;
+
+		auto run = [] ( State_& aState ) {
+			for( std::size_t chunk; (chunk = aState.next.fetch_add( 1 )) < aState.chunks; )
+			{
+				auto const beg = chunk * aState.grain;
+				auto const end = std::min( beg + aState.grain, aState.count );
+				aState.func( beg, end );
+
+				if( aState.done.fetch_add( 1 ) + 1 == aState.chunks )
+				{
+					std::lock_guard<std::mutex> lock( aState.mutex );
+					aState.finished.notify_all();
+				}
+			}
+		};
+
+		std::size_t const helpers = std::min( mThreads.size(), chunks-1 );
+		for( std::size_t i = 0; i < helpers; ++i )
+			enqueue_( [state, run] { run( *state ); } );
+
+		run( *state );
+
+		std::unique_lock<std::mutex> lock( state->mutex );
+		state->finished.wait( lock, [&state] { return state->done.load() == state->chunks; } );
+	}
+
+	void ThreadPool::enqueue_( std::function<void()> aTask )
+	{
+		{
+			std::lock_guard<std::mutex> lock( mMutex );
+			assert( !mStop );
+			mQueue.emplace_back( std::move(aTask) );
+		}
+
+		mWake.notify_one();
+	}
+
+	void ThreadPool::worker_()
+	{
+		for( ;; )
+		{
+			std::function<void()> task;
+
+			{
+				std::unique_lock<std::mutex> lock( mMutex );
+				mWake.wait( lock, [this] { return mStop || !mQueue.empty(); } );
+
+				if( mStop && mQueue.empty() )
+					return;
+
+				task = std::move( mQueue.front() );
+				mQueue.pop_front();
+			}
+
+			task();
+		}
+	}
+}
+
+//EOF vim:syntax=cpp:foldmethod=marker:ts=4:noexpandtab:
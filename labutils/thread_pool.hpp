@@ -0,0 +1,66 @@
+#pragma once
+
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <future>
+#include <thread>
+#include <vector>
+#include <functional>
+#include <type_traits>
+#include <condition_variable>
+
+#include <cstddef>
+
+namespace labutils
+{
+	// Small fixed-size worker pool. Work is either submitted as individual
+	// tasks (submit(), which returns a std::future) or split into ranges with
+	// parallel_for().
+	//
+	// parallel_for() is meant for per-frame work: the calling thread takes
+	// part in processing the ranges, so it is safe to call it from inside a
+	// task that is itself running on the pool.
+	class ThreadPool final
+	{
+		public:
+			// aThreadCount = 0 picks std::thread::hardware_concurrency()-1
+			// workers (the calling thread is expected to do work as well).
+			explicit ThreadPool( std::size_t aThreadCount = 0 );
+			~ThreadPool();
+
+			ThreadPool( ThreadPool const& ) = delete;
+			ThreadPool& operator= (ThreadPool const&) = delete;
+
+		public:
+			std::size_t thread_count() const noexcept;
+
+			template< typename tFunc >
+			auto submit( tFunc&& ) -> std::future<std::invoke_result_t<std::decay_t<tFunc>>>;
+
+			// Calls aFunc( begin, end ) for consecutive ranges of at most
+			// aGrain elements that together cover [0, aCount). Returns once all
+			// ranges have been processed.
+			void parallel_for(
+				std::size_t aCount,
+				std::size_t aGrain,
+				std::function<void(std::size_t,std::size_t)> const& aFunc
+			);
+
+		private:
+			void enqueue_( std::function<void()> );
+			void worker_();
+
+		private:
+			std::vector<std::thread> mThreads;
+
+			std::mutex mMutex;
+			std::condition_variable mWake;
+			std::deque<std::function<void()>> mQueue;
+			bool mStop = false;
+	};
+}
+
+#include "thread_pool.inl"
+
+//EOF vim:syntax=cpp:foldmethod=marker:ts=4:noexpandtab:
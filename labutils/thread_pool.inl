@@ -0,0 +1,20 @@
+#include <memory>
+
+namespace labutils
+{
+	template< typename tFunc >
+	inline
+	auto ThreadPool::submit( tFunc&& aFunc ) -> std::future<std::invoke_result_t<std::decay_t<tFunc>>>
+	{
+		using Result_ = std::invoke_result_t<std::decay_t<tFunc>>;
+
+		// std::function<> requires a copyable target, std::packaged_task<> is
+		// move-only. Hence the shared_ptr.
+		auto task = std::make_shared<std::packaged_task<Result_()>>( std::forward<tFunc>(aFunc) );
+		auto ret = task->get_future();
+
+		enqueue_( [task] { (*task)(); } );
+
+		return ret;
+	}
+}
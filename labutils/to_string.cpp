@@ -120,6 +120,30 @@ namespace labutils
 	}
 
 
+	std::string to_string( VkPresentModeKHR aMode )
+	{
+		// See
+		// https://www.khronos.org/registry/vulkan/specs/1.2-extensions/man/html/VkPresentModeKHR.html
+		switch( aMode )
+		{
+#			define CASE_(x) case VK_PRESENT_MODE_##x##_KHR: return #x
+			CASE_(IMMEDIATE);
+			CASE_(MAILBOX);
+			CASE_(FIFO);
+			CASE_(FIFO_RELAXED);
+			CASE_(SHARED_DEMAND_REFRESH);
+			CASE_(SHARED_CONTINUOUS_REFRESH);
+#			undef CASE_
+
+			case VK_PRESENT_MODE_MAX_ENUM_KHR: break;
+		}
+
+		// Handle other values gracefully.
+		std::ostringstream oss;
+		oss << "VkPresentModeKHR(" << std::underlying_type_t<VkPresentModeKHR>(aMode) << ")";
+		return oss.str();
+	}
+
 	std::string queue_flags( VkQueueFlags aFlags )
 	{
 		std::ostringstream oss;
@@ -11,6 +11,7 @@ namespace labutils
 	std::string to_string( VkResult );
 	std::string to_string( VkPhysicalDeviceType );
 	std::string to_string( VkDebugUtilsMessageSeverityFlagBitsEXT );
+	std::string to_string( VkPresentModeKHR );
 
 	std::string queue_flags( VkQueueFlags );
 	std::string message_type_flags( VkDebugUtilsMessageTypeFlagsEXT );
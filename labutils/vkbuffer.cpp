@@ -17,6 +17,7 @@ namespace labutils
 		{
 			assert( VK_NULL_HANDLE != mAllocator );
 			assert( VK_NULL_HANDLE != allocation );
+			release_memory_category( mAllocator, allocation );
 			vmaDestroyBuffer( mAllocator, buffer, allocation );
 		}
 	}
@@ -60,7 +61,25 @@ namespace labutils
 		{
 			throw Error("Unable to allocate buffer.\n" "vmaCreateBuffer() returned %s", to_string(res).c_str());
 		} 
+
+		set_memory_category( aAllocator, allocation, buffer_memory_category( aBufferUsage, aMemoryUsage ) );
 			
 		return Buffer(aAllocator.allocator, buffer, allocation);
 	}
 }
+
+namespace labutils
+{
+	MemoryCategory buffer_memory_category( VkBufferUsageFlags aBufferUsage, VmaMemoryUsage aMemoryUsage )
+	{
+		if( aBufferUsage & (VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT) )
+			return MemoryCategory::geometry;
+
+		// Host-visible buffers that are only copied from or to
+		bool const transferOnly = 0 == (aBufferUsage & ~(VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT));
+		if( transferOnly && VMA_MEMORY_USAGE_GPU_ONLY != aMemoryUsage )
+			return MemoryCategory::staging;
+
+		return MemoryCategory::other;
+	}
+}
@@ -32,5 +32,9 @@ namespace labutils
 			VmaAllocator mAllocator = VK_NULL_HANDLE;
 	};
 
+	// The buffer's memory category is derived from its usage (see
+	// buffer_memory_category()).
 	Buffer create_buffer( Allocator const&, VkDeviceSize, VkBufferUsageFlags, VmaMemoryUsage );
+
+	MemoryCategory buffer_memory_category( VkBufferUsageFlags, VmaMemoryUsage );
 }
@@ -1,5 +1,6 @@
 #include "vkimage.hpp"
 
+#include <limits>
 #include <vector>
 #include <utility>
 #include <algorithm>
@@ -12,6 +13,8 @@
 
 #include "error.hpp"
 #include "vkutil.hpp"
+#include "barrier_batch.hpp"
+#include "mip_generator.hpp"
 #include "vkbuffer.hpp"
 #include "to_string.hpp"
 
@@ -54,6 +57,7 @@ namespace labutils
 		{
 			assert( VK_NULL_HANDLE != mAllocator );
 			assert( VK_NULL_HANDLE != allocation );
+			release_memory_category( mAllocator, allocation );
 			vmaDestroyImage( mAllocator, image, allocation );
 		}
 	}
@@ -80,7 +84,7 @@ namespace labutils
 
 namespace labutils
 {
-	Image load_image_texture2d( char const* aPattern, VulkanContext const& aContext, VkCommandPool aCmdPool, Allocator const& aAllocator )
+	Image load_image_texture2d( char const* aPattern, VulkanContext const& aContext, VkCommandPool aCmdPool, Allocator const& aAllocator, VkImageCreateInfo* aCreateInfo, MipGenerator* aMipGenerator, MipGenerationStats* aMipStats )
 	{
 		// Figure out name of the base image. It corresponds to mipmap level 0. 
 		char baseName[4096]; 
@@ -104,7 +108,74 @@ namespace labutils
 					
 		auto const mipLevels = compute_mip_level_count(baseWidth, baseHeight);
 
-		Image ret = create_image_texture2d(aAllocator, baseWidth, baseHeight, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
+		auto const format = VK_FORMAT_R8G8B8A8_SRGB;
+
+		// Compute mip generation writes the levels through storage views.
+		// The blit chain needs the format to support blits.
+		bool const computeMips = aMipGenerator && aMipGenerator->supports(format, VkExtent2D{ baseWidth, baseHeight }, mipLevels);
+
+		VkFilter blitFilter = VK_FILTER_LINEAR;
+		if (!computeMips && mipLevels > 1)
+		{
+			VkFormatProperties props;
+			vkGetPhysicalDeviceFormatProperties(aContext.physicalDevice, format, &props);
+
+			auto const blitFeatures = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT;
+			if (blitFeatures != (props.optimalTilingFeatures & blitFeatures))
+			{
+				throw Error("%s: format %d supports neither storage nor blits; unable to generate mip levels", baseName, int(format));
+			}
+
+			if (!(props.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT))
+				blitFilter = VK_FILTER_NEAREST;
+		}
+
+		auto usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+		VkImageCreateFlags flags = 0;
+		if (computeMips)
+		{
+			usage |= MipGenerator::image_usage();
+			flags |= MipGenerator::image_flags(format);
+		}
+
+		Image ret = create_image_texture2d(aAllocator, baseWidth, baseHeight, format, usage, flags);
+
+		if( aCreateInfo )
+			*aCreateInfo = texture2d_create_info(baseWidth, baseHeight, format, usage, flags);
+
+		// Mip generation is bracketed by timestamps if requested
+		QueryPool timestamps;
+		double timestampPeriod = 0.0;
+		if (aMipStats)
+		{
+			*aMipStats = MipGenerationStats{};
+			aMipStats->compute = computeMips;
+
+			std::uint32_t familyCount = 0;
+			vkGetPhysicalDeviceQueueFamilyProperties(aContext.physicalDevice, &familyCount, nullptr);
+			std::vector<VkQueueFamilyProperties> families(familyCount);
+			vkGetPhysicalDeviceQueueFamilyProperties(aContext.physicalDevice, &familyCount, families.data());
+
+			VkPhysicalDeviceProperties props;
+			vkGetPhysicalDeviceProperties(aContext.physicalDevice, &props);
+
+			if (families[aContext.graphicsFamilyIndex].timestampValidBits > 0)
+			{
+				VkQueryPoolCreateInfo queryInfo{};
+				queryInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+				queryInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+				queryInfo.queryCount = 2;
+
+				VkQueryPool pool = VK_NULL_HANDLE;
+				if (auto const res = vkCreateQueryPool(aContext.device, &queryInfo, nullptr, &pool); VK_SUCCESS != res)
+				{
+					throw Error("Unable to create query pool\n" "vkCreateQueryPool() returned %s", to_string(res).c_str());
+				}
+
+				timestamps = QueryPool(aContext.device, pool);
+				timestampPeriod = props.limits.timestampPeriod;
+			}
+		}
 
 		// Create command buffer for data upload and begin recording 
 		VkCommandBuffer cbuff = alloc_command_buffer(aContext, aCmdPool); 
@@ -119,11 +190,16 @@ namespace labutils
 			throw Error("Beginning command buffer recording\n" "vkBeginCommandBuffer() returned %s", to_string(res).c_str()); 
 		}
 
-		// Transition whole image layout 
+		if (VK_NULL_HANDLE != timestamps.handle)
+			vkCmdResetQueryPool(cbuff, timestamps.handle, 0, 2);
+
+		BarrierBatch barriers(aContext);
+
+		// Transition whole image layout
 		// When copying data to the image, the imagefs layout must be 
 		// TRANSFER DST OPTIMAL. The current image layout is UNDEFINED (which is 
 		// the initial layout the image wa created in). 
-		image_barrier(cbuff, ret.image, 
+		barriers.image(ret.image, 
 			0, 
 			VK_ACCESS_TRANSFER_WRITE_BIT, 
 			VK_IMAGE_LAYOUT_UNDEFINED, 
@@ -135,7 +211,7 @@ namespace labutils
 				0, mipLevels,
 				0, 1 
 			} 
-		);
+		).flush(cbuff);
 
 		// Upload mip levels 1
 		std::uint32_t width = baseWidth, height = baseHeight; 
@@ -187,80 +263,107 @@ namespace labutils
 
 		vkCmdCopyBufferToImage(cbuff, staging.buffer, ret.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copy);
 
-		for (uint32_t i = 0; i < mipLevels - 1; ++i) {
+		if (VK_NULL_HANDLE != timestamps.handle)
+			vkCmdWriteTimestamp(cbuff, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timestamps.handle, 0);
+
+		auto const callsBeforeMips = barriers.calls();
+
+		if (computeMips)
+		{
+			aMipGenerator->record(cbuff, barriers, ret.image, format, VkExtent2D{ baseWidth, baseHeight }, mipLevels);
+		}
+		else
+		{
+			// Each level is generated from the previous one. Only the transition
+			// of the source level has to happen before each blit; the levels
+			// that have been read are transitioned for sampling all at once at
+			// the end.
+			for (uint32_t i = 0; i < mipLevels - 1; ++i) {
 			
-			image_barrier(cbuff, ret.image,
-				VK_ACCESS_TRANSFER_WRITE_BIT,
-				VK_ACCESS_TRANSFER_READ_BIT,
-				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-				VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-				VK_PIPELINE_STAGE_TRANSFER_BIT,
-				VK_PIPELINE_STAGE_TRANSFER_BIT,
-				VkImageSubresourceRange{
-					VK_IMAGE_ASPECT_COLOR_BIT,
-					i, 1,
-					0, 1
-				}
-			);
-
-			//blit the current mipmap level onto the next mipmap level
-			VkImageBlit blit{};
-			blit.srcOffsets[0] = { 0,0,0 };
-			blit.srcOffsets[1] = { (int)width,(int)height,1 };
-			blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			blit.srcSubresource.mipLevel = i;
-			blit.srcSubresource.baseArrayLayer = 0;
-			blit.srcSubresource.layerCount = 1;
-			blit.dstOffsets[0] = { 0,0,0 };
-			blit.dstOffsets[1] = { (int)width > 1 ? (int)width / 2 : 1, (int)height > 1 ? (int)height / 2 : 1, 1 };
-			blit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			blit.dstSubresource.mipLevel = i + 1;
-			blit.dstSubresource.baseArrayLayer = 0;
-			blit.dstSubresource.layerCount = 1;
-
-			vkCmdBlitImage(cbuff, ret.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, ret.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-				1, &blit, VK_FILTER_LINEAR);
-
-			image_barrier(cbuff, ret.image,
-				VK_ACCESS_TRANSFER_READ_BIT,
-				VK_ACCESS_SHADER_READ_BIT,
-				VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-				VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-				VK_PIPELINE_STAGE_TRANSFER_BIT,
-				VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+				barriers.image(ret.image,
+					VK_ACCESS_TRANSFER_WRITE_BIT,
+					VK_ACCESS_TRANSFER_READ_BIT,
+					VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+					VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+					VK_PIPELINE_STAGE_TRANSFER_BIT,
+					VK_PIPELINE_STAGE_TRANSFER_BIT,
+					VkImageSubresourceRange{
+						VK_IMAGE_ASPECT_COLOR_BIT,
+						i, 1,
+						0, 1
+					}
+				).flush(cbuff);
+
+				//blit the current mipmap level onto the next mipmap level
+				VkImageBlit blit{};
+				blit.srcOffsets[0] = { 0,0,0 };
+				blit.srcOffsets[1] = { (int)width,(int)height,1 };
+				blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+				blit.srcSubresource.mipLevel = i;
+				blit.srcSubresource.baseArrayLayer = 0;
+				blit.srcSubresource.layerCount = 1;
+				blit.dstOffsets[0] = { 0,0,0 };
+				blit.dstOffsets[1] = { (int)width > 1 ? (int)width / 2 : 1, (int)height > 1 ? (int)height / 2 : 1, 1 };
+				blit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+				blit.dstSubresource.mipLevel = i + 1;
+				blit.dstSubresource.baseArrayLayer = 0;
+				blit.dstSubresource.layerCount = 1;
+
+				vkCmdBlitImage(cbuff, ret.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, ret.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+					1, &blit, blitFilter);
+
+				// Next mip level
+				width >>= 1;
+				if (0 == width)
+					width = 1;
+
+				height >>= 1;
+				if (0 == height)
+					height = 1;
+			}
+
+			// All levels but the last are in the TRANSFER SRC OPTIMAL layout; the
+			// last one is still in TRANSFER DST OPTIMAL. To use the image as a
+			// texture from which we sample, it must be in the SHADER READ ONLY
+			// OPTIMAL layout. 
+			if (mipLevels > 1)
+			{
+				barriers.image(ret.image,
+					VK_ACCESS_TRANSFER_READ_BIT,
+					VK_ACCESS_SHADER_READ_BIT,
+					VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+					VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+					VK_PIPELINE_STAGE_TRANSFER_BIT,
+					VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+					VkImageSubresourceRange{
+						VK_IMAGE_ASPECT_COLOR_BIT,
+						0, mipLevels - 1,
+						0, 1
+					}
+				);
+			}
+
+			barriers.image(ret.image, 
+				VK_ACCESS_TRANSFER_WRITE_BIT, 
+				VK_ACCESS_SHADER_READ_BIT, 
+				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 
+				VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, 
+				VK_PIPELINE_STAGE_TRANSFER_BIT, 
+				VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 
 				VkImageSubresourceRange{
-					VK_IMAGE_ASPECT_COLOR_BIT,
-					i, 1,
-					0, 1
+						VK_IMAGE_ASPECT_COLOR_BIT,
+						mipLevels - 1, 1,
+						0, 1
 				}
-			);
-
-			// Next mip level
-			width >>= 1;
-			if (0 == width)
-				width = 1;
+			).flush(cbuff);
 
-			height >>= 1;
-			if (0 == height)
-				height = 1;
 		}
 
-		// Whole image is currently in the TRANSFER DST OPTIMAL layout. To use 
-		// the image as a texture from which we sample, it must be in the 
-		// SHADER READ ONLY OPTIMAL layout. 
-		image_barrier(cbuff, ret.image, 
-			VK_ACCESS_TRANSFER_WRITE_BIT, 
-			VK_ACCESS_SHADER_READ_BIT, 
-			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 
-			VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, 
-			VK_PIPELINE_STAGE_TRANSFER_BIT, 
-			VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 
-			VkImageSubresourceRange{
-					VK_IMAGE_ASPECT_COLOR_BIT,
-					mipLevels - 1, 1,
-					0, 1
-			}
-		);
+		if (VK_NULL_HANDLE != timestamps.handle)
+			vkCmdWriteTimestamp(cbuff, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timestamps.handle, 1);
+
+		if (aMipStats)
+			aMipStats->barrierCalls = barriers.calls() - callsBeforeMips;
 
 		// End command recording 1
 		if(auto const res = vkEndCommandBuffer(cbuff); VK_SUCCESS != res) 
@@ -291,16 +394,32 @@ namespace labutils
 		}
 
 		vkFreeCommandBuffers(aContext.device, aCmdPool, 1, &cbuff);
+
+		if (aMipGenerator)
+			aMipGenerator->reset();
+
+		if (VK_NULL_HANDLE != timestamps.handle)
+		{
+			std::uint64_t ticks[2]{};
+			if (auto const res = vkGetQueryPoolResults(aContext.device, timestamps.handle, 0, 2, sizeof(ticks), ticks, sizeof(std::uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT); VK_SUCCESS != res)
+			{
+				throw Error("Unable to get timestamps\n" "vkGetQueryPoolResults() returned %s", to_string(res).c_str());
+			}
+
+			aMipStats->haveGpuTime = true;
+			aMipStats->gpuMs = double(ticks[1] - ticks[0]) * timestampPeriod * 1e-6;
+		}
 			
 		return ret;
 	}
 
-	Image create_image_texture2d( Allocator const& aAllocator, std::uint32_t aWidth, std::uint32_t aHeight, VkFormat aFormat, VkImageUsageFlags aUsage )
+	VkImageCreateInfo texture2d_create_info( std::uint32_t aWidth, std::uint32_t aHeight, VkFormat aFormat, VkImageUsageFlags aUsage, VkImageCreateFlags aFlags )
 	{
 		auto const mipLevels = compute_mip_level_count(aWidth, aHeight); 
 			
 		VkImageCreateInfo imageInfo{}; 
 		imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO; 
+		imageInfo.flags = aFlags;
 		imageInfo.imageType = VK_IMAGE_TYPE_2D; 
 		imageInfo.format = aFormat; 
 		imageInfo.extent.width = aWidth; 
@@ -313,6 +432,13 @@ namespace labutils
 		imageInfo.usage = aUsage; 
 		imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE; 
 		imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED; 
+
+		return imageInfo;
+	}
+
+	Image create_image_texture2d( Allocator const& aAllocator, std::uint32_t aWidth, std::uint32_t aHeight, VkFormat aFormat, VkImageUsageFlags aUsage, VkImageCreateFlags aFlags )
+	{
+		auto const imageInfo = texture2d_create_info(aWidth, aHeight, aFormat, aUsage, aFlags);
 			
 		VmaAllocationCreateInfo allocInfo{}; 
 		allocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;; 
@@ -325,10 +451,67 @@ namespace labutils
 			throw Error("Unable to allocate image.\n" "vmaCreateImage() returned %s", to_string(res).c_str()); 
 				
 		} 
+
+		set_memory_category( aAllocator, allocation, image_memory_category( aUsage ) );
 			
 		return Image(aAllocator.allocator, image, allocation);
 	}
 
+	Image create_transient_attachment( Allocator const& aAllocator, VkExtent2D const& aExtent, VkFormat aFormat, VkImageUsageFlags aUsage, VkSampleCountFlagBits aSamples, bool* aLazilyAllocated )
+	{
+		assert( 0 == (aUsage & ~(VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT)) );
+
+		VkImageCreateInfo imageInfo{};
+		imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageInfo.format = aFormat;
+		imageInfo.extent.width = aExtent.width;
+		imageInfo.extent.height = aExtent.height;
+		imageInfo.extent.depth = 1;
+		imageInfo.mipLevels = 1;
+		imageInfo.arrayLayers = 1;
+		imageInfo.samples = aSamples;
+		imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageInfo.usage = aUsage | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+		imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+		// Lazily allocated memory is committed per VkDeviceMemory object, so
+		// the image gets its own rather than sharing a block.
+		VmaAllocationCreateInfo allocInfo{};
+		allocInfo.usage = VMA_MEMORY_USAGE_GPU_LAZILY_ALLOCATED;
+		allocInfo.flags = VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT;
+
+		std::uint32_t memoryType = 0;
+		bool const lazy = VK_SUCCESS == vmaFindMemoryTypeIndexForImageInfo( aAllocator.allocator, &imageInfo, &allocInfo, &memoryType );
+
+		if( !lazy )
+		{
+			allocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+			allocInfo.flags = 0;
+		}
+
+		VkImage image = VK_NULL_HANDLE;
+		VmaAllocation allocation = VK_NULL_HANDLE;
+
+		if( auto const res = vmaCreateImage( aAllocator.allocator, &imageInfo, &allocInfo, &image, &allocation, nullptr ); VK_SUCCESS != res )
+		{
+			throw Error( "Unable to allocate transient attachment.\n" "vmaCreateImage() returned %s", to_string(res).c_str() );
+		}
+
+		set_memory_category( aAllocator, allocation, MemoryCategory::attachment );
+
+		if( aLazilyAllocated )
+			*aLazilyAllocated = lazy;
+
+		return Image( aAllocator.allocator, image, allocation );
+	}
+
+	VkImageUsageFlags texture2d_view_usage( VkImageCreateInfo const& aInfo ) noexcept
+	{
+		return (aInfo.usage & VK_IMAGE_USAGE_STORAGE_BIT) ? VkImageUsageFlags(VK_IMAGE_USAGE_SAMPLED_BIT) : 0;
+	}
+
 	std::uint32_t compute_mip_level_count( std::uint32_t aWidth, std::uint32_t aHeight )
 	{
 		std::uint32_t const bits = aWidth | aHeight;
@@ -338,3 +521,17 @@ namespace labutils
 
 
 }
+
+namespace labutils
+{
+	MemoryCategory image_memory_category( VkImageUsageFlags aUsage )
+	{
+		if( aUsage & (VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT) )
+			return MemoryCategory::attachment;
+
+		if( aUsage & (VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT) )
+			return MemoryCategory::texture;
+
+		return MemoryCategory::other;
+	}
+}
@@ -33,10 +33,48 @@ namespace labutils
 	};
 
 
-	Image load_image_texture2d( char const* aPattern, VulkanContext const&, VkCommandPool, Allocator const& );
+	class MipGenerator;
+	struct MipGenerationStats;
 
-	Image create_image_texture2d( Allocator const&, std::uint32_t aWidth, std::uint32_t aHeight, VkFormat, VkImageUsageFlags = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT );
+	// If aCreateInfo is given, it receives the parameters that the image was
+	// created with (e.g. for Defragmenter::add_image()).
+	//
+	// Mip levels are generated with aMipGenerator if given and if it supports
+	// the image. Otherwise, they are generated with a chain of blits, which
+	// requires blit support for the format (linear filtering is used if the
+	// format supports it). aMipGenerator is reset() before returning.
+	// aMipStats, if given, receives the path taken, the number of barrier
+	// commands and the GPU time of mip generation.
+	Image load_image_texture2d( char const* aPattern, VulkanContext const&, VkCommandPool, Allocator const&, VkImageCreateInfo* aCreateInfo = nullptr, MipGenerator* aMipGenerator = nullptr, MipGenerationStats* aMipStats = nullptr );
+
+	Image create_image_texture2d( Allocator const&, std::uint32_t aWidth, std::uint32_t aHeight, VkFormat, VkImageUsageFlags = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, VkImageCreateFlags = 0 );
+
+	// Parameters used by create_image_texture2d(): a single layer with a full
+	// mip chain, optimal tiling.
+	VkImageCreateInfo texture2d_create_info( std::uint32_t aWidth, std::uint32_t aHeight, VkFormat, VkImageUsageFlags, VkImageCreateFlags = 0 );
+
+	// Usage for sampled views of a texture created with aInfo: views of
+	// images with storage usage (written by a MipGenerator) are restricted
+	// to sampling. Zero otherwise. See create_image_view_texture2d().
+	VkImageUsageFlags texture2d_view_usage( VkImageCreateInfo const& aInfo ) noexcept;
+
+	// Attachment whose contents only live within a render pass, i.e., that
+	// is never loaded or stored (e.g. a depth buffer, or a multisampled color
+	// target that is resolved). The image is created with
+	// VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT. If the device has lazily
+	// allocated memory (common on tile-based GPUs), the image uses a
+	// dedicated allocation of that memory, which the driver need not commit
+	// at all. Otherwise, it falls back to ordinary device-local memory.
+	//
+	// aUsage may only contain attachment usages. aLazilyAllocated, if given,
+	// receives whether lazily allocated memory is used.
+	Image create_transient_attachment( Allocator const&, VkExtent2D const&, VkFormat, VkImageUsageFlags aUsage, VkSampleCountFlagBits = VK_SAMPLE_COUNT_1_BIT, bool* aLazilyAllocated = nullptr );
 
 	std::uint32_t compute_mip_level_count( std::uint32_t aWidth, std::uint32_t aHeight );
+
+	// Memory category of images with the given usage. create_image_texture2d()
+	// uses this; images created directly with VMA should be passed to
+	// set_memory_category() as well.
+	MemoryCategory image_memory_category( VkImageUsageFlags );
 	
 }
@@ -93,8 +93,10 @@ namespace labutils
 
 	using DescriptorPool = UniqueHandle< VkDescriptorPool, VkDevice, vkDestroyDescriptorPool >;
 	using DescriptorSetLayout = UniqueHandle< VkDescriptorSetLayout, VkDevice, vkDestroyDescriptorSetLayout >;
+	using DescriptorUpdateTemplate = UniqueHandle< VkDescriptorUpdateTemplate, VkDevice, vkDestroyDescriptorUpdateTemplate >;
 
 	using Pipeline = UniqueHandle< VkPipeline, VkDevice, vkDestroyPipeline >;
+	using PipelineCache = UniqueHandle< VkPipelineCache, VkDevice, vkDestroyPipelineCache >;
 	using PipelineLayout = UniqueHandle< VkPipelineLayout, VkDevice, vkDestroyPipelineLayout >;
 
 	using ShaderModule = UniqueHandle< VkShaderModule, VkDevice, vkDestroyShaderModule >;
@@ -104,6 +106,8 @@ namespace labutils
 	using Fence = UniqueHandle< VkFence, VkDevice, vkDestroyFence >;
 	using Semaphore = UniqueHandle< VkSemaphore, VkDevice, vkDestroySemaphore >;
 
+	using QueryPool = UniqueHandle< VkQueryPool, VkDevice, vkDestroyQueryPool >;
+
 	using ImageView = UniqueHandle< VkImageView, VkDevice, vkDestroyImageView >;
 
 	using Sampler = UniqueHandle< VkSampler, VkDevice, vkDestroySampler>;
@@ -7,12 +7,30 @@
 
 #include "error.hpp"
 #include "to_string.hpp"
+#include "embedded_spirv.hpp"
 
 namespace labutils
 {
 	ShaderModule load_shader_module( VulkanContext const& aContext, char const* aSpirvPath )
 	{
 		assert(aSpirvPath); 
+
+		// Shaders compiled into the executable need no file access
+		if( auto const* embedded = find_embedded_spirv( aSpirvPath ) )
+		{
+			VkShaderModuleCreateInfo moduleInfo{};
+			moduleInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+			moduleInfo.codeSize = embedded->wordCount * sizeof(std::uint32_t);
+			moduleInfo.pCode = embedded->words;
+
+			VkShaderModule smod = VK_NULL_HANDLE;
+			if(auto const res = vkCreateShaderModule(aContext.device, &moduleInfo, nullptr, &smod); VK_SUCCESS != res)
+			{
+				throw Error("Unable to create shader module from embedded %s\n" "vkCreateShaderModule() returned %s", embedded->name, to_string(res).c_str());
+			}
+
+			return ShaderModule(aContext.device, smod);
+		}
 			
 		if(std::FILE * fin = std::fopen(aSpirvPath, "rb"))
 		{ 
@@ -198,10 +216,15 @@ namespace labutils
 		return dset;
 	}
 
-	ImageView create_image_view_texture2d(VulkanContext const& aContext, VkImage aImage, VkFormat aFormat)
+	ImageView create_image_view_texture2d(VulkanContext const& aContext, VkImage aImage, VkFormat aFormat, VkImageUsageFlags aViewUsage)
 	{
+		VkImageViewUsageCreateInfo usageInfo{};
+		usageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_USAGE_CREATE_INFO;
+		usageInfo.usage = aViewUsage;
+
 		VkImageViewCreateInfo viewInfo{}; 
 		viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO; 
+		viewInfo.pNext = aViewUsage ? &usageInfo : nullptr;
 		viewInfo.image = aImage; 
 		viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D; 
 		viewInfo.format = aFormat; 
@@ -243,8 +266,8 @@ namespace labutils
 		
 	}
 
-	Sampler create_default_sampler(VulkanContext const& aContext) 
-	{ 
+	VkSamplerCreateInfo default_sampler_info()
+	{
 		VkSamplerCreateInfo samplerInfo{}; 
 		samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO; 
 		samplerInfo.magFilter = VK_FILTER_LINEAR; 
@@ -255,6 +278,13 @@ namespace labutils
 		samplerInfo.minLod = 0.f; 
 		samplerInfo.maxLod = VK_LOD_CLAMP_NONE; 
 		samplerInfo.mipLodBias = 0.f; 
+
+		return samplerInfo;
+	}
+
+	Sampler create_default_sampler(VulkanContext const& aContext) 
+	{ 
+		auto const samplerInfo = default_sampler_info();
 		
 		VkSampler sampler = VK_NULL_HANDLE;
 		if(auto const res = vkCreateSampler(aContext.device, &samplerInfo, nullptr, &sampler); VK_SUCCESS != res)
@@ -29,7 +29,10 @@ namespace labutils
 	);
 	DescriptorPool create_descriptor_pool(VulkanContext const&, std::uint32_t aMaxDescriptors = 2048, std::uint32_t aMaxSets = 1024);
 	VkDescriptorSet alloc_desc_set(VulkanContext const&, VkDescriptorPool, VkDescriptorSetLayout);
-	ImageView create_image_view_texture2d(VulkanContext const&, VkImage, VkFormat);
+	// A non-zero aViewUsage restricts the usage of the view (Vulkan 1.1). This
+	// is needed e.g. for sRGB views of images that also have storage usage
+	// (see MipGenerator).
+	ImageView create_image_view_texture2d(VulkanContext const&, VkImage, VkFormat, VkImageUsageFlags aViewUsage = 0);
 	void image_barrier(
 		VkCommandBuffer, 
 		VkImage, 
@@ -44,5 +47,9 @@ namespace labutils
 		std::uint32_t aDstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED 
 	);
 
+	// Linear filtering with mipmaps, repeat addressing. Also for use with
+	// SamplerCache::get().
+	VkSamplerCreateInfo default_sampler_info();
+
 	Sampler create_default_sampler(VulkanContext const&);
 }
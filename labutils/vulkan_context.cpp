@@ -21,7 +21,9 @@ namespace
 
 	VkDevice create_device( 
 		VkPhysicalDevice,
-		std::uint32_t aQueueFamily
+		std::uint32_t aQueueFamily,
+		std::vector<char const*> const& aEnabledExtensions,
+		lut::detail::DeviceFeatureChain const& aFeatures
 	);
 }
 
@@ -51,6 +53,10 @@ namespace labutils
 		, device( std::exchange( aOther.device, VK_NULL_HANDLE ) )
 		, graphicsFamilyIndex( aOther.graphicsFamilyIndex )
 		, graphicsQueue( std::exchange( aOther.graphicsQueue, VK_NULL_HANDLE ) )
+		, haveDescriptorIndexing( aOther.haveDescriptorIndexing )
+		, haveMemoryBudget( aOther.haveMemoryBudget )
+		, haveSynchronization2( aOther.haveSynchronization2 )
+		, haveDynamicRendering( aOther.haveDynamicRendering )
 		, debugMessenger( std::exchange( aOther.debugMessenger, VK_NULL_HANDLE ) )
 	{}
 
@@ -72,13 +78,17 @@ namespace labutils
 		std::swap( device, aOther.device );
 		std::swap( graphicsFamilyIndex, aOther.graphicsFamilyIndex );
 		std::swap( graphicsQueue, aOther.graphicsQueue );
+		std::swap( haveDescriptorIndexing, aOther.haveDescriptorIndexing );
+		std::swap( haveMemoryBudget, aOther.haveMemoryBudget );
+		std::swap( haveSynchronization2, aOther.haveSynchronization2 );
+		std::swap( haveDynamicRendering, aOther.haveDynamicRendering );
 		std::swap( debugMessenger, aOther.debugMessenger );
 		return *this;
 	}
 
 
 	// make_vulkan_context()
-	VulkanContext make_vulkan_context()
+	VulkanContext make_vulkan_context( DeviceConfig const& aDeviceConfig )
 	{
 		VulkanContext ret;
 
@@ -149,7 +159,15 @@ namespace labutils
 			throw lut::Error( "No queue family with GRAPHICS" );
 		}
 
-		ret.device = create_device( ret.physicalDevice, ret.graphicsFamilyIndex );
+		// Optional features
+		std::vector<char const*> enabledDevExensions;
+		detail::DeviceFeatureChain features;
+		detail::select_device_features( ret, aDeviceConfig, enabledDevExensions, features );
+
+		for( auto const& ext : enabledDevExensions )
+			std::fprintf( stderr, "Enabling device extension: %s\n", ext );
+
+		ret.device = create_device( ret.physicalDevice, ret.graphicsFamilyIndex, enabledDevExensions, features );
 
 		// Retrieve VkQueue
 		vkGetDeviceQueue( ret.device, ret.graphicsFamilyIndex, 0, &ret.graphicsQueue );
@@ -182,7 +200,7 @@ namespace
 		return {};
 	}
 
-	VkDevice create_device( VkPhysicalDevice aPhysicalDev, std::uint32_t aQueueFamily )
+	VkDevice create_device( VkPhysicalDevice aPhysicalDev, std::uint32_t aQueueFamily, std::vector<char const*> const& aEnabledExtensions, lut::detail::DeviceFeatureChain const& aFeatures )
 	{
 		float queuePriorities[1] = { 1.f };
 
@@ -192,16 +210,17 @@ namespace
 		queueInfo.queueCount        = 1;
 		queueInfo.pQueuePriorities  = queuePriorities;
 
-		VkPhysicalDeviceFeatures deviceFeatures{};
-		// No extra features for now.
-		
 		VkDeviceCreateInfo deviceInfo{};
 		deviceInfo.sType  = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+		deviceInfo.pNext  = aFeatures.head; // optional features
 
 		deviceInfo.queueCreateInfoCount  = 1;
 		deviceInfo.pQueueCreateInfos     = &queueInfo;
 
-		deviceInfo.pEnabledFeatures      = &deviceFeatures;
+		deviceInfo.enabledExtensionCount    = std::uint32_t(aEnabledExtensions.size());
+		deviceInfo.ppEnabledExtensionNames  = aEnabledExtensions.data();
+
+		deviceInfo.pEnabledFeatures      = &aFeatures.core;
 
 		VkDevice device = VK_NULL_HANDLE;
 		if( auto const res = vkCreateDevice( aPhysicalDev, &deviceInfo, nullptr, &device ); VK_SUCCESS != res )
@@ -6,6 +6,29 @@
 
 namespace labutils
 {
+	// Optional device features. Features are only enabled if the device
+	// supports them; VulkanContext records which ones were enabled.
+	struct DeviceConfig
+	{
+		// Descriptor indexing (Vulkan 1.2 or VK_EXT_descriptor_indexing):
+		// runtime descriptor arrays, partially bound and update-after-bind
+		// sampled images that may be updated while unused by pending
+		// command buffers. Used for bindless texture tables.
+		bool descriptorIndexing = false;
+
+		// VK_EXT_memory_budget: heap budgets and usage reported by the
+		// driver (see memory_stats.hpp). Without it, VMA estimates these.
+		bool memoryBudget = false;
+
+		// VK_KHR_synchronization2: barriers with per-barrier stage masks
+		// (vkCmdPipelineBarrier2KHR). Used by BarrierBatch when available.
+		bool synchronization2 = false;
+
+		// VK_KHR_dynamic_rendering: render directly to image views with
+		// vkCmdBeginRenderingKHR(), without render passes or framebuffers
+		bool dynamicRendering = false;
+	};
+
 	class VulkanContext
 	{
 		public:
@@ -28,12 +51,18 @@ namespace labutils
 			std::uint32_t graphicsFamilyIndex = 0;
 			VkQueue graphicsQueue = VK_NULL_HANDLE;
 
+			// Optional features that were enabled (see DeviceConfig)
+			bool haveDescriptorIndexing = false;
+			bool haveMemoryBudget = false;
+			bool haveSynchronization2 = false;
+			bool haveDynamicRendering = false;
+
 			
 			//bool haveDebugUtils = false;
 			VkDebugUtilsMessengerEXT debugMessenger = VK_NULL_HANDLE;
 	};
 
-	VulkanContext make_vulkan_context();
+	VulkanContext make_vulkan_context( DeviceConfig const& = {} );
 }
 
 //EOF vim:syntax=cpp:foldmethod=marker:ts=4:noexpandtab: 
@@ -28,17 +28,19 @@ namespace
 	VkDevice create_device( 
 		VkPhysicalDevice,
 		std::vector<std::uint32_t> const& aQueueFamilies,
-		std::vector<char const*> const& aEnabledDeviceExtensions = {}
+		std::vector<char const*> const& aEnabledDeviceExtensions,
+		lut::detail::DeviceFeatureChain const& aFeatures
 	);
 
 	std::vector<VkSurfaceFormatKHR> get_surface_formats( VkPhysicalDevice, VkSurfaceKHR );
 	std::unordered_set<VkPresentModeKHR> get_present_modes( VkPhysicalDevice, VkSurfaceKHR );
 
-	std::tuple<VkSwapchainKHR,VkFormat,VkExtent2D> create_swapchain(
+	std::tuple<VkSwapchainKHR,VkFormat,VkExtent2D,VkPresentModeKHR> create_swapchain(
 		VkPhysicalDevice,
 		VkSurfaceKHR,
 		VkDevice,
 		GLFWwindow*,
+		lut::PresentConfig const&,
 		std::vector<std::uint32_t> const& aQueueFamilyIndices = {},
 		VkSwapchainKHR aOldSwapchain = VK_NULL_HANDLE
 	);
@@ -90,6 +92,8 @@ namespace labutils
 		, swapViews( std::move( aOther.swapViews ) )
 		, swapchainFormat( aOther.swapchainFormat )
 		, swapchainExtent( aOther.swapchainExtent )
+		, presentConfig( aOther.presentConfig )
+		, presentMode( aOther.presentMode )
 	{}
 
 	VulkanWindow& VulkanWindow::operator=( VulkanWindow&& aOther ) noexcept
@@ -104,13 +108,16 @@ namespace labutils
 		std::swap( swapViews, aOther.swapViews );
 		std::swap( swapchainFormat, aOther.swapchainFormat );
 		std::swap( swapchainExtent, aOther.swapchainExtent );
+		std::swap( presentConfig, aOther.presentConfig );
+		std::swap( presentMode, aOther.presentMode );
 		return *this;
 	}
 
 	// make_vulkan_window()
-	VulkanWindow make_vulkan_window()
+	VulkanWindow make_vulkan_window( PresentConfig const& aPresentConfig, DeviceConfig const& aDeviceConfig )
 	{
 		VulkanWindow ret;
+		ret.presentConfig = aPresentConfig;
 
 		// Initialize Volk
 		if( auto const res = volkInitialize(); VK_SUCCESS != res )
@@ -226,6 +233,10 @@ namespace labutils
 		enabledDevExensions.emplace_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
 		//TODO: list necessary extensions here
 
+		// Optional features
+		detail::DeviceFeatureChain features;
+		detail::select_device_features( ret, aDeviceConfig, enabledDevExensions, features );
+
 		for( auto const& ext : enabledDevExensions )
 			std::fprintf( stderr, "Enabling device extension: %s\n", ext );
 
@@ -254,7 +265,7 @@ namespace labutils
 			queueFamilyIndices.emplace_back(*graphics); 
 			queueFamilyIndices.emplace_back(*present); 
 		}
-		ret.device = create_device( ret.physicalDevice, queueFamilyIndices, enabledDevExensions );
+		ret.device = create_device( ret.physicalDevice, queueFamilyIndices, enabledDevExensions, features );
 
 		// Retrieve VkQueues
 		vkGetDeviceQueue( ret.device, ret.graphicsFamilyIndex, 0, &ret.graphicsQueue );
@@ -270,7 +281,7 @@ namespace labutils
 		}
 
 		// Create swap chain
-		std::tie(ret.swapchain, ret.swapchainFormat, ret.swapchainExtent) = create_swapchain( ret.physicalDevice, ret.surface, ret.device, ret.window, queueFamilyIndices );
+		std::tie(ret.swapchain, ret.swapchainFormat, ret.swapchainExtent, ret.presentMode) = create_swapchain( ret.physicalDevice, ret.surface, ret.device, ret.window, ret.presentConfig, queueFamilyIndices );
 		
 		// Get swap chain images & create associated image views
 		get_swapchain_images( ret.device, ret.swapchain, ret.swapImages );
@@ -281,6 +292,13 @@ namespace labutils
 	}
 
 	SwapChanges recreate_swapchain( VulkanWindow& aWindow )
+	{
+		// The retired objects are destroyed when this returns
+		RetiredSwapchain retired;
+		return recreate_swapchain( aWindow, retired );
+	}
+
+	SwapChanges recreate_swapchain( VulkanWindow& aWindow, RetiredSwapchain& aRetired )
 	{
 		// Remember old format & extents 
 		// These are two of the properties that may change. Typically only the 
@@ -290,14 +308,14 @@ namespace labutils
 		auto const oldFormat = aWindow.swapchainFormat; 
 		auto const oldExtent = aWindow.swapchainExtent; 
 			
-		// Destroy old objects (except for the old swap chain) 
-		// We keep the old swap chain object around, such that we can pass it 
-		// to vkCreateSwapchainKHR() via the oldSwapchain member of 
-		// VkSwapchainCreateInfoKHR. 
+		// Hand off the old objects. We keep the old swap chain object around,
+		// such that we can pass it to vkCreateSwapchainKHR() via the
+		// oldSwapchain member of VkSwapchainCreateInfoKHR. 
 		VkSwapchainKHR oldSwapchain = aWindow.swapchain; 
-			
-		for(auto view : aWindow.swapViews) 
-			vkDestroyImageView(aWindow.device, view, nullptr); 
+
+		RetiredSwapchain retired;
+		retired.device = aWindow.device;
+		retired.views = std::move(aWindow.swapViews);
 			
 		aWindow.swapViews.clear(); 
 		aWindow.swapImages.clear(); 
@@ -312,7 +330,7 @@ namespace labutils
 			
 		try 
 		{ 
-			std::tie(aWindow.swapchain, aWindow.swapchainFormat, aWindow.swapchainExtent) = create_swapchain(aWindow.physicalDevice, aWindow.surface, aWindow.device, aWindow.window, queueFamilyIndices, oldSwapchain);
+			std::tie(aWindow.swapchain, aWindow.swapchainFormat, aWindow.swapchainExtent, aWindow.presentMode) = create_swapchain(aWindow.physicalDevice, aWindow.surface, aWindow.device, aWindow.window, aWindow.presentConfig, queueFamilyIndices, oldSwapchain);
 		} 
 		catch(...) 
 		{ 
@@ -323,8 +341,9 @@ namespace labutils
 			throw; 
 		} 
 				
-		// Destroy old swap chain 
-		vkDestroySwapchainKHR(aWindow.device, oldSwapchain, nullptr); 
+		// The old swap chain is retired together with its views
+		retired.swapchain = oldSwapchain;
+		aRetired = std::move(retired);
 				
 		// Get new swap chain images & create associated image views 
 		get_swapchain_images(aWindow.device, aWindow.swapchain, aWindow.swapImages); 
@@ -341,6 +360,30 @@ namespace labutils
 				
 		return ret;
 	}
+
+	// RetiredSwapchain
+	RetiredSwapchain::~RetiredSwapchain()
+	{
+		for( auto const view : views )
+			vkDestroyImageView( device, view, nullptr );
+
+		if( VK_NULL_HANDLE != swapchain )
+			vkDestroySwapchainKHR( device, swapchain, nullptr );
+	}
+
+	RetiredSwapchain::RetiredSwapchain( RetiredSwapchain&& aOther ) noexcept
+		: device( std::exchange( aOther.device, VK_NULL_HANDLE ) )
+		, swapchain( std::exchange( aOther.swapchain, VK_NULL_HANDLE ) )
+		, views( std::move( aOther.views ) )
+	{}
+
+	RetiredSwapchain& RetiredSwapchain::operator=( RetiredSwapchain&& aOther ) noexcept
+	{
+		std::swap( device, aOther.device );
+		std::swap( swapchain, aOther.swapchain );
+		std::swap( views, aOther.views );
+		return *this;
+	}
 }
 
 namespace
@@ -391,7 +434,7 @@ namespace
 		return modesReturn;
 	}
 
-	std::tuple<VkSwapchainKHR,VkFormat,VkExtent2D> create_swapchain( VkPhysicalDevice aPhysicalDev, VkSurfaceKHR aSurface, VkDevice aDevice, GLFWwindow* aWindow, std::vector<std::uint32_t> const& aQueueFamilyIndices, VkSwapchainKHR aOldSwapchain )
+	std::tuple<VkSwapchainKHR,VkFormat,VkExtent2D,VkPresentModeKHR> create_swapchain( VkPhysicalDevice aPhysicalDev, VkSurfaceKHR aSurface, VkDevice aDevice, GLFWwindow* aWindow, lut::PresentConfig const& aConfig, std::vector<std::uint32_t> const& aQueueFamilyIndices, VkSwapchainKHR aOldSwapchain )
 	{
 		auto const formats = get_surface_formats( aPhysicalDev, aSurface );
 		auto const modes = get_present_modes( aPhysicalDev, aSurface );
@@ -417,10 +460,21 @@ namespace
 
 		// Pick a presentation mode 
 		VkPresentModeKHR presentMode = VK_PRESENT_MODE_FIFO_KHR; 
-			
-		// Prefer FIFO RELAXED if itfs available. 
-		if(modes.count(VK_PRESENT_MODE_FIFO_RELAXED_KHR)) 
-			presentMode = VK_PRESENT_MODE_FIFO_RELAXED_KHR;
+
+		if(VK_PRESENT_MODE_MAX_ENUM_KHR == aConfig.presentMode)
+		{
+			// Prefer FIFO RELAXED if itfs available. 
+			if(modes.count(VK_PRESENT_MODE_FIFO_RELAXED_KHR)) 
+				presentMode = VK_PRESENT_MODE_FIFO_RELAXED_KHR;
+		}
+		else if(modes.count(aConfig.presentMode))
+		{
+			presentMode = aConfig.presentMode;
+		}
+		else
+		{
+			std::fprintf(stderr, "Present mode %s not supported, using FIFO\n", lut::to_string(aConfig.presentMode).c_str());
+		}
 
 		// Pick an image count 1
 		VkSurfaceCapabilitiesKHR caps; 
@@ -429,10 +483,13 @@ namespace
 			throw lut::Error("Unable to get surface capabilities\n" "vkGetPhysicalDeviceSurfaceCapabilitiesKHR() returned %s", lut::to_string(res).c_str());
 		} 
 			
-		std::uint32_t imageCount = 2;
+		std::uint32_t imageCount = aConfig.imageCount;
 			
-		if(imageCount < caps.minImageCount + 1)
-		imageCount = caps.minImageCount + 1;
+		if(0 == imageCount)
+			imageCount = std::max(2u, caps.minImageCount + 1);
+
+		if(imageCount < caps.minImageCount)
+			imageCount = caps.minImageCount;
 				
 		if(caps.maxImageCount > 0 && imageCount > caps.maxImageCount)
 			imageCount = caps.maxImageCount;
@@ -491,7 +548,7 @@ namespace
 			throw lut::Error("Unable to create swap chain\n" "vkCreateSwapchainKHR() returned %s", lut::to_string(res).c_str()); 
 		} 
 			
-		return{ chain, format.format, extent };
+		return{ chain, format.format, extent, presentMode };
 	}
 
 
@@ -583,7 +640,7 @@ namespace
 		return {};
 	}
 
-	VkDevice create_device( VkPhysicalDevice aPhysicalDev, std::vector<std::uint32_t> const& aQueues, std::vector<char const*> const& aEnabledExtensions )
+	VkDevice create_device( VkPhysicalDevice aPhysicalDev, std::vector<std::uint32_t> const& aQueues, std::vector<char const*> const& aEnabledExtensions, lut::detail::DeviceFeatureChain const& aFeatures )
 	{
 		if( aQueues.empty() )
 			throw lut::Error( "create_device(): no queues requested" );
@@ -600,11 +657,9 @@ namespace
 			queueInfo.pQueuePriorities  = queuePriorities;
 		}
 
-		VkPhysicalDeviceFeatures deviceFeatures{};
-		// No extra features for now.
-		
 		VkDeviceCreateInfo deviceInfo{};
 		deviceInfo.sType  = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+		deviceInfo.pNext  = aFeatures.head; // optional features
 
 		deviceInfo.queueCreateInfoCount     = std::uint32_t(queueInfos.size());
 		deviceInfo.pQueueCreateInfos        = queueInfos.data();
@@ -612,7 +667,7 @@ namespace
 		deviceInfo.enabledExtensionCount    = std::uint32_t(aEnabledExtensions.size());
 		deviceInfo.ppEnabledExtensionNames  = aEnabledExtensions.data();
 
-		deviceInfo.pEnabledFeatures         = &deviceFeatures;
+		deviceInfo.pEnabledFeatures         = &aFeatures.core;
 
 		VkDevice device = VK_NULL_HANDLE;
 		if( auto const res = vkCreateDevice( aPhysicalDev, &deviceInfo, nullptr, &device ); VK_SUCCESS != res )
@@ -14,6 +14,18 @@
 
 namespace labutils
 {
+	// Presentation policy of the swap chain. A present mode that the surface
+	// does not support falls back to FIFO, which is always available. The
+	// image count is clamped to the limits of the surface.
+	struct PresentConfig
+	{
+		// VK_PRESENT_MODE_MAX_ENUM_KHR: FIFO_RELAXED if available, else FIFO
+		VkPresentModeKHR presentMode = VK_PRESENT_MODE_MAX_ENUM_KHR;
+
+		// Zero: minImageCount + 1
+		std::uint32_t imageCount = 0;
+	};
+
 	class VulkanWindow final : public VulkanContext
 	{
 		public:
@@ -39,9 +51,13 @@ namespace labutils
 
 			VkFormat swapchainFormat;
 			VkExtent2D swapchainExtent;
+
+			// Requested policy and the present mode that is actually in use
+			PresentConfig presentConfig;
+			VkPresentModeKHR presentMode = VK_PRESENT_MODE_FIFO_KHR;
 	};
 
-	VulkanWindow make_vulkan_window();
+	VulkanWindow make_vulkan_window( PresentConfig const& = {}, DeviceConfig const& = {} );
 
 
 	struct SwapChanges
@@ -50,7 +66,34 @@ namespace labutils
 		bool changedFormat: 1;
 	};
 
+	// Swap chain and image views replaced by recreate_swapchain(). Frames
+	// that are still in flight may use these, so they are only destroyed
+	// with this object (see DeletionQueue).
+	class RetiredSwapchain final
+	{
+		public:
+			RetiredSwapchain() noexcept = default;
+			~RetiredSwapchain();
+
+			RetiredSwapchain( RetiredSwapchain const& ) = delete;
+			RetiredSwapchain& operator= (RetiredSwapchain const&) = delete;
+
+			RetiredSwapchain( RetiredSwapchain&& ) noexcept;
+			RetiredSwapchain& operator= (RetiredSwapchain&&) noexcept;
+
+		public:
+			VkDevice device = VK_NULL_HANDLE;
+			VkSwapchainKHR swapchain = VK_NULL_HANDLE;
+			std::vector<VkImageView> views;
+	};
+
+	// Destroys the old swap chain immediately. The caller must ensure that it
+	// is no longer in use (e.g. with vkDeviceWaitIdle()).
 	SwapChanges recreate_swapchain( VulkanWindow& );
+
+	// Passes the old swap chain to aRetired instead, such that rendering can
+	// continue while frames that use it are in flight.
+	SwapChanges recreate_swapchain( VulkanWindow&, RetiredSwapchain& aRetired );
 }
 
 //EOF vim:syntax=cpp:foldmethod=marker:ts=4:noexpandtab: 
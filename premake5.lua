@@ -61,6 +61,9 @@ include "third_party"
 -- GLSLC helpers
 dofile( "util/glslc.lua" )
 
+-- Embedded SPIR-V helpers (--embed-shaders)
+dofile( "util/embed_spirv.lua" )
+
 -- Projects
 project "exercise1"
 	local sources = { 
@@ -153,6 +156,10 @@ project "exercise4"
 
 	files( sources )
 
+	if _OPTIONS["embed-shaders"] then
+		files( embedded_spirv_source( "exercise4" ) )
+	end
+
 	dependson "exercise4-shaders"
 
 	links "labutils"
@@ -163,18 +170,30 @@ project "exercise4"
 
 	dependson "x-glm" 
 
+-- The compute mip generation shader (exercise4 --compute-mips) is only built
+-- on request.
+newoption {
+	trigger = "compute-mips",
+	description = "Build the compute shaders of exercise4 (mip generation)"
+}
+
 project "exercise4-shaders"
 	local shaders = { 
 		"exercise4/shaders/*.vert",
 		"exercise4/shaders/*.frag"
 	}
 
+	if _OPTIONS["compute-mips"] then
+		table.insert( shaders, "exercise4/shaders/*.comp" )
+	end
+
 	kind "Utility"
 	location "exercise4/shaders"
 
 	files( shaders )
 
 	handle_glsl_files( "-O", "assets/exercise4/shaders", {} )
+	embed_spirv_files( "exercise4", "assets/exercise4/shaders" )
 
 project "labutils"
 	local sources = { 
@@ -0,0 +1,129 @@
+-- Optionally embed compiled SPIR-V into the executables.
+--
+-- With --embed-shaders, embed_spirv_files() adds a post-build step to the
+-- shader project. The step re-runs premake with the internal embed-spirv
+-- action, which writes a C++ source file defining one constexpr array per
+-- .spv file, registered with labutils::EmbeddedSpirvRegistration (see
+-- labutils/embedded_spirv.hpp). embedded_spirv_source() returns the path of
+-- that file, to be added to the project that uses the shaders.
+
+newoption {
+	trigger = "embed-shaders",
+	description = "Embed compiled SPIR-V shaders into the executables"
+}
+
+newoption {
+	trigger = "spirv-dir",
+	value = "DIR",
+	description = "(embed-spirv) Directory with .spv files"
+}
+newoption {
+	trigger = "spirv-output",
+	value = "FILE",
+	description = "(embed-spirv) C++ source file to generate"
+}
+
+local generated = "_build_/generated";
+
+embedded_spirv_source = function( name )
+	return generated .. "/" .. name .. "-spirv.cpp";
+end
+
+embed_spirv_files = function( name, spirvdir )
+	if not _OPTIONS["embed-shaders"] then
+		return
+	end
+
+	postbuildmessage( "EMBED: " .. spirvdir );
+	postbuildcommands {
+		"{mkdir} %{wks.location}/" .. generated,
+		'"' .. _PREMAKE_COMMAND .. '" --file="' .. _MAIN_SCRIPT .. '"'
+			.. " --spirv-dir=%{wks.location}/" .. spirvdir
+			.. " --spirv-output=%{wks.location}/" .. embedded_spirv_source( name )
+			.. " embed-spirv"
+	}
+end
+
+newaction {
+	trigger = "embed-spirv",
+	description = "(internal) Generate C++ source with embedded SPIR-V",
+
+	execute = function()
+		local idir = _OPTIONS["spirv-dir"];
+		local ofile = _OPTIONS["spirv-output"];
+		if not idir or not ofile then
+			error( "embed-spirv requires --spirv-dir and --spirv-output" );
+		end
+
+		local spvs = os.matchfiles( path.join( idir, "*.spv" ) );
+		table.sort( spvs );
+
+		local out = {};
+		table.insert( out, "// Generated by util/embed_spirv.lua from " .. idir .. ". Do not edit." );
+		table.insert( out, '#include "../../labutils/embedded_spirv.hpp"' );
+		table.insert( out, "" );
+		table.insert( out, "namespace" );
+		table.insert( out, "{" );
+
+		local entries = {};
+		for i,spv in ipairs(spvs) do
+			local fin = assert( io.open( spv, "rb" ) );
+			local data = fin:read( "a" );
+			fin:close();
+
+			if 0 == #data or 0 ~= #data % 4 then
+				error( "'" .. spv .. "' is not a valid SPIR-V file" );
+			end
+
+			local ident = "kSpirv" .. (i-1) .. "_";
+			table.insert( out, "\tconstexpr std::uint32_t " .. ident .. "[] = {" );
+
+			local line = {};
+			for offset = 1, #data, 4 do
+				table.insert( line, string.format( "0x%08xu", string.unpack( "<I4", data, offset ) ) );
+				if 8 == #line then
+					table.insert( out, "\t\t" .. table.concat( line, ", " ) .. "," );
+					line = {};
+				end
+			end
+			if #line > 0 then
+				table.insert( out, "\t\t" .. table.concat( line, ", " ) );
+			end
+
+			table.insert( out, "\t};" );
+			table.insert( entries, '\t\t{ "' .. path.getname( spv ) .. '", ' .. ident .. ", sizeof(" .. ident .. ") / sizeof(std::uint32_t) }," );
+		end
+
+		table.insert( out, "" );
+		if #entries > 0 then
+			table.insert( out, "\tconstexpr labutils::EmbeddedSpirv kEmbedded_[] = {" );
+			for _,entry in ipairs(entries) do
+				table.insert( out, entry );
+			end
+			table.insert( out, "\t};" );
+			table.insert( out, "" );
+			table.insert( out, "\tlabutils::EmbeddedSpirvRegistration const kRegistration_( kEmbedded_, sizeof(kEmbedded_) / sizeof(kEmbedded_[0]) );" );
+		end
+		table.insert( out, "}" );
+		table.insert( out, "" );
+
+		-- Only touch the file if it changed, to avoid needless rebuilds
+		local text = table.concat( out, "\n" );
+		local fold = io.open( ofile, "rb" );
+		if fold then
+			local old = fold:read( "a" );
+			fold:close();
+			if old == text then
+				return
+			end
+		end
+
+		local fout = assert( io.open( ofile, "wb" ) );
+		fout:write( text );
+		fout:close();
+
+		print( "Embedded " .. #spvs .. " SPIR-V files into " .. ofile );
+	end
+}
+
+--EOF vim:syntax=lua:foldmethod=marker:ts=4:noexpandtab: 